@@ -45,6 +45,8 @@ Maintainer: Sylvain Miermont
 
 #include "parson.h"
 #include "base64.h"
+#include "rxpk.h"
+#include "isotime.h"
 #include "loragw_hal.h"
 #include "loragw_aux.h"
 
@@ -88,7 +90,7 @@ Maintainer: Sylvain Miermont
 #define MIN_FSK_PREAMB	3 /* minimum FSK preamble length for this application */
 #define STD_FSK_PREAMB	4
 
-#define TX_BUFF_SIZE	((540 * NB_PKT_MAX) + 30)
+#define TX_BUFF_SIZE	((RXPK_MAX_SIZE * NB_PKT_MAX) + 30)
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES (GLOBAL) ------------------------------------------- */
@@ -878,8 +880,8 @@ void thread_up(void) {
 	
 	/* local timestamp variables until we get accurate GPS time */
 	struct timespec fetch_time;
-	struct tm * x;
-	char fetch_timestamp[28]; /* timestamp as a text string */
+	struct isotime_cache fetch_time_cache; /* timestamp as a text string */
+	const char *fetch_timestamp = NULL;
 	
 	/* data buffers */
 	uint8_t buff_up[TX_BUFF_SIZE]; /* buffer to compose the upstream packet */
@@ -901,6 +903,9 @@ void thread_up(void) {
 		exit(EXIT_FAILURE);
 	}
 	
+	/* timestamps are only rebuilt when the second changes */
+	isotime_cache_init(&fetch_time_cache);
+	
 	/* pre-fill the data buffer with fixed fields */
 	buff_up[0] = PROTOCOL_VERSION;
 	buff_up[3] = PKT_PUSH_DATA;
@@ -923,8 +928,7 @@ void thread_up(void) {
 		
 		/* local timestamp generation until we get accurate GPS time */
 		clock_gettime(CLOCK_REALTIME, &fetch_time);
-		x = gmtime(&(fetch_time.tv_sec)); /* split the UNIX timestamp to its calendar components */
-		snprintf(fetch_timestamp, sizeof fetch_timestamp, "%04i-%02i-%02iT%02i:%02i:%02i.%06liZ", (x->tm_year)+1900, (x->tm_mon)+1, x->tm_mday, x->tm_hour, x->tm_min, x->tm_sec, (fetch_time.tv_nsec)/1000); /* ISO 8601 format */
+		fetch_timestamp = isotime_format(&fetch_time_cache, &fetch_time); /* ISO 8601 format */
 		
 		/* start composing datagram with the header */
 		token_h = (uint8_t)rand(); /* random token */
@@ -977,196 +981,20 @@ void thread_up(void) {
 			meas_up_payload_byte += p->size;
 			pthread_mutex_unlock(&mx_meas_up);
 			
-			/* Start of packet, add inter-packet separator if necessary */
-			if (pkt_in_dgram == 0) {
-				buff_up[buff_index] = '{';
-				++buff_index;
-			} else {
+			/* add inter-packet separator if necessary */
+			if (pkt_in_dgram > 0) {
 				buff_up[buff_index] = ',';
-				buff_up[buff_index+1] = '{';
-				buff_index += 2;
-			}
-			
-			/* RAW timestamp, 8-17 useful chars */
-			j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, "\"tmst\":%u", p->count_us);
-			if (j > 0) {
-				buff_index += j;
-			} else {
-				MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-				exit(EXIT_FAILURE);
-			}
-			
-			/* Packet RX time (system time based), 37 useful chars */
-			memcpy((void *)(buff_up + buff_index), (void *)",\"time\":\"???????????????????????????\"", 37);
-			memcpy((void *)(buff_up + buff_index + 9), (void *)fetch_timestamp, 27);
-			buff_index += 37;
-			
-			/* Packet concentrator channel, RF chain & RX frequency, 34-36 useful chars */
-			j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"chan\":%1u,\"rfch\":%1u,\"freq\":%.6lf", p->if_chain, p->rf_chain, ((double)p->freq_hz / 1e6));
-			if (j > 0) {
-				buff_index += j;
-			} else {
-				MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-				exit(EXIT_FAILURE);
-			}
-			
-			/* Packet status, 9-10 useful chars */
-			switch (p->status) {
-				case STAT_CRC_OK:
-					memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":1", 9);
-					buff_index += 9;
-					break;
-				case STAT_CRC_BAD:
-					memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":-1", 10);
-					buff_index += 10;
-					break;
-				case STAT_NO_CRC:
-					memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":0", 9);
-					buff_index += 9;
-					break;
-				default:
-					MSG("ERROR: [up] received packet with unknown status\n");
-					memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":?", 9);
-					buff_index += 9;
-					exit(EXIT_FAILURE);
-			}
-			
-			/* Packet modulation, 13-14 useful chars */
-			if (p->modulation == MOD_LORA) {
-				memcpy((void *)(buff_up + buff_index), (void *)",\"modu\":\"LORA\"", 14);
-				buff_index += 14;
-				
-				/* Lora datarate & bandwidth, 16-19 useful chars */
-				switch (p->datarate) {
-					case DR_LORA_SF7:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF7", 12);
-						buff_index += 12;
-						break;
-					case DR_LORA_SF8:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF8", 12);
-						buff_index += 12;
-						break;
-					case DR_LORA_SF9:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF9", 12);
-						buff_index += 12;
-						break;
-					case DR_LORA_SF10:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF10", 13);
-						buff_index += 13;
-						break;
-					case DR_LORA_SF11:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF11", 13);
-						buff_index += 13;
-						break;
-					case DR_LORA_SF12:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF12", 13);
-						buff_index += 13;
-						break;
-					default:
-						MSG("ERROR: [up] lora packet with unknown datarate\n");
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF?", 12);
-						buff_index += 12;
-						exit(EXIT_FAILURE);
-				}
-				switch (p->bandwidth) {
-					case BW_125KHZ:
-						memcpy((void *)(buff_up + buff_index), (void *)"BW125\"", 6);
-						buff_index += 6;
-						break;
-					case BW_250KHZ:
-						memcpy((void *)(buff_up + buff_index), (void *)"BW250\"", 6);
-						buff_index += 6;
-						break;
-					case BW_500KHZ:
-						memcpy((void *)(buff_up + buff_index), (void *)"BW500\"", 6);
-						buff_index += 6;
-						break;
-					default:
-						MSG("ERROR: [up] lora packet with unknown bandwidth\n");
-						memcpy((void *)(buff_up + buff_index), (void *)"BW?\"", 4);
-						buff_index += 4;
-						exit(EXIT_FAILURE);
-				}
-				
-				/* Packet ECC coding rate, 11-13 useful chars */
-				switch (p->coderate) {
-					case CR_LORA_4_5:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"4/5\"", 13);
-						buff_index += 13;
-						break;
-					case CR_LORA_4_6:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"4/6\"", 13);
-						buff_index += 13;
-						break;
-					case CR_LORA_4_7:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"4/7\"", 13);
-						buff_index += 13;
-						break;
-					case CR_LORA_4_8:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"4/8\"", 13);
-						buff_index += 13;
-						break;
-					case 0: /* treat the CR0 case (mostly false sync) */
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"OFF\"", 13);
-						buff_index += 13;
-						break;
-					default:
-						MSG("ERROR: [up] lora packet with unknown coderate\n");
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"?\"", 11);
-						buff_index += 11;
-						exit(EXIT_FAILURE);
-				}
-				
-				/* Lora SNR, 11-13 useful chars */
-				j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"lsnr\":%.1f", p->snr);
-				if (j > 0) {
-					buff_index += j;
-				} else {
-					MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-					exit(EXIT_FAILURE);
-				}
-			} else if (p->modulation == MOD_FSK) {
-				memcpy((void *)(buff_up + buff_index), (void *)",\"modu\":\"FSK\"", 13);
-				buff_index += 13;
-				
-				/* FSK datarate, 11-14 useful chars */
-				j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"datr\":%u", p->datarate);
-				if (j > 0) {
-					buff_index += j;
-				} else {
-					MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-					exit(EXIT_FAILURE);
-				}
-			} else {
-				MSG("ERROR: [up] received packet with unknown modulation\n");
-				exit(EXIT_FAILURE);
+				++buff_index;
 			}
 			
-			/* Packet RSSI, payload size, 18-23 useful chars */
-			j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"rssi\":%.0f,\"size\":%u", p->rssi, p->size);
+			/* packet metadata and base64-encoded payload, RX time is system time based */
+			j = rxpk_serialize(p, fetch_timestamp, (char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index);
 			if (j > 0) {
 				buff_index += j;
 			} else {
-				MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
+				MSG("ERROR: [up] failed to serialize packet (status %u, modulation %u, BW %u, DR %u, CR %u)\n", p->status, p->modulation, p->bandwidth, p->datarate, p->coderate);
 				exit(EXIT_FAILURE);
 			}
-			
-			/* Packet base64-encoded payload, 14-350 useful chars */
-			memcpy((void *)(buff_up + buff_index), (void *)",\"data\":\"", 9);
-			buff_index += 9;
-			j = bin_to_b64(p->payload, p->size, (char *)(buff_up + buff_index), 341); /* 255 bytes = 340 chars in b64 + null char */
-			if (j>=0) {
-				buff_index += j;
-			} else {
-				MSG("ERROR: [up] bin_to_b64 failed line %u\n", (__LINE__ - 5));
-				exit(EXIT_FAILURE);
-			}
-			buff_up[buff_index] = '"';
-			++buff_index;
-			
-			/* End of packet serialization */
-			buff_up[buff_index] = '}';
-			++buff_index;
 			++pkt_in_dgram;
 		}
 		
@@ -37,7 +37,6 @@ Maintainer: Sylvain Miermont
 #include <unistd.h>		/* getopt, access */
 #include <stdlib.h>		/* atoi, exit */
 #include <errno.h>		/* error messages */
-#include <math.h>		/* modf */
 
 #include <sys/socket.h> /* socket specific definitions */
 #include <netinet/in.h> /* INET constants and stuff */
@@ -48,6 +47,8 @@ Maintainer: Sylvain Miermont
 
 #include "parson.h"
 #include "base64.h"
+#include "rxpk.h"
+#include "isotime.h"
 #include "loragw_hal.h"
 #include "loragw_gps.h"
 #include "loragw_aux.h"
@@ -98,7 +99,7 @@ Maintainer: Sylvain Miermont
 #define STD_FSK_PREAMB	4
 
 #define STATUS_SIZE		200
-#define TX_BUFF_SIZE	((540 * NB_PKT_MAX) + 30 + STATUS_SIZE)
+#define TX_BUFF_SIZE	((RXPK_MAX_SIZE * NB_PKT_MAX) + 30 + STATUS_SIZE)
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES (GLOBAL) ------------------------------------------- */
@@ -818,9 +819,6 @@ int main(void)
 		gps_ref_valid = false;
 	}
 	
-	/* get timezone info */
-	tzset();
-	
 	/* sanity check on configuration variables */
 	// TODO
 	
@@ -1123,7 +1121,8 @@ void thread_up(void) {
 	
 	/* GPS synchronization variables */
 	struct timespec pkt_utc_time;
-	struct tm * x; /* broken-up UTC time */
+	struct isotime_cache pkt_time_cache; /* GPS based timestamp as a text string */
+	const char *time_str; /* timestamp used for the current packet, if any */
 	
 	/* report management variable */
 	bool send_report = false;
@@ -1135,6 +1134,9 @@ void thread_up(void) {
 		exit(EXIT_FAILURE);
 	}
 	
+	/* timestamps are only rebuilt when the second changes */
+	isotime_cache_init(&pkt_time_cache);
+	
 	/* pre-fill the data buffer with fixed fields */
 	buff_up[0] = PROTOCOL_VERSION;
 	buff_up[3] = PKT_PUSH_DATA;
@@ -1223,208 +1225,26 @@ void thread_up(void) {
 			meas_up_payload_byte += p->size;
 			pthread_mutex_unlock(&mx_meas_up);
 			
-			/* Start of packet, add inter-packet separator if necessary */
-			if (pkt_in_dgram == 0) {
-				buff_up[buff_index] = '{';
-				++buff_index;
-			} else {
+			/* add inter-packet separator if necessary */
+			if (pkt_in_dgram > 0) {
 				buff_up[buff_index] = ',';
-				buff_up[buff_index+1] = '{';
-				buff_index += 2;
-			}
-			
-			/* RAW timestamp, 8-17 useful chars */
-			j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, "\"tmst\":%u", p->count_us);
-			if (j > 0) {
-				buff_index += j;
-			} else {
-				MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-				exit(EXIT_FAILURE);
-			}
-			
-			/* Packet RX time (GPS based), 37 useful chars */
-			if (ref_ok == true) {
-				/* convert packet timestamp to UTC absolute time */
-				j = lgw_cnt2utc(local_ref, p->count_us, &pkt_utc_time);
-				if (j == LGW_GPS_SUCCESS) {
-					/* split the UNIX timestamp to its calendar components */
-					x = gmtime(&(pkt_utc_time.tv_sec));
-					j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"time\":\"%04i-%02i-%02iT%02i:%02i:%02i.%06liZ\"", (x->tm_year)+1900, (x->tm_mon)+1, x->tm_mday, x->tm_hour, x->tm_min, x->tm_sec, (pkt_utc_time.tv_nsec)/1000); /* ISO 8601 format */
-					if (j > 0) {
-						buff_index += j;
-					} else {
-						MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-						exit(EXIT_FAILURE);
-					}
-				}
-			}
-			
-			/* Packet concentrator channel, RF chain & RX frequency, 34-36 useful chars */
-			j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"chan\":%1u,\"rfch\":%1u,\"freq\":%.6lf", p->if_chain, p->rf_chain, ((double)p->freq_hz / 1e6));
-			if (j > 0) {
-				buff_index += j;
-			} else {
-				MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-				exit(EXIT_FAILURE);
-			}
-			
-			/* Packet status, 9-10 useful chars */
-			switch (p->status) {
-				case STAT_CRC_OK:
-					memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":1", 9);
-					buff_index += 9;
-					break;
-				case STAT_CRC_BAD:
-					memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":-1", 10);
-					buff_index += 10;
-					break;
-				case STAT_NO_CRC:
-					memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":0", 9);
-					buff_index += 9;
-					break;
-				default:
-					MSG("ERROR: [up] received packet with unknown status\n");
-					memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":?", 9);
-					buff_index += 9;
-					exit(EXIT_FAILURE);
+				++buff_index;
 			}
 			
-			/* Packet modulation, 13-14 useful chars */
-			if (p->modulation == MOD_LORA) {
-				memcpy((void *)(buff_up + buff_index), (void *)",\"modu\":\"LORA\"", 14);
-				buff_index += 14;
-				
-				/* Lora datarate & bandwidth, 16-19 useful chars */
-				switch (p->datarate) {
-					case DR_LORA_SF7:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF7", 12);
-						buff_index += 12;
-						break;
-					case DR_LORA_SF8:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF8", 12);
-						buff_index += 12;
-						break;
-					case DR_LORA_SF9:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF9", 12);
-						buff_index += 12;
-						break;
-					case DR_LORA_SF10:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF10", 13);
-						buff_index += 13;
-						break;
-					case DR_LORA_SF11:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF11", 13);
-						buff_index += 13;
-						break;
-					case DR_LORA_SF12:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF12", 13);
-						buff_index += 13;
-						break;
-					default:
-						MSG("ERROR: [up] lora packet with unknown datarate\n");
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF?", 12);
-						buff_index += 12;
-						exit(EXIT_FAILURE);
-				}
-				switch (p->bandwidth) {
-					case BW_125KHZ:
-						memcpy((void *)(buff_up + buff_index), (void *)"BW125\"", 6);
-						buff_index += 6;
-						break;
-					case BW_250KHZ:
-						memcpy((void *)(buff_up + buff_index), (void *)"BW250\"", 6);
-						buff_index += 6;
-						break;
-					case BW_500KHZ:
-						memcpy((void *)(buff_up + buff_index), (void *)"BW500\"", 6);
-						buff_index += 6;
-						break;
-					default:
-						MSG("ERROR: [up] lora packet with unknown bandwidth\n");
-						memcpy((void *)(buff_up + buff_index), (void *)"BW?\"", 4);
-						buff_index += 4;
-						exit(EXIT_FAILURE);
-				}
-				
-				/* Packet ECC coding rate, 11-13 useful chars */
-				switch (p->coderate) {
-					case CR_LORA_4_5:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"4/5\"", 13);
-						buff_index += 13;
-						break;
-					case CR_LORA_4_6:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"4/6\"", 13);
-						buff_index += 13;
-						break;
-					case CR_LORA_4_7:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"4/7\"", 13);
-						buff_index += 13;
-						break;
-					case CR_LORA_4_8:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"4/8\"", 13);
-						buff_index += 13;
-						break;
-					case 0: /* treat the CR0 case (mostly false sync) */
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"OFF\"", 13);
-						buff_index += 13;
-						break;
-					default:
-						MSG("ERROR: [up] lora packet with unknown coderate\n");
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"?\"", 11);
-						buff_index += 11;
-						exit(EXIT_FAILURE);
-				}
-				
-				/* Lora SNR, 11-13 useful chars */
-				j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"lsnr\":%.1f", p->snr);
-				if (j > 0) {
-					buff_index += j;
-				} else {
-					MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-					exit(EXIT_FAILURE);
-				}
-			} else if (p->modulation == MOD_FSK) {
-				memcpy((void *)(buff_up + buff_index), (void *)",\"modu\":\"FSK\"", 13);
-				buff_index += 13;
-				
-				/* FSK datarate, 11-14 useful chars */
-				j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"datr\":%u", p->datarate);
-				if (j > 0) {
-					buff_index += j;
-				} else {
-					MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-					exit(EXIT_FAILURE);
-				}
-			} else {
-				MSG("ERROR: [up] received packet with unknown modulation\n");
-				exit(EXIT_FAILURE);
+			/* packet RX time, GPS based, omitted if there is no valid time reference */
+			time_str = NULL;
+			if ((ref_ok == true) && (lgw_cnt2utc(local_ref, p->count_us, &pkt_utc_time) == LGW_GPS_SUCCESS)) {
+				time_str = isotime_format(&pkt_time_cache, &pkt_utc_time);
 			}
 			
-			/* Packet RSSI, payload size, 18-23 useful chars */
-			j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"rssi\":%.0f,\"size\":%u", p->rssi, p->size);
+			/* packet metadata and base64-encoded payload */
+			j = rxpk_serialize(p, time_str, (char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index);
 			if (j > 0) {
 				buff_index += j;
 			} else {
-				MSG("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
+				MSG("ERROR: [up] failed to serialize packet (status %u, modulation %u, BW %u, DR %u, CR %u)\n", p->status, p->modulation, p->bandwidth, p->datarate, p->coderate);
 				exit(EXIT_FAILURE);
 			}
-			
-			/* Packet base64-encoded payload, 14-350 useful chars */
-			memcpy((void *)(buff_up + buff_index), (void *)",\"data\":\"", 9);
-			buff_index += 9;
-			j = bin_to_b64(p->payload, p->size, (char *)(buff_up + buff_index), 341); /* 255 bytes = 340 chars in b64 + null char */
-			if (j>=0) {
-				buff_index += j;
-			} else {
-				MSG("ERROR: [up] bin_to_b64 failed line %u\n", (__LINE__ - 5));
-				exit(EXIT_FAILURE);
-			}
-			buff_up[buff_index] = '"';
-			++buff_index;
-			
-			/* End of packet serialization */
-			buff_up[buff_index] = '}';
-			++buff_index;
 			++pkt_in_dgram;
 		}
 		
@@ -1533,12 +1353,9 @@ void thread_down(void) {
 	JSON_Value *val = NULL; /* needed to detect the absence of some fields */
 	const char *str; /* pointer to sub-strings in the JSON data */
 	short x0, x1;
-	short x2, x3, x4;
-	double x5, x6;
 	
 	/* variables to send on UTC timestamp */
 	struct tref local_ref; /* time reference used for UTC <-> timestamp conversion */
-	struct tm utc_vector; /* for collecting the elements of the UTC time */
 	struct timespec utc_tx; /* UTC time that needs to be converted to timestamp */
 	
 	/* beacon variables */
@@ -1799,21 +1616,11 @@ void thread_down(void) {
 						continue;
 					}
 					
-					i = sscanf (str, "%4hd-%2hd-%2hdT%2hd:%2hd:%9lf", &x0, &x1, &x2, &x3, &x4, &x5);
-					if (i != 6 ) {
+					if (isotime_parse(str, &utc_tx) != 0) {
 						MSG("WARNING: [down] \"txpk.time\" must follow ISO 8601 format, TX aborted\n");
 						json_value_free(root_val);
 						continue;
 					}
-					x5 = modf(x5, &x6); /* x6 get the integer part of x5, x5 the fractional part */
-					utc_vector.tm_year = x0 - 1900; /* years since 1900 */
-					utc_vector.tm_mon = x1 - 1; /* months since January */
-					utc_vector.tm_mday = x2; /* day of the month 1-31 */
-					utc_vector.tm_hour = x3; /* hours since midnight */
-					utc_vector.tm_min = x4; /* minutes after the hour */
-					utc_vector.tm_sec = (int)x6;
-					utc_tx.tv_sec = mktime(&utc_vector) - timezone;
-					utc_tx.tv_nsec = (long)(1e9 * x5);
 					
 					/* transform UTC time to timestamp */
 					i = lgw_utc2cnt(local_ref, utc_tx, &(txpkt.count_us));
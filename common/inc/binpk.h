@@ -0,0 +1,151 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+/*
+Description:
+	Compact binary encoding of the rxpk, stat and txpk objects, an alternative
+	to the JSON data structures of PROTOCOL.TXT selected per server (see the
+	"Binary data structure" section of PROTOCOL.TXT for the wire format).
+	This module does not depend on the HAL so the test utilities can use it.
+*/
+
+#ifndef _BINPK_H
+#define _BINPK_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>		/* C99 types */
+#include <stdbool.h>	/* bool type */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define BINPK_VERSION		0xB1	/* first byte of a binary body, a JSON body starts with '{' */
+
+/* upstream body header, followed by the rxpk records and the optional stat record */
+#define BINPK_UP_FLAGS		1		/* offset of the flags byte */
+#define BINPK_UP_COUNT		2		/* offset of the number of rxpk records */
+#define BINPK_UP_HDR		3		/* size of the upstream body header */
+#define BINPK_UP_STAT		0x01	/* flag: a stat record follows the rxpk records */
+#define BINPK_UP_COUNT_MAX	255		/* max number of rxpk records in a body */
+
+#define BINPK_RX_FIXED_MAX	32		/* max size of a rxpk record, excluding the payload */
+#define BINPK_TX_FIXED_MAX	32		/* max size of a txpk body, excluding the payload */
+
+#define BINPK_LORA			1		/* modulation identifiers */
+#define BINPK_FSK			2
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/* fields of a rxpk object, in the units of the binary encoding */
+struct binpk_rx {
+	uint32_t		tmst;		/* internal timestamp of the "RX finished" event */
+	bool			has_time;	/* time_us is valid */
+	uint64_t		time_us;	/* UTC time of RX, in us since 1970-01-01 */
+	uint32_t		freq_hz;	/* RX central frequency in Hz */
+	uint8_t			chan;		/* concentrator IF channel */
+	uint8_t			rfch;		/* concentrator RF chain */
+	uint8_t			modu;		/* BINPK_LORA or BINPK_FSK */
+	uint8_t			sf;			/* LoRa spreading factor (7-12) */
+	uint16_t		bw_khz;		/* LoRa bandwidth in kHz */
+	uint8_t			codr;		/* LoRa coding rate 4/codr (5-8), 0 if off */
+	uint32_t		datr;		/* FSK datarate in bits per second */
+	int8_t			stat;		/* CRC status: 1 = OK, -1 = fail, 0 = no CRC */
+	int16_t			rssi;		/* RSSI in dBm */
+	int16_t			lsnr;		/* LoRa SNR in 0.1 dB */
+	uint8_t			size;		/* payload size in bytes */
+	const uint8_t	*payload;	/* raw payload, points into the datagram once decoded */
+};
+
+/* fields of a txpk object, in the units of the binary encoding */
+struct binpk_tx {
+	bool			imme;		/* send immediately, ignore tmst and time */
+	bool			has_time;	/* send at time_us (GPS required) instead of tmst */
+	uint64_t		time_us;	/* UTC time of TX, in us since 1970-01-01 */
+	uint32_t		tmst;		/* internal timestamp of TX */
+	uint32_t		freq_hz;	/* TX central frequency in Hz */
+	uint8_t			rfch;		/* concentrator RF chain */
+	int8_t			powe;		/* TX power in dBm */
+	uint8_t			modu;		/* BINPK_LORA or BINPK_FSK */
+	uint8_t			sf;			/* LoRa spreading factor (7-12) */
+	uint16_t		bw_khz;		/* LoRa bandwidth in kHz */
+	uint8_t			codr;		/* LoRa coding rate 4/codr (5-8) */
+	bool			ipol;		/* LoRa polarization inversion */
+	uint32_t		datr;		/* FSK datarate in bits per second */
+	uint32_t		fdev_hz;	/* FSK frequency deviation in Hz */
+	uint16_t		prea;		/* preamble size, 0 for the default one */
+	bool			ncrc;		/* disable the physical layer CRC */
+	uint8_t			size;		/* payload size in bytes */
+	const uint8_t	*payload;	/* raw payload, points into the datagram once decoded */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Encode a rxpk record
+@param rx pointer to the packet fields
+@param prev previous record of the same body, its radio settings are not repeated if identical, or NULL
+@param out pointer to the output buffer
+@param max_len usable size of the output buffer
+@return >0 number of bytes written, -1 if the buffer is too small
+*/
+int binpk_rx_write(const struct binpk_rx *rx, const struct binpk_rx *prev, uint8_t *out, int max_len);
+
+/**
+@brief Decode a rxpk record
+@param in pointer to the record
+@param len number of bytes available
+@param rx holds the previous record of the body on entry, the decoded one on return
+@return >0 number of bytes consumed, -1 if the record is malformed
+*/
+int binpk_rx_read(const uint8_t *in, int len, struct binpk_rx *rx);
+
+/**
+@brief Encode a stat record carrying a JSON stat object, from '{' to '}'
+@return >0 number of bytes written, -1 if the buffer is too small
+*/
+int binpk_stat_write(const char *stat, int stat_len, uint8_t *out, int max_len);
+
+/**
+@brief Decode a stat record, stat points into the datagram and is not null-terminated
+@return >0 number of bytes consumed, -1 if the record is malformed
+*/
+int binpk_stat_read(const uint8_t *in, int len, const char **stat, int *stat_len);
+
+/**
+@brief Encode a txpk body, from the BINPK_VERSION byte to the end of the payload
+@return >0 number of bytes written, -1 if the buffer is too small
+*/
+int binpk_tx_write(const struct binpk_tx *tx, uint8_t *out, int max_len);
+
+/**
+@brief Decode a txpk body
+@return 0 on success, -1 if the body is malformed or of another version
+*/
+int binpk_tx_read(const uint8_t *in, int len, struct binpk_tx *tx);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,79 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+/*
+Description:
+	ISO 8601 UTC timestamps (eg. 2013-03-31T16:21:17.528002Z), formatted and
+	parsed with plain calendar arithmetic, independent of the TZ environment.
+*/
+
+#ifndef _ISOTIME_H
+#define _ISOTIME_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <time.h>		/* time_t, struct timespec */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define ISOTIME_LEN	27	/* length of a timestamp with microseconds, w/o null char */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+/* last formatted timestamp, the calendar part is only rebuilt when the second changes */
+struct isotime_cache {
+	time_t	sec;					/* second held in str */
+	int		valid;					/* str holds a formatted timestamp */
+	char	str[ISOTIME_LEN + 1];	/* null terminated timestamp */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Reset a timestamp cache, must be called before the first isotime_format
+@param cache pointer to the cache, owned by a single thread
+*/
+void isotime_cache_init(struct isotime_cache *cache);
+
+/**
+@brief Format a UTC time in ISO 8601 with microseconds
+@param cache pointer to the cache holding the previous timestamp
+@param utc pointer to the time to format
+@return pointer to the null terminated timestamp, valid until the next call on the same cache
+*/
+const char *isotime_format(struct isotime_cache *cache, const struct timespec *utc);
+
+/**
+@brief Parse an ISO 8601 UTC time (YYYY-MM-DDThh:mm:ss[.fraction][Z])
+@param str null terminated string, anything after the seconds fraction is ignored
+@param utc pointer to the resulting time
+@return 0 if successful, -1 if the string is not a valid timestamp
+*/
+int isotime_parse(const char *str, struct timespec *utc);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
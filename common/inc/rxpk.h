@@ -0,0 +1,61 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+/*
+Description:
+	Serialization of received packets as JSON rxpk objects (see PROTOCOL.TXT),
+	shared by all the packet forwarders.
+*/
+
+#ifndef _RXPK_H
+#define _RXPK_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>		/* C99 types */
+
+#include "loragw_hal.h"
+#include "isotime.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define RXPK_FIXED_MAX	290	/* max size of a rxpk object, excluding the base64 payload */
+#define RXPK_MAX_SIZE	(RXPK_FIXED_MAX + 344)	/* max size of a rxpk object, 256 bytes payload */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Serialize a received packet as a JSON rxpk object, from '{' to '}'
+@param p pointer to the received packet and its metadata
+@param time_str ISO 8601 timestamp of ISOTIME_LEN chars, or NULL to omit the "time" field
+@param out pointer to the output buffer, no null char is added
+@param max_len usable size of the output buffer
+@return >0 number of bytes written, -1 if the buffer is too small or a metadata field is invalid
+*/
+int rxpk_serialize(const struct lgw_pkt_rx_s *p, const char *time_str, char *out, int max_len);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
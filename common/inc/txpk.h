@@ -0,0 +1,59 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+/*
+Description:
+	Single-pass decoder of the JSON txpk object of a PULL_RESP (see section 6
+	of PROTOCOL.TXT) into the fields of a binary txpk, without allocation: the
+	numbers are read in place and the base64 payload is decoded straight into
+	the caller's buffer. It only accepts the compact JSON the servers send, a
+	comment, an escaped string, a field outside the txpk schema or an invalid
+	field is left to a complete JSON parser.
+*/
+
+#ifndef _TXPK_H
+#define _TXPK_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>		/* C99 types */
+
+#include "binpk.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Decode a PULL_RESP JSON body, {"txpk":{...}}
+@param json pointer to the body
+@param len number of chars of the body
+@param tx pointer to the decoded fields, tx->payload points to the payload buffer on success
+@param payload buffer receiving the decoded payload
+@param max_len usable size of the payload buffer
+@return 0 on success, -1 if the body is beyond this decoder or invalid, the caller then falls back to a JSON parser
+*/
+int txpk_json_read(const char *json, int len, struct binpk_tx *tx, uint8_t *payload, int max_len);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
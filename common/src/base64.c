@@ -0,0 +1,482 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+	Base64 encoding & decoding library
+	Table-driven scalar code, with SIMD kernels for the full blocks:
+	SSSE3 (selected at runtime on x86) and NEON (selected at compile time).
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+Maintainer: Sylvain Miermont
+*/
+
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "base64.h"
+
+/* B64_NO_SIMD builds the scalar code only, the tests check the SIMD kernels against it */
+#if !defined(B64_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define B64_SSSE3
+	#include <tmmintrin.h>
+#endif
+
+#if !defined(B64_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+	#define B64_NEON
+	#include <arm_neon.h>
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+#define CRIT(a)			fprintf(stderr, "\nCRITICAL file:%s line:%u msg:%s\n", __FILE__, __LINE__,a);exit(EXIT_FAILURE)
+
+//#define DEBUG(args...)	fprintf(stderr,"debug: " args) /* diagnostic message that is destined to the user */
+#define DEBUG(args...)
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define CODE_PAD	'='	/* RFC 1421 padding character if padding */
+#define XX			0xFF	/* invalid character marker in the decoding table */
+
+/* RFC 1421 alphabet, '+' for code 62 and '/' for code 63 */
+static const char enc_table[64] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static const uint8_t dec_table[256] = {
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, 62, XX, XX, XX, 63,
+	52, 53, 54, 55, 56, 57, 58, 59, 60, 61, XX, XX, XX, XX, XX, XX,
+	XX,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+	15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, XX, XX, XX, XX, XX,
+	XX, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+	41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+	XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DECLARATION ---------------------------------------- */
+
+/**
+@brief Encode/decode as many full blocks as possible with the SIMD kernels
+@return number of 3 bytes / 4 chars blocks processed, the rest is left to the scalar code
+A decoding kernel stops before any block containing an invalid character.
+*/
+static int enc_blocks_simd(const uint8_t * in, int full_blocks, char * out);
+static int dec_blocks_simd(const char * in, int full_blocks, uint8_t * out);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+#ifdef B64_SSSE3
+
+/* 12 bytes -> 16 chars per iteration, reads 16 bytes */
+__attribute__((target("ssse3")))
+static int enc_blocks_ssse3(const uint8_t * in, int full_blocks, char * out) {
+	const __m128i shuf = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+	const __m128i shift_lut = _mm_setr_epi8('a'-26, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '0'-52, '+'-62, '/'-63, 'A', 0, 0);
+	__m128i v, t0, t1, idx, res;
+	int i = 0;
+	
+	for (; (full_blocks - i) >= 6; i += 4) { /* 6 blocks = 18 bytes, the 16 bytes load stays in the input */
+		v = _mm_loadu_si128((const __m128i *)(in + 3*i));
+		v = _mm_shuffle_epi8(v, shuf);
+		/* split each 24 bits group in four 6 bits indexes, one per byte */
+		t0 = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+		t1 = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+		idx = _mm_or_si128(t0, t1);
+		/* map the indexes to the 5 ranges of the alphabet: 0-25, 26-51, 52-61, 62, 63 */
+		res = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+		res = _mm_or_si128(res, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx), _mm_set1_epi8(13)));
+		res = _mm_add_epi8(_mm_shuffle_epi8(shift_lut, res), idx);
+		_mm_storeu_si128((__m128i *)(out + 4*i), res);
+	}
+	return i;
+}
+
+/* 16 chars -> 12 bytes per iteration, writes exactly 12 bytes */
+__attribute__((target("ssse3")))
+static int dec_blocks_ssse3(const char * in, int full_blocks, uint8_t * out) {
+	const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i mask_2f = _mm_set1_epi8(0x2F);
+	const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	__m128i v, hi, lo, bad, roll;
+	int last;
+	int i = 0;
+	
+	for (; (full_blocks - i) >= 4; i += 4) {
+		v = _mm_loadu_si128((const __m128i *)(in + 4*i));
+		hi = _mm_and_si128(_mm_srli_epi32(v, 4), _mm_set1_epi8(0x0F));
+		lo = _mm_and_si128(v, _mm_set1_epi8(0x0F));
+		/* a character is valid if its low and high nibble classes do not intersect */
+		bad = _mm_and_si128(_mm_shuffle_epi8(lut_lo, lo), _mm_shuffle_epi8(lut_hi, hi));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(bad, _mm_setzero_si128())) != 0xFFFF) {
+			break; /* let the scalar code report the error */
+		}
+		/* translate to 6 bits values, '/' shares its high nibble with '+' */
+		roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(v, mask_2f), hi));
+		v = _mm_add_epi8(v, roll);
+		/* merge four 6 bits values in 24 bits, then pack the 3 bytes groups */
+		v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+		v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+		v = _mm_shuffle_epi8(v, pack);
+		_mm_storel_epi64((__m128i *)(out + 3*i), v);
+		last = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+		memcpy(out + 3*i + 8, &last, 4);
+	}
+	return i;
+}
+
+static int enc_blocks_simd(const uint8_t * in, int full_blocks, char * out) {
+	if (__builtin_cpu_supports("ssse3")) {
+		return enc_blocks_ssse3(in, full_blocks, out);
+	}
+	return 0;
+}
+
+static int dec_blocks_simd(const char * in, int full_blocks, uint8_t * out) {
+	if (__builtin_cpu_supports("ssse3")) {
+		return dec_blocks_ssse3(in, full_blocks, out);
+	}
+	return 0;
+}
+
+#elif defined(B64_NEON)
+
+/* 48 bytes -> 64 chars per iteration */
+static int enc_blocks_simd(const uint8_t * in, int full_blocks, char * out) {
+	uint8x16x3_t v;
+	uint8x16x4_t res;
+	uint8x16_t idx;
+	int i = 0;
+	int k;
+	
+	for (; (full_blocks - i) >= 16; i += 16) {
+		v = vld3q_u8(in + 3*i); /* de-interleave the 3 bytes of each group */
+		res.val[0] = vshrq_n_u8(v.val[0], 2);
+		res.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(v.val[0], 4), vshrq_n_u8(v.val[1], 4)), vdupq_n_u8(0x3F));
+		res.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(v.val[1], 2), vshrq_n_u8(v.val[2], 6)), vdupq_n_u8(0x3F));
+		res.val[3] = vandq_u8(v.val[2], vdupq_n_u8(0x3F));
+		for (k = 0; k < 4; ++k) {
+			/* map the indexes to the 5 ranges of the alphabet: 0-25, 26-51, 52-61, 62, 63 */
+			idx = res.val[k];
+			res.val[k] = vaddq_u8(idx, vdupq_n_u8('A'));
+			res.val[k] = vaddq_u8(res.val[k], vandq_u8(vcgeq_u8(idx, vdupq_n_u8(26)), vdupq_n_u8((uint8_t)(('a'-26) - 'A'))));
+			res.val[k] = vaddq_u8(res.val[k], vandq_u8(vcgeq_u8(idx, vdupq_n_u8(52)), vdupq_n_u8((uint8_t)(('0'-52) - ('a'-26)))));
+			res.val[k] = vaddq_u8(res.val[k], vandq_u8(vcgeq_u8(idx, vdupq_n_u8(62)), vdupq_n_u8((uint8_t)(('+'-62) - ('0'-52)))));
+			res.val[k] = vaddq_u8(res.val[k], vandq_u8(vcgeq_u8(idx, vdupq_n_u8(63)), vdupq_n_u8((uint8_t)(('/'-63) - ('+'-62)))));
+		}
+		vst4q_u8((uint8_t *)(out + 4*i), res); /* interleave the 4 chars of each group */
+	}
+	return i;
+}
+
+/* translate 16 chars to 6 bits values, invalid characters are flagged in *bad */
+static inline uint8x16_t dec_chars_neon(uint8x16_t c, uint8x16_t *bad) {
+	uint8x16_t upper = vcleq_u8(vsubq_u8(c, vdupq_n_u8('A')), vdupq_n_u8(25));
+	uint8x16_t lower = vcleq_u8(vsubq_u8(c, vdupq_n_u8('a')), vdupq_n_u8(25));
+	uint8x16_t digit = vcleq_u8(vsubq_u8(c, vdupq_n_u8('0')), vdupq_n_u8(9));
+	uint8x16_t plus = vceqq_u8(c, vdupq_n_u8('+'));
+	uint8x16_t slash = vceqq_u8(c, vdupq_n_u8('/'));
+	uint8x16_t off;
+	
+	off = vandq_u8(upper, vdupq_n_u8((uint8_t)-'A'));
+	off = vorrq_u8(off, vandq_u8(lower, vdupq_n_u8((uint8_t)(26 - 'a'))));
+	off = vorrq_u8(off, vandq_u8(digit, vdupq_n_u8((uint8_t)(52 - '0'))));
+	off = vorrq_u8(off, vandq_u8(plus, vdupq_n_u8((uint8_t)(62 - '+'))));
+	off = vorrq_u8(off, vandq_u8(slash, vdupq_n_u8((uint8_t)(63 - '/'))));
+	*bad = vorrq_u8(*bad, vmvnq_u8(vorrq_u8(vorrq_u8(upper, lower), vorrq_u8(digit, vorrq_u8(plus, slash)))));
+	return vaddq_u8(c, off);
+}
+
+/* 64 chars -> 48 bytes per iteration */
+static int dec_blocks_simd(const char * in, int full_blocks, uint8_t * out) {
+	uint8x16x4_t v;
+	uint8x16x3_t res;
+	uint8x16_t bad;
+	uint8x8_t bad8;
+	int i = 0;
+	int k;
+	
+	for (; (full_blocks - i) >= 16; i += 16) {
+		v = vld4q_u8((const uint8_t *)(in + 4*i)); /* de-interleave the 4 chars of each group */
+		bad = vdupq_n_u8(0);
+		for (k = 0; k < 4; ++k) {
+			v.val[k] = dec_chars_neon(v.val[k], &bad);
+		}
+		bad8 = vorr_u8(vget_low_u8(bad), vget_high_u8(bad));
+		if (vget_lane_u64(vreinterpret_u64_u8(bad8), 0) != 0) {
+			break; /* let the scalar code report the error */
+		}
+		res.val[0] = vorrq_u8(vshlq_n_u8(v.val[0], 2), vshrq_n_u8(v.val[1], 4));
+		res.val[1] = vorrq_u8(vshlq_n_u8(v.val[1], 4), vshrq_n_u8(v.val[2], 2));
+		res.val[2] = vorrq_u8(vshlq_n_u8(v.val[2], 6), v.val[3]);
+		vst3q_u8(out + 3*i, res);
+	}
+	return i;
+}
+
+#else
+
+static int enc_blocks_simd(const uint8_t * in, int full_blocks, char * out) {
+	(void)in; (void)full_blocks; (void)out;
+	return 0;
+}
+
+static int dec_blocks_simd(const char * in, int full_blocks, uint8_t * out) {
+	(void)in; (void)full_blocks; (void)out;
+	return 0;
+}
+
+#endif
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int bin_to_b64_nopad(const uint8_t * in, int size, char * out, int max_len) {
+	int i;
+	int result_len; /* size of the result */
+	int full_blocks; /* number of 3 unsigned chars / 4 characters blocks */
+	int last_bytes; /* number of unsigned chars <3 in the last block */
+	int last_chars; /* number of characters <4 in the last block */
+	uint32_t b;
+	
+	/* check input values */
+	if ((out == NULL) || (in == NULL)) {
+		DEBUG("ERROR: NULL POINTER AS OUTPUT IN BIN_TO_B64\n");
+		return -1;
+	}
+	if (size == 0) {
+		*out = 0; /* null string */
+		return 0;
+	}
+	
+	/* calculate the number of base64 'blocks' */
+	full_blocks = size / 3;
+	last_bytes = size % 3;
+	switch (last_bytes) {
+		case 0: /* no byte left to encode */
+			last_chars = 0;
+			break;
+		case 1: /* 1 byte left to encode -> +2 chars */
+			last_chars = 2;
+			break;
+		case 2: /* 2 bytes left to encode -> +3 chars */
+			last_chars = 3;
+			break;
+		default:
+			CRIT("switch default that should not be possible");
+	}
+	
+	/* check if output buffer is big enough */
+	result_len = (4*full_blocks) + last_chars;
+	if (max_len < (result_len + 1)) { /* 1 char added for string terminator */
+		DEBUG("ERROR: OUTPUT BUFFER TOO SMALL IN BIN_TO_B64\n");
+		return -1;
+	}
+	
+	/* process all the full blocks, SIMD first then scalar for the remainder */
+	for (i = enc_blocks_simd(in, full_blocks, out); i < full_blocks; ++i) {
+		b  = (uint32_t)in[3*i] << 16;
+		b |= (uint32_t)in[3*i + 1] << 8;
+		b |= (uint32_t)in[3*i + 2];
+		out[4*i + 0] = enc_table[(b >> 18) & 0x3F];
+		out[4*i + 1] = enc_table[(b >> 12) & 0x3F];
+		out[4*i + 2] = enc_table[(b >> 6 ) & 0x3F];
+		out[4*i + 3] = enc_table[ b        & 0x3F];
+	}
+	
+	/* process the last 'partial' block and terminate string */
+	i = full_blocks;
+	if (last_chars == 0) {
+		out[4*i] =  0; /* null character to terminate string */
+	} else if (last_chars == 2) {
+		b  = (uint32_t)in[3*i] << 16;
+		out[4*i + 0] = enc_table[(b >> 18) & 0x3F];
+		out[4*i + 1] = enc_table[(b >> 12) & 0x3F];
+		out[4*i + 2] =  0; /* null character to terminate string */
+	} else if (last_chars == 3) {
+		b  = (uint32_t)in[3*i] << 16;
+		b |= (uint32_t)in[3*i + 1] << 8;
+		out[4*i + 0] = enc_table[(b >> 18) & 0x3F];
+		out[4*i + 1] = enc_table[(b >> 12) & 0x3F];
+		out[4*i + 2] = enc_table[(b >> 6 ) & 0x3F];
+		out[4*i + 3] = 0; /* null character to terminate string */
+	}
+	
+	return result_len;
+}
+
+int b64_to_bin_nopad(const char * in, int size, uint8_t * out, int max_len) {
+	int i;
+	int result_len; /* size of the result */
+	int full_blocks; /* number of 3 unsigned chars / 4 characters blocks */
+	int last_chars; /* number of characters <4 in the last block */
+	int last_bytes; /* number of unsigned chars <3 in the last block */
+	uint8_t c0, c1, c2, c3;
+	uint32_t b;
+	
+	/* check input values */
+	if ((out == NULL) || (in == NULL)) {
+		DEBUG("ERROR: NULL POINTER AS OUTPUT OR INPUT IN B64_TO_BIN\n");
+		return -1;
+	}
+	if (size == 0) {
+		return 0;
+	}
+	
+	/* calculate the number of base64 'blocks' */
+	full_blocks = size / 4;
+	last_chars = size % 4;
+	switch (last_chars) {
+		case 0: /* no char left to decode */
+			last_bytes = 0;
+			break;
+		case 1: /* only 1 char left is an error */
+			DEBUG("ERROR: ONLY ONE CHAR LEFT IN B64_TO_BIN\n");
+			return -1;
+		case 2: /* 2 chars left to decode -> +1 byte */
+			last_bytes = 1;
+			break;
+		case 3: /* 3 chars left to decode -> +2 bytes */
+			last_bytes = 2;
+			break;
+		default:
+			CRIT("switch default that should not be possible");
+	}
+	
+	/* check if output buffer is big enough */
+	result_len = (3*full_blocks) + last_bytes;
+	if (max_len < result_len) {
+		DEBUG("ERROR: OUTPUT BUFFER TOO SMALL IN B64_TO_BIN\n");
+		return -1;
+	}
+	
+	/* process all the full blocks, SIMD first then scalar for the remainder */
+	for (i = dec_blocks_simd(in, full_blocks, out); i < full_blocks; ++i) {
+		c0 = dec_table[(uint8_t)in[4*i]];
+		c1 = dec_table[(uint8_t)in[4*i + 1]];
+		c2 = dec_table[(uint8_t)in[4*i + 2]];
+		c3 = dec_table[(uint8_t)in[4*i + 3]];
+		if ((c0 | c1 | c2 | c3) & 0xC0) { /* valid codes are 0-63, only an invalid char sets the 2 MSB */
+			DEBUG("ERROR: INVALID CHARACTER FOR BASE64 DECODING\n");
+			return -1;
+		}
+		b = ((uint32_t)c0 << 18) | ((uint32_t)c1 << 12) | ((uint32_t)c2 << 6) | c3;
+		out[3*i + 0] = (b >> 16) & 0xFF;
+		out[3*i + 1] = (b >> 8 ) & 0xFF;
+		out[3*i + 2] =  b        & 0xFF;
+	}
+	
+	/* process the last 'partial' block */
+	i = full_blocks;
+	if (last_bytes == 0) {
+		return result_len;
+	}
+	c0 = dec_table[(uint8_t)in[4*i]];
+	c1 = dec_table[(uint8_t)in[4*i + 1]];
+	c2 = (last_bytes == 2) ? dec_table[(uint8_t)in[4*i + 2]] : 0;
+	if ((c0 | c1 | c2) & 0xC0) {
+		DEBUG("ERROR: INVALID CHARACTER FOR BASE64 DECODING\n");
+		return -1;
+	}
+	b = ((uint32_t)c0 << 18) | ((uint32_t)c1 << 12) | ((uint32_t)c2 << 6);
+	out[3*i + 0] = (b >> 16) & 0xFF;
+	if (last_bytes == 1) {
+		if (((b >> 12) & 0x0F) != 0) {
+			DEBUG("WARNING: last character contains unusable bits\n");
+		}
+	} else {
+		out[3*i + 1] = (b >> 8 ) & 0xFF;
+		if (((b >> 6) & 0x03) != 0) {
+			DEBUG("WARNING: last character contains unusable bits\n");
+		}
+	}
+	
+	return result_len;
+}
+
+int bin_to_b64(const uint8_t * in, int size, char * out, int max_len) {
+	int ret;
+	
+	ret = bin_to_b64_nopad(in, size, out, max_len);
+	
+	if (ret == -1) {
+		return -1;
+	}	
+	switch (ret%4) {
+		case 0: /* nothing to do */
+			return ret;
+		case 1:
+			DEBUG("ERROR: INVALID UNPADDED BASE64 STRING\n");
+			return -1;
+		case 2: /* 2 chars in last block, must add 2 padding char */
+			if (max_len > (ret + 2 + 1)) {
+				out[ret] = CODE_PAD;
+				out[ret+1] = CODE_PAD;
+				out[ret+2] = 0;
+				return ret+2;
+			} else {
+				DEBUG("ERROR: not enough room to add padding in bin_to_b64\n");
+				return -1;
+			}
+		case 3: /* 3 chars in last block, must add 1 padding char */
+			if (max_len > (ret + 1 + 1)) {
+				out[ret] = CODE_PAD;
+				out[ret+1] = 0;
+				return ret+1;
+			} else {
+				DEBUG("ERROR: not enough room to add padding in bin_to_b64\n");
+				return -1;
+			}
+		default:
+			CRIT("switch default that should not be possible");
+	}
+}
+
+int b64_to_bin(const char * in, int size, uint8_t * out, int max_len) {
+	if (in == NULL) {
+		DEBUG("ERROR: NULL POINTER AS OUTPUT OR INPUT IN B64_TO_BIN\n");
+		return -1;
+	}
+	if ((size%4 == 0) && (size >= 4)) { /* potentially padded Base64 */
+		if (in[size-2] == CODE_PAD) { /* 2 padding char to ignore */
+			if (in[size-1] != CODE_PAD) {
+				DEBUG("ERROR: CHARACTER AFTER PADDING IN B64_TO_BIN\n");
+				return -1;
+			}
+			return b64_to_bin_nopad(in, size-2, out, max_len);
+		} else if (in[size-1] == CODE_PAD) { /* 1 padding char to ignore */
+			return b64_to_bin_nopad(in, size-1, out, max_len);
+		} else { /* no padding to ignore */
+			return b64_to_bin_nopad(in, size, out, max_len);
+		}
+	} else { /* treat as unpadded Base64 */
+		return b64_to_bin_nopad(in, size, out, max_len);
+	}
+}
+
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,299 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+/*
+Description:
+	Compact binary encoding of the rxpk, stat and txpk objects.
+	All multi-byte fields are big endian. Each rxpk and stat record starts with
+	its length so that a decoder can skip the fields added by later versions.
+*/
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <string.h>		/* memcpy */
+
+#include "binpk.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+/* rxpk record flags */
+#define RX_TIME		0x01	/* the UTC time is present */
+#define RX_SAME		0x02	/* radio settings omitted, same as the previous record */
+
+/* txpk body flags */
+#define TX_IMME		0x01
+#define TX_TIME		0x02	/* UTC time instead of timestamp */
+#define TX_IPOL		0x04
+#define TX_NCRC		0x08
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static int put16(uint8_t *out, uint16_t v){
+	out[0] = v >> 8;
+	out[1] = v;
+	return 2;
+}
+
+static int put32(uint8_t *out, uint32_t v){
+	out[0] = v >> 24;
+	out[1] = v >> 16;
+	out[2] = v >> 8;
+	out[3] = v;
+	return 4;
+}
+
+static int put64(uint8_t *out, uint64_t v){
+	put32(out, (uint32_t)(v >> 32));
+	return 4 + put32(out + 4, (uint32_t)v);
+}
+
+static uint16_t get16(const uint8_t *in){
+	return ((uint16_t)in[0] << 8) | in[1];
+}
+
+static uint32_t get32(const uint8_t *in){
+	return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+static uint64_t get64(const uint8_t *in){
+	return ((uint64_t)get32(in) << 32) | get32(in + 4);
+}
+
+static bool same_radio(const struct binpk_rx *a, const struct binpk_rx *b){
+	if(a->freq_hz != b->freq_hz || a->chan != b->chan || a->rfch != b->rfch || a->modu != b->modu){
+		return false;
+	}
+	if(a->modu == BINPK_LORA){
+		return a->sf == b->sf && a->bw_khz == b->bw_khz && a->codr == b->codr;
+	}
+	return a->datr == b->datr;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int binpk_rx_write(const struct binpk_rx *rx, const struct binpk_rx *prev, uint8_t *out, int max_len){
+	int n = 3;
+	uint8_t flags = 0;
+
+	if(max_len < BINPK_RX_FIXED_MAX + rx->size){
+		return -1;
+	}
+
+	n += put32(out + n, rx->tmst);
+	if(rx->has_time){
+		flags |= RX_TIME;
+		n += put64(out + n, rx->time_us);
+	}
+	if(prev != NULL && same_radio(rx, prev)){
+		flags |= RX_SAME;
+	}else{
+		n += put32(out + n, rx->freq_hz);
+		out[n++] = rx->chan;
+		out[n++] = rx->rfch;
+		out[n++] = rx->modu;
+		if(rx->modu == BINPK_LORA){
+			out[n++] = rx->sf;
+			n += put16(out + n, rx->bw_khz);
+			out[n++] = rx->codr;
+		}else{
+			n += put32(out + n, rx->datr);
+		}
+	}
+	out[n++] = (uint8_t)rx->stat;
+	n += put16(out + n, (uint16_t)rx->rssi);
+	n += put16(out + n, (uint16_t)rx->lsnr);
+	out[n++] = rx->size;
+	memcpy(out + n, rx->payload, rx->size);
+	n += rx->size;
+
+	put16(out, n - 2);
+	out[2] = flags;
+	return n;
+}
+
+int binpk_rx_read(const uint8_t *in, int len, struct binpk_rx *rx){
+	int n = 3;
+	int end;
+	uint8_t flags;
+
+	if(len < 2){
+		return -1;
+	}
+	end = 2 + get16(in);
+	if(end > len || end < 3 + 4 + 6){
+		return -1;
+	}
+	flags = in[2];
+
+	rx->tmst = get32(in + n);
+	n += 4;
+	rx->has_time = (flags & RX_TIME) != 0;
+	if(rx->has_time){
+		if(n + 8 > end) return -1;
+		rx->time_us = get64(in + n);
+		n += 8;
+	}
+	if(!(flags & RX_SAME)){
+		if(n + 7 > end) return -1;
+		rx->freq_hz = get32(in + n);
+		rx->chan = in[n + 4];
+		rx->rfch = in[n + 5];
+		rx->modu = in[n + 6];
+		n += 7;
+		if(n + 4 > end) return -1;
+		if(rx->modu == BINPK_LORA){
+			rx->sf = in[n];
+			rx->bw_khz = get16(in + n + 1);
+			rx->codr = in[n + 3];
+		}else{
+			rx->datr = get32(in + n);
+		}
+		n += 4;
+	}
+	if(rx->modu != BINPK_LORA && rx->modu != BINPK_FSK){
+		return -1; /* also catches a first record claiming the previous settings */
+	}
+	if(n + 6 > end) return -1;
+	rx->stat = (int8_t)in[n];
+	rx->rssi = (int16_t)get16(in + n + 1);
+	rx->lsnr = (int16_t)get16(in + n + 3);
+	rx->size = in[n + 5];
+	n += 6;
+	if(n + rx->size > end) return -1;
+	rx->payload = in + n;
+
+	return end; /* skip the fields unknown to this version */
+}
+
+int binpk_stat_write(const char *stat, int stat_len, uint8_t *out, int max_len){
+	if(stat_len < 0 || stat_len > 0xFFFF || max_len < 2 + stat_len){
+		return -1;
+	}
+	put16(out, stat_len);
+	memcpy(out + 2, stat, stat_len);
+	return 2 + stat_len;
+}
+
+int binpk_stat_read(const uint8_t *in, int len, const char **stat, int *stat_len){
+	if(len < 2 || 2 + get16(in) > len){
+		return -1;
+	}
+	*stat = (const char *)(in + 2);
+	*stat_len = get16(in);
+	return 2 + *stat_len;
+}
+
+int binpk_tx_write(const struct binpk_tx *tx, uint8_t *out, int max_len){
+	int n = 2;
+	uint8_t flags = 0;
+
+	if(max_len < BINPK_TX_FIXED_MAX + tx->size){
+		return -1;
+	}
+
+	if(tx->imme) flags |= TX_IMME;
+	if(tx->ipol) flags |= TX_IPOL;
+	if(tx->ncrc) flags |= TX_NCRC;
+	if(tx->has_time){
+		flags |= TX_TIME;
+		n += put64(out + n, tx->time_us);
+	}else{
+		n += put32(out + n, tx->tmst);
+	}
+	n += put32(out + n, tx->freq_hz);
+	out[n++] = tx->rfch;
+	out[n++] = (uint8_t)tx->powe;
+	out[n++] = tx->modu;
+	if(tx->modu == BINPK_LORA){
+		out[n++] = tx->sf;
+		n += put16(out + n, tx->bw_khz);
+		out[n++] = tx->codr;
+	}else{
+		n += put32(out + n, tx->datr);
+		n += put32(out + n, tx->fdev_hz);
+	}
+	n += put16(out + n, tx->prea);
+	out[n++] = tx->size;
+	memcpy(out + n, tx->payload, tx->size);
+	n += tx->size;
+
+	out[0] = BINPK_VERSION;
+	out[1] = flags;
+	return n;
+}
+
+int binpk_tx_read(const uint8_t *in, int len, struct binpk_tx *tx){
+	int n = 2;
+	uint8_t flags;
+
+	if(len < 2 || in[0] != BINPK_VERSION){
+		return -1;
+	}
+	flags = in[1];
+	tx->imme = (flags & TX_IMME) != 0;
+	tx->ipol = (flags & TX_IPOL) != 0;
+	tx->ncrc = (flags & TX_NCRC) != 0;
+	tx->has_time = (flags & TX_TIME) != 0;
+	if(tx->has_time){
+		if(n + 8 > len) return -1;
+		tx->time_us = get64(in + n);
+		tx->tmst = 0;
+		n += 8;
+	}else{
+		if(n + 4 > len) return -1;
+		tx->tmst = get32(in + n);
+		n += 4;
+	}
+	if(n + 7 > len) return -1;
+	tx->freq_hz = get32(in + n);
+	tx->rfch = in[n + 4];
+	tx->powe = (int8_t)in[n + 5];
+	tx->modu = in[n + 6];
+	n += 7;
+	if(tx->modu == BINPK_LORA){
+		if(n + 4 > len) return -1;
+		tx->sf = in[n];
+		tx->bw_khz = get16(in + n + 1);
+		tx->codr = in[n + 3];
+		n += 4;
+	}else if(tx->modu == BINPK_FSK){
+		if(n + 8 > len) return -1;
+		tx->datr = get32(in + n);
+		tx->fdev_hz = get32(in + n + 4);
+		n += 8;
+	}else{
+		return -1;
+	}
+	if(n + 3 > len) return -1;
+	tx->prea = get16(in + n);
+	tx->size = in[n + 2];
+	n += 3;
+	if(n + tx->size > len) return -1;
+	tx->payload = in + n;
+	return 0;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,199 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+/*
+Description:
+	ISO 8601 UTC timestamps, see isotime.h
+	Civil date <-> day count conversions are the classic era based algorithms
+	(proleptic Gregorian calendar), no libc time function is used.
+*/
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#ifdef __MACH__
+#elif __STDC_VERSION__ >= 199901L
+	#define _XOPEN_SOURCE 600
+#else
+	#define _XOPEN_SOURCE 500
+#endif
+
+#include <stdint.h>		/* C99 types */
+
+#include "isotime.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define SECS_PER_DAY	86400
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* write x on exactly 'width' digits, zero padded */
+static void put_digits(char *out, uint32_t x, int width) {
+	while (width > 0) {
+		out[--width] = '0' + (x % 10);
+		x /= 10;
+	}
+}
+
+/* read 1 to max_width digits, return the number of chars consumed (0 if none) */
+static int get_digits(const char *in, int max_width, int *x) {
+	int n = 0;
+	
+	*x = 0;
+	while ((n < max_width) && (in[n] >= '0') && (in[n] <= '9')) {
+		*x = (*x * 10) + (in[n] - '0');
+		++n;
+	}
+	return n;
+}
+
+/* days since 1970-01-01 to year/month/day */
+static void civil_from_days(long z, int *y, int *m, int *d) {
+	long era;
+	long doe, yoe, doy, mp;
+	
+	z += 719468;
+	era = ((z >= 0) ? z : (z - 146096)) / 146097;
+	doe = z - (era * 146097);									/* [0, 146096] */
+	yoe = (doe - (doe / 1460) + (doe / 36524) - (doe / 146096)) / 365;	/* [0, 399] */
+	doy = doe - ((365 * yoe) + (yoe / 4) - (yoe / 100));		/* [0, 365] */
+	mp = ((5 * doy) + 2) / 153;									/* [0, 11], March based */
+	*d = (int)(doy - (((153 * mp) + 2) / 5) + 1);
+	*m = (int)((mp < 10) ? (mp + 3) : (mp - 9));
+	*y = (int)(yoe + (era * 400) + (*m <= 2));
+}
+
+/* year/month/day to days since 1970-01-01 */
+static long days_from_civil(int y, int m, int d) {
+	long era, yoe, doy, doe;
+	
+	y -= (m <= 2);
+	era = ((y >= 0) ? y : (y - 399)) / 400;
+	yoe = y - (era * 400);
+	doy = (((153 * ((m > 2) ? (m - 3) : (m + 9))) + 2) / 5) + d - 1;
+	doe = (yoe * 365) + (yoe / 4) - (yoe / 100) + doy;
+	return (era * 146097) + doe - 719468;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+void isotime_cache_init(struct isotime_cache *cache) {
+	cache->sec = 0;
+	cache->valid = 0;
+	cache->str[ISOTIME_LEN] = 0;
+}
+
+const char *isotime_format(struct isotime_cache *cache, const struct timespec *utc) {
+	char *out = cache->str;
+	long days, secs;
+	int y, m, d;
+	
+	if (!cache->valid || (utc->tv_sec != cache->sec)) {
+		/* new second, rebuild the calendar part */
+		days = (long)(utc->tv_sec / SECS_PER_DAY);
+		secs = (long)(utc->tv_sec % SECS_PER_DAY);
+		if (secs < 0) {
+			secs += SECS_PER_DAY;
+			--days;
+		}
+		civil_from_days(days, &y, &m, &d);
+		put_digits(out, y, 4);
+		out[4] = '-';
+		put_digits(out + 5, m, 2);
+		out[7] = '-';
+		put_digits(out + 8, d, 2);
+		out[10] = 'T';
+		put_digits(out + 11, secs / 3600, 2);
+		out[13] = ':';
+		put_digits(out + 14, (secs / 60) % 60, 2);
+		out[16] = ':';
+		put_digits(out + 17, secs % 60, 2);
+		out[19] = '.';
+		out[26] = 'Z';
+		cache->sec = utc->tv_sec;
+		cache->valid = 1;
+	}
+	
+	/* only the microseconds change within a second */
+	put_digits(out + 20, utc->tv_nsec / 1000, 6);
+	return out;
+}
+
+int isotime_parse(const char *str, struct timespec *utc) {
+	int y, mo, d, h, mi, s;
+	long nsec = 0;
+	long scale = 100000000;
+	int n;
+	
+	/* date */
+	if (((n = get_digits(str, 4, &y)) == 0) || (str[n] != '-')) {
+		return -1;
+	}
+	str += n + 1;
+	if (((n = get_digits(str, 2, &mo)) == 0) || (str[n] != '-')) {
+		return -1;
+	}
+	str += n + 1;
+	if (((n = get_digits(str, 2, &d)) == 0) || (str[n] != 'T')) {
+		return -1;
+	}
+	str += n + 1;
+	
+	/* time of day */
+	if (((n = get_digits(str, 2, &h)) == 0) || (str[n] != ':')) {
+		return -1;
+	}
+	str += n + 1;
+	if (((n = get_digits(str, 2, &mi)) == 0) || (str[n] != ':')) {
+		return -1;
+	}
+	str += n + 1;
+	if ((n = get_digits(str, 2, &s)) == 0) {
+		return -1;
+	}
+	str += n;
+	
+	/* optional fraction of second, digits beyond the nanosecond are ignored */
+	if (*str == '.') {
+		++str;
+		while ((*str >= '0') && (*str <= '9')) {
+			nsec += (*str - '0') * scale;
+			scale /= 10;
+			++str;
+		}
+	}
+	
+	if ((mo < 1) || (mo > 12) || (d < 1) || (d > 31) || (h > 23) || (mi > 59) || (s > 60)) {
+		return -1;
+	}
+	
+	utc->tv_sec = ((time_t)days_from_civil(y, mo, d) * SECS_PER_DAY) + (h * 3600) + (mi * 60) + s;
+	utc->tv_nsec = nsec;
+	return 0;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
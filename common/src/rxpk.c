@@ -0,0 +1,269 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+/*
+Description:
+	Table-driven serialization of received packets as JSON rxpk objects.
+	The output is byte-identical to the historical snprintf based code, but
+	only fixed-width integer formatting is done on the hot path.
+*/
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#ifdef __MACH__
+#elif __STDC_VERSION__ >= 199901L
+	#define _XOPEN_SOURCE 600
+#else
+	#define _XOPEN_SOURCE 500
+#endif
+
+#include <stdio.h>		/* snprintf, only for out-of-range floats */
+#include <string.h>		/* memcpy */
+#include <stdbool.h>
+#include <math.h>		/* signbit */
+
+#include "rxpk.h"
+#include "base64.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+
+#define LIT(s)			{ s, sizeof(s) - 1 }
+
+#define PUT_LIT(l)		do { memcpy(out + n, (l).s, (l).len); n += (l).len; } while (0)
+#define PUT_STR(s)		do { memcpy(out + n, s, sizeof(s) - 1); n += sizeof(s) - 1; } while (0)
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define FLOAT_TXT_MAX	48	/* max length of a float printed by the slow path, FLT_MAX is 39 digits */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct lit {
+	const char	*s;		/* literal JSON fragment, no null char */
+	uint8_t		len;	/* length of the fragment */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+/* fragments indexed by the HAL values, an empty entry means "invalid" */
+static const struct lit stat_lit[STAT_CRC_BAD + 1] = {
+	[STAT_CRC_OK]	= LIT(",\"stat\":1"),
+	[STAT_CRC_BAD]	= LIT(",\"stat\":-1"),
+	[STAT_NO_CRC]	= LIT(",\"stat\":0")
+};
+
+static const struct lit datr_lit[DR_LORA_SF12 + 1] = {
+	[DR_LORA_SF7]	= LIT(",\"datr\":\"SF7"),
+	[DR_LORA_SF8]	= LIT(",\"datr\":\"SF8"),
+	[DR_LORA_SF9]	= LIT(",\"datr\":\"SF9"),
+	[DR_LORA_SF10]	= LIT(",\"datr\":\"SF10"),
+	[DR_LORA_SF11]	= LIT(",\"datr\":\"SF11"),
+	[DR_LORA_SF12]	= LIT(",\"datr\":\"SF12")
+};
+
+static const struct lit bw_lit[BW_125KHZ + 1] = {
+	[BW_125KHZ]		= LIT("BW125\""),
+	[BW_250KHZ]		= LIT("BW250\""),
+	[BW_500KHZ]		= LIT("BW500\"")
+};
+
+static const struct lit codr_lit[CR_LORA_4_8 + 1] = {
+	[CR_LORA_4_5]	= LIT(",\"codr\":\"4/5\""),
+	[CR_LORA_4_6]	= LIT(",\"codr\":\"4/6\""),
+	[CR_LORA_4_7]	= LIT(",\"codr\":\"4/7\""),
+	[CR_LORA_4_8]	= LIT(",\"codr\":\"4/8\""),
+	[0]				= LIT(",\"codr\":\"OFF\"") /* CR0 case (mostly false sync) */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* write x in decimal, return the number of chars written (1-10) */
+static int put_u32(char *out, uint32_t x) {
+	char tmp[10];
+	int i = 0;
+	int n;
+	
+	do {
+		tmp[i++] = '0' + (x % 10);
+		x /= 10;
+	} while (x != 0);
+	for (n = 0; i > 0; ++n) {
+		out[n] = tmp[--i];
+	}
+	return n;
+}
+
+/* write x on exactly 'width' digits, zero padded */
+static void put_u32_fixed(char *out, uint32_t x, int width) {
+	while (width > 0) {
+		out[--width] = '0' + (x % 10);
+		x /= 10;
+	}
+}
+
+/**
+@brief Same output as printf "%.1f" (tenths = true) or "%.0f" (tenths = false)
+@return number of chars written, -1 if the value is out of the fast path range
+A float times 10 is exact in a double, so rounding the scaled value to the
+nearest integer (ties to even, like the C library) gives the printf digits.
+*/
+static int put_fixed(char *out, float x, bool tenths) {
+	double v = tenths ? ((double)x * 10.0) : (double)x;
+	bool neg = signbit(v);
+	uint32_t t;
+	double r;
+	int n = 0;
+	
+	if (neg) {
+		v = -v;
+	}
+	if (!(v < 1e9)) { /* also catches NaN */
+		return -1;
+	}
+	t = (uint32_t)v;
+	r = v - (double)t; /* exact */
+	if ((r > 0.5) || ((r == 0.5) && (t & 1))) {
+		++t;
+	}
+	
+	if (neg) {
+		out[n++] = '-';
+	}
+	if (tenths) {
+		n += put_u32(out + n, t / 10);
+		out[n++] = '.';
+		out[n++] = '0' + (t % 10);
+	} else {
+		n += put_u32(out + n, t);
+	}
+	return n;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int rxpk_serialize(const struct lgw_pkt_rx_s *p, const char *time_str, char *out, int max_len) {
+	int n = 0;
+	int j;
+	
+	/* one bound check for the whole object, the fixed part has a known max size */
+	if (max_len < (RXPK_FIXED_MAX + 4 * ((p->size + 2) / 3) + 1)) {
+		return -1;
+	}
+	
+	/* RAW timestamp, 8-17 useful chars */
+	PUT_STR("{\"tmst\":");
+	n += put_u32(out + n, p->count_us);
+	
+	/* Packet RX time, 37 useful chars */
+	if (time_str != NULL) {
+		PUT_STR(",\"time\":\"");
+		memcpy(out + n, time_str, ISOTIME_LEN);
+		n += ISOTIME_LEN;
+		out[n++] = '"';
+	}
+	
+	/* Packet concentrator channel, RF chain & RX frequency, 34-36 useful chars */
+	PUT_STR(",\"chan\":");
+	n += put_u32(out + n, p->if_chain);
+	PUT_STR(",\"rfch\":");
+	n += put_u32(out + n, p->rf_chain);
+	PUT_STR(",\"freq\":");
+	n += put_u32(out + n, p->freq_hz / 1000000);
+	out[n++] = '.';
+	put_u32_fixed(out + n, p->freq_hz % 1000000, 6);
+	n += 6;
+	
+	/* Packet status, 9-10 useful chars */
+	if ((p->status >= ARRAY_SIZE(stat_lit)) || (stat_lit[p->status].s == NULL)) {
+		return -1;
+	}
+	PUT_LIT(stat_lit[p->status]);
+	
+	/* Packet modulation, datarate, bandwidth, coding rate & SNR */
+	if (p->modulation == MOD_LORA) {
+		if ((p->datarate >= ARRAY_SIZE(datr_lit)) || (datr_lit[p->datarate].s == NULL)) {
+			return -1;
+		}
+		if ((p->bandwidth >= ARRAY_SIZE(bw_lit)) || (bw_lit[p->bandwidth].s == NULL)) {
+			return -1;
+		}
+		if ((p->coderate >= ARRAY_SIZE(codr_lit)) || (codr_lit[p->coderate].s == NULL)) {
+			return -1;
+		}
+		PUT_STR(",\"modu\":\"LORA\"");
+		PUT_LIT(datr_lit[p->datarate]);
+		PUT_LIT(bw_lit[p->bandwidth]);
+		PUT_LIT(codr_lit[p->coderate]);
+		PUT_STR(",\"lsnr\":");
+		j = put_fixed(out + n, p->snr, true);
+		if (j < 0) {
+			j = snprintf(out + n, max_len - n, "%.1f", p->snr);
+			if ((j < 0) || (j > FLOAT_TXT_MAX)) {
+				return -1;
+			}
+		}
+		n += j;
+	} else if (p->modulation == MOD_FSK) {
+		PUT_STR(",\"modu\":\"FSK\"");
+		PUT_STR(",\"datr\":");
+		n += put_u32(out + n, p->datarate);
+	} else {
+		return -1;
+	}
+	
+	/* Packet RSSI, payload size, 18-23 useful chars */
+	PUT_STR(",\"rssi\":");
+	j = put_fixed(out + n, p->rssi, false);
+	if (j < 0) {
+		j = snprintf(out + n, max_len - n, "%.0f", p->rssi);
+		if ((j < 0) || (j > FLOAT_TXT_MAX)) {
+			return -1;
+		}
+	}
+	n += j;
+	PUT_STR(",\"size\":");
+	n += put_u32(out + n, p->size);
+	
+	/* Packet base64-encoded payload, 14-350 useful chars */
+	PUT_STR(",\"data\":\"");
+	j = bin_to_b64(p->payload, p->size, out + n, max_len - n);
+	if (j < 0) {
+		return -1;
+	}
+	n += j;
+	out[n++] = '"';
+	out[n++] = '}';
+	
+	return n;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,361 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+/*
+Description:
+	Single-pass decoder of the JSON txpk objects. The keys of the txpk schema
+	are all 4 chars long, they are switched on as a 32-bit word.
+*/
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#ifdef __MACH__
+#elif __STDC_VERSION__ >= 199901L
+	#define _XOPEN_SOURCE 600
+#else
+	#define _XOPEN_SOURCE 500
+#endif
+
+#include <string.h>		/* memset, memcpy */
+#include <stdbool.h>	/* bool type */
+#include <time.h>		/* struct timespec */
+
+#include "txpk.h"
+#include "base64.h"
+#include "isotime.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define KEY(a,b,c,d)	(((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d))
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define MICRO			1000000LL	/* numbers are read as fixed-point values with 6 decimals */
+#define NUM_MAX			(4294967296LL * MICRO)	/* larger values do not fit any field */
+#define TIME_STR_MAX	40
+
+/* fields seen */
+#define F_TMST		0x0001
+#define F_TIME		0x0002
+#define F_FREQ		0x0004
+#define F_RFCH		0x0008
+#define F_MODU		0x0010
+#define F_DATR		0x0020
+#define F_CODR		0x0040
+#define F_FDEV		0x0080
+#define F_SIZE		0x0100
+#define F_DATA		0x0200
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+struct cursor {
+	const char		*p;
+	const char		*end;
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static void skip_ws(struct cursor *c){
+	while((c->p < c->end) && ((*c->p == ' ') || (*c->p == '\t') || (*c->p == '\n') || (*c->p == '\r'))){
+		++c->p;
+	}
+}
+
+/* expect a char after optional white space */
+static bool expect(struct cursor *c, char ch){
+	skip_ws(c);
+	if((c->p < c->end) && (*c->p == ch)){
+		++c->p;
+		return true;
+	}
+	return false;
+}
+
+/* string without escape, returns its length and points to its first char */
+static int string(struct cursor *c, const char **str){
+	const char *p;
+
+	if(!expect(c, '"')){
+		return -1;
+	}
+	for(p = c->p; (p < c->end) && (*p != '"'); ++p){
+		if((*p == '\\') || ((unsigned char)*p < 0x20)){
+			return -1;
+		}
+	}
+	if(p == c->end){
+		return -1;
+	}
+	*str = c->p;
+	c->p = p + 1;
+	return (int)(p - *str);
+}
+
+/* number as a fixed-point value with 6 decimals, further decimals are truncated, no exponent */
+static bool number(struct cursor *c, long long *v){
+	bool neg = false;
+	long long ip = 0, fp = 0, scale = MICRO;
+	int nb_digit = 0;
+
+	skip_ws(c);
+	if((c->p < c->end) && (*c->p == '-')){
+		neg = true;
+		++c->p;
+	}
+	while((c->p < c->end) && (*c->p >= '0') && (*c->p <= '9')){
+		ip = 10 * ip + (*c->p++ - '0');
+		if(ip * MICRO >= NUM_MAX){
+			return false;
+		}
+		++nb_digit;
+	}
+	if((c->p < c->end) && (*c->p == '.')){
+		++c->p;
+		while((c->p < c->end) && (*c->p >= '0') && (*c->p <= '9')){
+			if(scale > 1){
+				scale /= 10;
+				fp += scale * (*c->p - '0');
+			}
+			++c->p;
+			++nb_digit;
+		}
+	}
+	if((nb_digit == 0) || ((c->p < c->end) && ((*c->p == 'e') || (*c->p == 'E')))){
+		return false;
+	}
+	*v = ip * MICRO + fp;
+	if(neg){
+		*v = -*v;
+	}
+	return true;
+}
+
+static bool boolean(struct cursor *c, bool *b){
+	skip_ws(c);
+	if((c->end - c->p >= 4) && (memcmp(c->p, "true", 4) == 0)){
+		c->p += 4;
+		*b = true;
+		return true;
+	}
+	if((c->end - c->p >= 5) && (memcmp(c->p, "false", 5) == 0)){
+		c->p += 5;
+		*b = false;
+		return true;
+	}
+	return false;
+}
+
+/* "SF7BW125" to "SF12BW500" */
+static bool lora_datr(const char *s, int len, struct binpk_tx *tx){
+	int i = 2, sf = 0, bw = 0;
+
+	if((len < 7) || (s[0] != 'S') || (s[1] != 'F')){
+		return false;
+	}
+	while((i < len) && (i < 4) && (s[i] >= '0') && (s[i] <= '9')){
+		sf = 10 * sf + (s[i++] - '0');
+	}
+	if((i + 5 > len) || (s[i] != 'B') || (s[i + 1] != 'W')){
+		return false;
+	}
+	for(i += 2; (i < len) && (s[i] >= '0') && (s[i] <= '9') && (bw < 100); ++i){
+		bw = 10 * bw + (s[i] - '0');
+		if(bw == 0){
+			return false;
+		}
+	}
+	if((i != len) || (sf < 7) || (sf > 12) || ((bw != 125) && (bw != 250) && (bw != 500))){ /* nothing may follow the bandwidth */
+		return false;
+	}
+	tx->sf = (uint8_t)sf;
+	tx->bw_khz = (uint16_t)bw;
+	return true;
+}
+
+static bool lora_codr(const char *s, int len, struct binpk_tx *tx){
+	if(len != 3){
+		return false;
+	}
+	switch(KEY(0, s[0], s[1], s[2])){
+		case KEY(0,'4','/','5'): tx->codr = 5; return true;
+		case KEY(0,'4','/','6'):
+		case KEY(0,'2','/','3'): tx->codr = 6; return true;
+		case KEY(0,'4','/','7'): tx->codr = 7; return true;
+		case KEY(0,'4','/','8'):
+		case KEY(0,'1','/','2'): tx->codr = 8; return true;
+		default: return false;
+	}
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int txpk_json_read(const char *json, int len, struct binpk_tx *tx, uint8_t *payload, int max_len){
+	struct cursor c = {json, json + len};
+	const char *s, *datr_str = NULL, *data_str = NULL;
+	int n, datr_len = 0, data_len = 0;
+	long long v, datr_num = 0;
+	unsigned seen = 0;
+	char time_str[TIME_STR_MAX];
+	struct timespec utc;
+
+	memset(tx, 0, sizeof *tx);
+
+	/* {"txpk":{ */
+	if(!expect(&c, '{') || (string(&c, &s) != 4) || (memcmp(s, "txpk", 4) != 0) || !expect(&c, ':') || !expect(&c, '{')){
+		return -1;
+	}
+	if(expect(&c, '}')){
+		return -1;
+	}
+	do{
+		if((string(&c, &s) != 4) || !expect(&c, ':')){
+			return -1;
+		}
+		switch(KEY(s[0], s[1], s[2], s[3])){
+			case KEY('i','m','m','e'):
+				if(!boolean(&c, &tx->imme)) return -1;
+				break;
+			case KEY('t','m','s','t'):
+				if(!number(&c, &v) || (v < 0)) return -1;
+				tx->tmst = (uint32_t)(v / MICRO);
+				seen |= F_TMST;
+				break;
+			case KEY('t','i','m','e'):
+				n = string(&c, &s);
+				if((n < 0) || (n >= TIME_STR_MAX)) return -1;
+				memcpy(time_str, s, n);
+				time_str[n] = 0;
+				if(isotime_parse(time_str, &utc) != 0) return -1;
+				tx->time_us = (uint64_t)utc.tv_sec * 1000000 + (uint64_t)(utc.tv_nsec / 1000);
+				seen |= F_TIME;
+				break;
+			case KEY('f','r','e','q'):
+				if(!number(&c, &v) || (v < 0)) return -1;
+				tx->freq_hz = (uint32_t)v; /* MHz with 6 decimals, ie. Hz */
+				seen |= F_FREQ;
+				break;
+			case KEY('r','f','c','h'):
+				if(!number(&c, &v) || (v < 0)) return -1;
+				tx->rfch = (uint8_t)(v / MICRO);
+				seen |= F_RFCH;
+				break;
+			case KEY('p','o','w','e'):
+				if(!number(&c, &v)) return -1;
+				tx->powe = (int8_t)(v / MICRO);
+				break;
+			case KEY('m','o','d','u'):
+				n = string(&c, &s);
+				if((n == 4) && (memcmp(s, "LORA", 4) == 0)) tx->modu = BINPK_LORA;
+				else if((n == 3) && (memcmp(s, "FSK", 3) == 0)) tx->modu = BINPK_FSK;
+				else return -1;
+				seen |= F_MODU;
+				break;
+			case KEY('d','a','t','r'):
+				/* a string for LoRa, a number for FSK, checked once the modulation is known */
+				skip_ws(&c);
+				if((c.p < c.end) && (*c.p == '"')){
+					datr_len = string(&c, &datr_str);
+					if(datr_len < 0) return -1;
+				}else{
+					if(!number(&c, &datr_num) || (datr_num < 0)) return -1;
+					datr_str = NULL;
+				}
+				seen |= F_DATR;
+				break;
+			case KEY('c','o','d','r'):
+				n = string(&c, &s);
+				if((n < 0) || !lora_codr(s, n, tx)) return -1;
+				seen |= F_CODR;
+				break;
+			case KEY('f','d','e','v'):
+				if(!number(&c, &v) || (v < 0)) return -1;
+				tx->fdev_hz = (uint32_t)(v / MICRO);
+				seen |= F_FDEV;
+				break;
+			case KEY('i','p','o','l'):
+				if(!boolean(&c, &tx->ipol)) return -1;
+				break;
+			case KEY('p','r','e','a'):
+				if(!number(&c, &v) || (v < 0) || (v / MICRO > 0xFFFF)) return -1;
+				tx->prea = (uint16_t)(v / MICRO);
+				if(tx->prea == 0) tx->prea = 1; /* 0 is the default preamble in a binpk, a given one is raised to the minimum */
+				break;
+			case KEY('s','i','z','e'):
+				if(!number(&c, &v) || (v < 0) || (v / MICRO > 255)) return -1;
+				tx->size = (uint8_t)(v / MICRO);
+				seen |= F_SIZE;
+				break;
+			case KEY('d','a','t','a'):
+				data_len = string(&c, &data_str);
+				if(data_len < 0) return -1;
+				seen |= F_DATA;
+				break;
+			case KEY('n','c','r','c'):
+				if(!boolean(&c, &tx->ncrc)) return -1;
+				break;
+			default:
+				return -1;
+		}
+	}while(expect(&c, ','));
+	if(!expect(&c, '}') || !expect(&c, '}')){
+		return -1;
+	}
+	skip_ws(&c);
+	if((c.p != c.end) && (*c.p != 0)){
+		return -1;
+	}
+
+	/* mandatory fields, the timestamp wins over the UTC time */
+	if(!tx->imme && !(seen & (F_TMST | F_TIME))){
+		return -1;
+	}
+	tx->has_time = !tx->imme && !(seen & F_TMST);
+	if((seen & (F_FREQ | F_RFCH | F_MODU | F_DATR | F_SIZE | F_DATA)) != (F_FREQ | F_RFCH | F_MODU | F_DATR | F_SIZE | F_DATA)){
+		return -1;
+	}
+	if(tx->modu == BINPK_LORA){
+		if((datr_str == NULL) || !lora_datr(datr_str, datr_len, tx) || !(seen & F_CODR)){
+			return -1;
+		}
+	}else{
+		if((datr_str != NULL) || !(seen & F_FDEV)){
+			return -1;
+		}
+		tx->datr = (uint32_t)(datr_num / MICRO);
+	}
+
+	/* the payload must match its announced size */
+	if(b64_to_bin(data_str, data_len, payload, max_len) != tx->size){
+		return -1;
+	}
+	tx->payload = payload;
+	return 0;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
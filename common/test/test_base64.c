@@ -0,0 +1,230 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+/*
+Description:
+	Test of the Base64 library: the SIMD kernels built for this target (SSSE3
+	on x86, NEON on ARM) are checked against the scalar code, built apart with
+	B64_NO_SIMD and its functions renamed with a ref_ prefix, on random
+	payloads, invalid chars at every position and padded strings.
+	With -b, times both builds on LoRa sized payloads instead.
+*/
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#ifdef __MACH__
+#elif __STDC_VERSION__ >= 199901L
+	#define _XOPEN_SOURCE 600
+#else
+	#define _XOPEN_SOURCE 500
+#endif
+
+#include <stdio.h>		/* printf */
+#include <stdlib.h>		/* EXIT_* */
+#include <string.h>		/* memcmp, strcmp */
+#include <time.h>		/* clock_gettime */
+
+#include "base64.h"
+
+/* scalar build of base64.c, see the Makefile */
+int ref_bin_to_b64_nopad(const uint8_t * in, int size, char * out, int max_len);
+int ref_b64_to_bin_nopad(const char * in, int size, uint8_t * out, int max_len);
+int ref_bin_to_b64(const uint8_t * in, int size, char * out, int max_len);
+int ref_b64_to_bin(const char * in, int size, uint8_t * out, int max_len);
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+#define CHECK(cond, ...)	do { if (!(cond)) { printf("FAIL line %u: ", __LINE__); printf(__VA_ARGS__); printf("\n"); ++nb_fail; } } while (0)
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define SIZE_MAX_TEST	600		/* longest random payload, several SIMD blocks plus any remainder */
+#define ROUNDS			20		/* random payloads per size */
+#define BENCH_SIZE		256		/* max LoRa payload */
+#define BENCH_LOOPS		200000
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static unsigned nb_fail = 0;
+static uint32_t rnd_state = 0x12345678;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* xorshift32, the same sequence on every run and target */
+static uint32_t rnd(void) {
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state;
+}
+
+static double elapsed_ns(const struct timespec *a, const struct timespec *b) {
+	return 1e9 * (double)(b->tv_sec - a->tv_sec) + (double)(b->tv_nsec - a->tv_nsec);
+}
+
+/* encode and decode random payloads of every size with both builds, padded or not */
+static void test_round_trip(void) {
+	uint8_t in[SIZE_MAX_TEST], out[SIZE_MAX_TEST], ref_out[SIZE_MAX_TEST];
+	char str[2 * SIZE_MAX_TEST], ref_str[2 * SIZE_MAX_TEST];
+	int size, round, i, n, ref_n;
+	
+	for (size = 0; size <= SIZE_MAX_TEST; ++size) {
+		for (round = 0; round < ROUNDS; ++round) {
+			for (i = 0; i < size; ++i) {
+				in[i] = (uint8_t)rnd();
+			}
+			
+			n = bin_to_b64_nopad(in, size, str, sizeof str);
+			ref_n = ref_bin_to_b64_nopad(in, size, ref_str, sizeof ref_str);
+			CHECK((n == ref_n) && (n >= 0) && (strcmp(str, ref_str) == 0), "nopad encoding of %i bytes differs", size);
+			n = b64_to_bin_nopad(str, n, out, sizeof out);
+			ref_n = ref_b64_to_bin_nopad(ref_str, ref_n, ref_out, sizeof ref_out);
+			CHECK((n == size) && (ref_n == size) && (memcmp(out, in, size) == 0) && (memcmp(ref_out, in, size) == 0), "nopad decoding of %i bytes differs", size);
+			
+			n = bin_to_b64(in, size, str, sizeof str);
+			ref_n = ref_bin_to_b64(in, size, ref_str, sizeof ref_str);
+			CHECK((n == ref_n) && (n % 4 == 0) && (strcmp(str, ref_str) == 0), "padded encoding of %i bytes differs", size);
+			n = b64_to_bin(str, n, out, sizeof out);
+			ref_n = ref_b64_to_bin(ref_str, ref_n, ref_out, sizeof ref_out);
+			CHECK((n == size) && (ref_n == size) && (memcmp(out, in, size) == 0) && (memcmp(ref_out, in, size) == 0), "padded decoding of %i bytes differs", size);
+		}
+	}
+}
+
+/* an invalid char is refused wherever it is, in the SIMD blocks or the scalar remainder */
+static void test_invalid(void) {
+	static const char bad[] = {'!', '-', '_', '.', ' ', '=', '\0', '\n', (char)0x80, (char)0xFF};
+	uint8_t in[SIZE_MAX_TEST / 2], out[SIZE_MAX_TEST];
+	char str[SIZE_MAX_TEST];
+	int size, len, pos, i;
+	unsigned k = 0;
+	
+	for (size = 1; size <= (int)sizeof in; size += 7) {
+		for (i = 0; i < size; ++i) {
+			in[i] = (uint8_t)rnd();
+		}
+		len = bin_to_b64_nopad(in, size, str, sizeof str);
+		for (pos = 0; pos < len; ++pos) {
+			char c = str[pos];
+			str[pos] = bad[k++ % ARRAY_SIZE(bad)];
+			CHECK(b64_to_bin_nopad(str, len, out, sizeof out) == -1, "char 0x%02X at %i of %i accepted", (uint8_t)str[pos], pos, len);
+			CHECK(ref_b64_to_bin_nopad(str, len, out, sizeof out) == -1, "char 0x%02X at %i of %i accepted by the scalar code", (uint8_t)str[pos], pos, len);
+			str[pos] = c;
+		}
+		CHECK(b64_to_bin_nopad(str, len, out, sizeof out) == size, "restored string of %i chars refused", len);
+	}
+	
+	/* a single char left, or a buffer too small */
+	CHECK(b64_to_bin_nopad("Zm9vY", 5, out, sizeof out) == -1, "5 chars accepted");
+	CHECK(b64_to_bin_nopad("Zm9vYg", 6, out, 3) == -1, "decoded beyond the buffer");
+	CHECK(bin_to_b64_nopad(in, 3, str, 4) == -1, "encoded beyond the buffer");
+}
+
+/* RFC 4648 test vectors, and misplaced padding */
+static void test_padding(void) {
+	static const char *vec[][2] = {
+		{"", ""}, {"f", "Zg=="}, {"fo", "Zm8="}, {"foo", "Zm9v"},
+		{"foob", "Zm9vYg=="}, {"fooba", "Zm9vYmE="}, {"foobar", "Zm9vYmFy"}
+	};
+	static const char *bad[] = {"Zg=a", "Z===", "====", "Zm=v", "Zg==Zg==", "Zm9v="};
+	uint8_t out[16];
+	char str[16];
+	unsigned i;
+	int n;
+	
+	for (i = 0; i < ARRAY_SIZE(vec); ++i) {
+		int len = (int)strlen(vec[i][0]);
+		n = bin_to_b64((const uint8_t *)vec[i][0], len, str, sizeof str);
+		CHECK((n == (int)strlen(vec[i][1])) && (strcmp(str, vec[i][1]) == 0), "\"%s\" encoded as \"%s\"", vec[i][0], str);
+		n = b64_to_bin(vec[i][1], (int)strlen(vec[i][1]), out, sizeof out);
+		CHECK((n == len) && (memcmp(out, vec[i][0], len) == 0), "\"%s\" decoded to %i bytes", vec[i][1], n);
+		n = b64_to_bin(vec[i][1], (int)strcspn(vec[i][1], "="), out, sizeof out);
+		CHECK((n == len) && (memcmp(out, vec[i][0], len) == 0), "\"%s\" without its padding decoded to %i bytes", vec[i][1], n);
+	}
+	for (i = 0; i < ARRAY_SIZE(bad); ++i) {
+		n = b64_to_bin(bad[i], (int)strlen(bad[i]), out, sizeof out);
+		CHECK(n == -1, "\"%s\" decoded to %i bytes", bad[i], n);
+	}
+}
+
+/* time the encoding and decoding of a max size LoRa payload with both builds */
+static void bench(void) {
+	uint8_t in[BENCH_SIZE], out[BENCH_SIZE];
+	char str[2 * BENCH_SIZE];
+	struct timespec t0, t1, t2, t3, t4;
+	int i, len = 0;
+	unsigned sum = 0; /* keeps the calls from being optimized away */
+	
+	for (i = 0; i < BENCH_SIZE; ++i) {
+		in[i] = (uint8_t)rnd();
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < BENCH_LOOPS; ++i) {
+		len = bin_to_b64(in, BENCH_SIZE, str, sizeof str);
+		sum += (uint8_t)str[i % len];
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	for (i = 0; i < BENCH_LOOPS; ++i) {
+		len = ref_bin_to_b64(in, BENCH_SIZE, str, sizeof str);
+		sum += (uint8_t)str[i % len];
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	for (i = 0; i < BENCH_LOOPS; ++i) {
+		sum += b64_to_bin(str, len, out, sizeof out);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t3);
+	for (i = 0; i < BENCH_LOOPS; ++i) {
+		sum += ref_b64_to_bin(str, len, out, sizeof out);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t4);
+	
+	printf("base64 of %i bytes, ns per call (SIMD / scalar):\n", BENCH_SIZE);
+	printf("  encode %8.1f / %8.1f\n", elapsed_ns(&t0, &t1) / BENCH_LOOPS, elapsed_ns(&t1, &t2) / BENCH_LOOPS);
+	printf("  decode %8.1f / %8.1f\n", elapsed_ns(&t2, &t3) / BENCH_LOOPS, elapsed_ns(&t3, &t4) / BENCH_LOOPS);
+	printf("  (checksum %u)\n", sum);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+	if ((argc > 1) && (strcmp(argv[1], "-b") == 0)) {
+		bench();
+		return EXIT_SUCCESS;
+	}
+	
+	test_round_trip();
+	test_invalid();
+	test_padding();
+	
+	printf("test_base64: %s (%u failures)\n", (nb_fail == 0) ? "PASS" : "FAIL", nb_fail);
+	return (nb_fail == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,362 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+/*
+Description:
+	Test of the rxpk serializer against the snprintf and memcpy code it
+	replaced: the whole objects must be byte-identical for every status,
+	modulation, datarate, bandwidth and coding rate, and put_fixed() must give
+	the same bytes as the snprintf "%.1f" (lsnr) and "%.0f" (rssi) on the ties
+	to even, the negative zeros and random floats.
+	With -b, times both instead.
+*/
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* the static functions are tested, the module is built in */
+#include "../src/rxpk.c"
+
+#include <stdlib.h>		/* EXIT_* */
+#include <time.h>		/* clock_gettime */
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define CHECK(cond, ...)	do { if (!(cond)) { printf("FAIL line %u: ", __LINE__); printf(__VA_ARGS__); printf("\n"); ++nb_fail; } } while (0)
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define TIE_RANGE		2000		/* ties checked from -TIE_RANGE to TIE_RANGE */
+#define TIE_ULPS		4			/* floats checked on each side of a tie */
+#define RANDOM_FLOATS	2000000
+#define BENCH_LOOPS		2000000
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static unsigned nb_fail = 0;
+static unsigned nb_checked = 0;
+static uint32_t rnd_state = 0x12345678;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* the serialization of the forwarders before rxpk.c, -1 where they exited */
+static int ref_serialize(const struct lgw_pkt_rx_s *p, const char *time_str, char *out, int max_len) {
+	int n = 0;
+	int j;
+	
+	n += snprintf(out + n, max_len - n, "{\"tmst\":%u", p->count_us);
+	if (time_str != NULL) {
+		memcpy(out + n, ",\"time\":\"???????????????????????????\"", 37);
+		memcpy(out + n + 9, time_str, 27);
+		n += 37;
+	}
+	n += snprintf(out + n, max_len - n, ",\"chan\":%1u,\"rfch\":%1u,\"freq\":%.6lf", p->if_chain, p->rf_chain, ((double)p->freq_hz / 1e6));
+	switch (p->status) {
+		case STAT_CRC_OK:	memcpy(out + n, ",\"stat\":1", 9); n += 9; break;
+		case STAT_CRC_BAD:	memcpy(out + n, ",\"stat\":-1", 10); n += 10; break;
+		case STAT_NO_CRC:	memcpy(out + n, ",\"stat\":0", 9); n += 9; break;
+		default:			return -1;
+	}
+	if (p->modulation == MOD_LORA) {
+		memcpy(out + n, ",\"modu\":\"LORA\"", 14);
+		n += 14;
+		switch (p->datarate) {
+			case DR_LORA_SF7:	memcpy(out + n, ",\"datr\":\"SF7", 12); n += 12; break;
+			case DR_LORA_SF8:	memcpy(out + n, ",\"datr\":\"SF8", 12); n += 12; break;
+			case DR_LORA_SF9:	memcpy(out + n, ",\"datr\":\"SF9", 12); n += 12; break;
+			case DR_LORA_SF10:	memcpy(out + n, ",\"datr\":\"SF10", 13); n += 13; break;
+			case DR_LORA_SF11:	memcpy(out + n, ",\"datr\":\"SF11", 13); n += 13; break;
+			case DR_LORA_SF12:	memcpy(out + n, ",\"datr\":\"SF12", 13); n += 13; break;
+			default:			return -1;
+		}
+		switch (p->bandwidth) {
+			case BW_125KHZ:		memcpy(out + n, "BW125\"", 6); n += 6; break;
+			case BW_250KHZ:		memcpy(out + n, "BW250\"", 6); n += 6; break;
+			case BW_500KHZ:		memcpy(out + n, "BW500\"", 6); n += 6; break;
+			default:			return -1;
+		}
+		switch (p->coderate) {
+			case CR_LORA_4_5:	memcpy(out + n, ",\"codr\":\"4/5\"", 13); n += 13; break;
+			case CR_LORA_4_6:	memcpy(out + n, ",\"codr\":\"4/6\"", 13); n += 13; break;
+			case CR_LORA_4_7:	memcpy(out + n, ",\"codr\":\"4/7\"", 13); n += 13; break;
+			case CR_LORA_4_8:	memcpy(out + n, ",\"codr\":\"4/8\"", 13); n += 13; break;
+			case 0:				memcpy(out + n, ",\"codr\":\"OFF\"", 13); n += 13; break;
+			default:			return -1;
+		}
+		n += snprintf(out + n, max_len - n, ",\"lsnr\":%.1f", p->snr);
+	} else if (p->modulation == MOD_FSK) {
+		memcpy(out + n, ",\"modu\":\"FSK\"", 13);
+		n += 13;
+		n += snprintf(out + n, max_len - n, ",\"datr\":%u", p->datarate);
+	} else {
+		return -1;
+	}
+	n += snprintf(out + n, max_len - n, ",\"rssi\":%.0f,\"size\":%u", p->rssi, p->size);
+	memcpy(out + n, ",\"data\":\"", 9);
+	n += 9;
+	j = bin_to_b64(p->payload, p->size, out + n, 341);
+	if (j < 0) {
+		return -1;
+	}
+	n += j;
+	out[n++] = '"';
+	out[n++] = '}';
+	return n;
+}
+
+/* xorshift32, the same sequence on every run and target */
+static uint32_t rnd(void) {
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state;
+}
+
+static double elapsed_ns(const struct timespec *a, const struct timespec *b) {
+	return 1e9 * (double)(b->tv_sec - a->tv_sec) + (double)(b->tv_nsec - a->tv_nsec);
+}
+
+/* rxpk_serialize against the former code, byte for byte, both refusing the same packets */
+static void check_object(const struct lgw_pkt_rx_s *p, const char *time_str) {
+	char out[RXPK_MAX_SIZE], ref[RXPK_MAX_SIZE + 64];
+	int n, ref_n;
+	
+	n = rxpk_serialize(p, time_str, out, sizeof out);
+	ref_n = ref_serialize(p, time_str, ref, sizeof ref);
+	CHECK((n == ref_n) && ((n < 0) || (memcmp(out, ref, n) == 0)), "status 0x%02X modulation 0x%02X datarate 0x%X bandwidth 0x%02X coderate 0x%02X size %u: \"%.*s\", \"%.*s\" expected", p->status, p->modulation, p->datarate, p->bandwidth, p->coderate, p->size, (n > 0) ? n : 0, out, (ref_n > 0) ? ref_n : 0, ref);
+	++nb_checked;
+}
+
+/* put_fixed against snprintf, byte for byte, or refused and left to snprintf */
+static void check(float x) {
+	char fast[FLOAT_TXT_MAX + 1], ref[64];
+	int tenths, n, ref_n;
+	
+	for (tenths = 0; tenths < 2; ++tenths) {
+		n = put_fixed(fast, x, tenths);
+		ref_n = snprintf(ref, sizeof ref, tenths ? "%.1f" : "%.0f", x);
+		if (n >= 0) {
+			CHECK((n == ref_n) && (memcmp(fast, ref, n) == 0), "%a as \"%.*s\", \"%s\" expected", x, n, fast, ref);
+		} else {
+			CHECK(!(fabs((double)x) * (tenths ? 10.0 : 1.0) < 1e9), "%a refused in range", x);
+		}
+		++nb_checked;
+	}
+}
+
+/* the floats on both sides of each half unit and half tenth, the exact ties round to even */
+static void test_ties(void) {
+	static const float exact[][3] = { /* x, "%.1f" rounding, "%.0f" rounding */
+		{0.25f, 0.2f, 0.0f}, {0.75f, 0.8f, 1.0f}, {-0.25f, -0.2f, -0.0f}, {-0.75f, -0.8f, -1.0f},
+		{0.5f, 0.5f, 0.0f}, {1.5f, 1.5f, 2.0f}, {2.5f, 2.5f, 2.0f}, {-2.5f, -2.5f, -2.0f}, {-3.5f, -3.5f, -4.0f}
+	};
+	char fast[FLOAT_TXT_MAX + 1], ref[64];
+	unsigned i;
+	int k, j, n;
+	float x;
+	
+	for (i = 0; i < ARRAY_SIZE(exact); ++i) {
+		n = put_fixed(fast, exact[i][0], true);
+		snprintf(ref, sizeof ref, "%.1f", exact[i][1]);
+		CHECK((n == (int)strlen(ref)) && (memcmp(fast, ref, n) == 0), "%g as \"%.*s\" with tenths, \"%s\" expected", exact[i][0], n, fast, ref);
+		n = put_fixed(fast, exact[i][0], false);
+		snprintf(ref, sizeof ref, "%.0f", exact[i][2]);
+		CHECK((n == (int)strlen(ref)) && (memcmp(fast, ref, n) == 0), "%g as \"%.*s\", \"%s\" expected", exact[i][0], n, fast, ref);
+		check(exact[i][0]);
+	}
+	for (k = -TIE_RANGE; k <= TIE_RANGE; ++k) {
+		float ties[2] = {(float)k + 0.5f, ((float)k + 0.5f) / 10.0f};
+		for (i = 0; i < 2; ++i) {
+			x = ties[i];
+			for (j = 0; j < TIE_ULPS; ++j) {
+				x = nextafterf(x, -INFINITY);
+			}
+			for (j = -TIE_ULPS; j <= TIE_ULPS; ++j) {
+				check(x);
+				x = nextafterf(x, INFINITY);
+			}
+		}
+	}
+}
+
+/* the minus sign is kept when the value rounds to zero, as printf does */
+static void test_zero(void) {
+	static const float zeros[] = {0.0f, -0.0f, 0.04f, -0.04f, 0.4f, -0.4f, -0.5f, -1e-30f, 1e-45f, -1e-45f};
+	char fast[FLOAT_TXT_MAX + 1];
+	unsigned i;
+	int n;
+	
+	for (i = 0; i < ARRAY_SIZE(zeros); ++i) {
+		check(zeros[i]);
+	}
+	n = put_fixed(fast, -0.0f, true);
+	CHECK((n == 4) && (memcmp(fast, "-0.0", 4) == 0), "-0.0 as \"%.*s\"", n, fast);
+	n = put_fixed(fast, -0.4f, false);
+	CHECK((n == 2) && (memcmp(fast, "-0", 2) == 0), "-0.4 as \"%.*s\"", n, fast);
+}
+
+/* values out of the fast path are refused and formatted by snprintf */
+static void test_range(void) {
+	static const float out[] = {1e9f, -1e9f, 1e8f, 3e38f, INFINITY, -INFINITY, NAN, -NAN};
+	char fast[FLOAT_TXT_MAX + 1];
+	unsigned i;
+	
+	for (i = 0; i < ARRAY_SIZE(out); ++i) {
+		check(out[i]);
+	}
+	CHECK(put_fixed(fast, NAN, true) == -1, "NaN accepted");
+	CHECK(put_fixed(fast, 1e8f, true) == -1, "1e8 accepted with tenths");
+	CHECK(put_fixed(fast, 1e8f, false) > 0, "1e8 refused");
+}
+
+/* the SNR and RSSI the concentrator reports, then any float */
+static void test_values(void) {
+	union { uint32_t u; float f; } v;
+	int i;
+	
+	for (i = -4000; i <= 4000; ++i) {
+		check((float)i / 4.0f);
+		check((float)i / 100.0f);
+	}
+	for (i = 0; i < RANDOM_FLOATS; ++i) {
+		v.u = rnd();
+		check(v.f);
+	}
+}
+
+/* every LoRa setting and FSK, the field extremes and the values the former code exited on */
+static void test_objects(void) {
+	static const uint8_t stat[] = {STAT_CRC_OK, STAT_CRC_BAD, STAT_NO_CRC, STAT_UNDEFINED, 0x42};
+	static const uint32_t datr[] = {DR_LORA_SF7, DR_LORA_SF8, DR_LORA_SF9, DR_LORA_SF10, DR_LORA_SF11, DR_LORA_SF12, DR_LORA_MULTI, 0};
+	static const uint8_t bw[] = {BW_125KHZ, BW_250KHZ, BW_500KHZ, BW_62K5HZ, BW_UNDEFINED};
+	static const uint8_t codr[] = {CR_LORA_4_5, CR_LORA_4_6, CR_LORA_4_7, CR_LORA_4_8, 0, 0x42};
+	static const uint32_t fsk_datr[] = {50000, 1200, 300000, 0, 4294967295u};
+	static const uint16_t size[] = {0, 1, 2, 3, 12, 51, 222, 255};
+	static const uint32_t freq[] = {868100000, 863000000, 869525000, 902300000, 923299999, 433175000, 1000000};
+	static const uint32_t tmst[] = {0, 1, 123456789, 4294967295u};
+	static const float rssi[] = {-120.0f, -57.0f, -35.5f, -0.4f, 0.0f, -139.75f};
+	static const float snr[] = {-20.0f, -7.25f, -0.25f, -0.0f, 0.0f, 9.5f, 13.75f};
+	const char *time_str = "2026-10-17T12:34:56.789012Z";
+	struct lgw_pkt_rx_s p;
+	unsigned a, b, c, d, i;
+	
+	memset(&p, 0, sizeof p);
+	for (i = 0; i < 255; ++i) {
+		p.payload[i] = (uint8_t)rnd();
+	}
+	
+	/* LoRa, every status, datarate, bandwidth and coding rate */
+	p.modulation = MOD_LORA;
+	for (a = 0; a < ARRAY_SIZE(stat); ++a) for (b = 0; b < ARRAY_SIZE(datr); ++b) for (c = 0; c < ARRAY_SIZE(bw); ++c) for (d = 0; d < ARRAY_SIZE(codr); ++d) {
+		i = a + b + c + d;
+		p.status = stat[a];
+		p.datarate = datr[b];
+		p.bandwidth = bw[c];
+		p.coderate = codr[d];
+		p.if_chain = i % 10;
+		p.rf_chain = i % 2;
+		p.freq_hz = freq[i % ARRAY_SIZE(freq)];
+		p.count_us = tmst[i % ARRAY_SIZE(tmst)];
+		p.rssi = rssi[i % ARRAY_SIZE(rssi)];
+		p.snr = snr[i % ARRAY_SIZE(snr)];
+		p.size = size[i % ARRAY_SIZE(size)];
+		check_object(&p, NULL);
+		check_object(&p, time_str);
+	}
+	
+	/* FSK */
+	p.modulation = MOD_FSK;
+	p.bandwidth = BW_UNDEFINED;
+	p.coderate = 0;
+	for (a = 0; a < ARRAY_SIZE(stat); ++a) for (b = 0; b < ARRAY_SIZE(fsk_datr); ++b) for (c = 0; c < ARRAY_SIZE(size); ++c) {
+		p.status = stat[a];
+		p.datarate = fsk_datr[b];
+		p.size = size[c];
+		p.rssi = rssi[c % ARRAY_SIZE(rssi)];
+		check_object(&p, (c & 1) ? time_str : NULL);
+	}
+	
+	/* no modulation */
+	p.modulation = MOD_UNDEFINED;
+	p.status = STAT_CRC_OK;
+	check_object(&p, NULL);
+}
+
+/* time the formatting of SNR and RSSI values */
+static void bench(void) {
+	float x[256];
+	char buf[64];
+	struct timespec t0, t1, t2, t3, t4;
+	unsigned sum = 0; /* keeps the calls from being optimized away */
+	int i;
+	
+	for (i = 0; i < 256; ++i) {
+		x[i] = (float)((int)(rnd() % 200) - 150) + (float)(rnd() % 4) / 4.0f;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < BENCH_LOOPS; ++i) {
+		sum += put_fixed(buf, x[i & 255], true) + buf[0];
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	for (i = 0; i < BENCH_LOOPS; ++i) {
+		sum += snprintf(buf, sizeof buf, "%.1f", x[i & 255]) + buf[0];
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	for (i = 0; i < BENCH_LOOPS; ++i) {
+		sum += put_fixed(buf, x[i & 255], false) + buf[0];
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t3);
+	for (i = 0; i < BENCH_LOOPS; ++i) {
+		sum += snprintf(buf, sizeof buf, "%.0f", x[i & 255]) + buf[0];
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t4);
+	
+	printf("float formatting, ns per call (put_fixed / snprintf):\n");
+	printf("  %%.1f %8.1f / %8.1f\n", elapsed_ns(&t0, &t1) / BENCH_LOOPS, elapsed_ns(&t1, &t2) / BENCH_LOOPS);
+	printf("  %%.0f %8.1f / %8.1f\n", elapsed_ns(&t2, &t3) / BENCH_LOOPS, elapsed_ns(&t3, &t4) / BENCH_LOOPS);
+	printf("  (checksum %u)\n", sum);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+	if ((argc > 1) && (strcmp(argv[1], "-b") == 0)) {
+		bench();
+		return EXIT_SUCCESS;
+	}
+	
+	test_objects();
+	test_ties();
+	test_zero();
+	test_range();
+	test_values();
+	
+	printf("test_rxpk: %s (%u failures in %u conversions)\n", (nb_fail == 0) ? "PASS" : "FAIL", nb_fail, nb_checked);
+	return (nb_fail == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
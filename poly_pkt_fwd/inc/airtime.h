@@ -0,0 +1,53 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+#ifndef _AIRTIME_H_
+#define _AIRTIME_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "loragw_hal.h"
+
+/*
+ * Time on air of the LoRa and FSK packets, from the modem parameters (Semtech
+ * AN1200.13 for LoRa), in microseconds rounded up. The nb of LoRa coding
+ * blocks of every SF 7 to 12 and size, and the symbol durations, are tabulated
+ * by airtime_init() so that a lookup costs no division, the other cases use
+ * the formula.
+ */
+
+/* Fill the lookup tables, before the threads start. */
+void airtime_init(void);
+
+/* LoRa packet: sf 6 to 12, bw_khz 125, 250 or 500, cr 1 (4/5) to 4 (4/8). */
+uint32_t airtime_lora(int sf, int bw_khz, int cr, unsigned preamble, unsigned size, bool crc, bool implicit);
+
+/* FSK packet with a 3-byte sync word and a length byte. */
+uint32_t airtime_fsk(uint32_t bps, unsigned preamble, unsigned size, bool crc);
+
+/* Packet to transmit, 0 if its modulation settings are invalid. */
+uint32_t airtime_tx(const struct lgw_pkt_tx_s *p);
+
+/* Packet received, with the default preamble, 0 if its modulation settings are invalid. */
+uint32_t airtime_rx(const struct lgw_pkt_rx_s *p);
+
+#endif /* _AIRTIME_H_ */
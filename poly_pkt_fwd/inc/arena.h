@@ -0,0 +1,62 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Bump-pointer arena backing the allocations of the JSON parser.
+ * Every allocation is carved at the end of a fixed buffer and freeing a block
+ * does nothing, the whole arena is emptied at once by arena_reset() once the
+ * parsed tree is no longer used (after each datagram or configuration file).
+ * The last block can grow in place, so the strings and arrays parson extends
+ * are not copied. When the buffer is full, the allocation falls back to malloc
+ * and is counted, such blocks are released by free as usual.
+ * The arena used by parson is selected per thread with arena_use(), a thread
+ * without arena keeps using malloc.
+ */
+
+struct arena {
+	uint8_t		*buf;
+	size_t		size;			/* size of buf in bytes */
+	size_t		used;			/* bytes allocated since the latest reset */
+	size_t		last;			/* offset of the latest block, the only one that can grow in place */
+	size_t		peak;			/* highest nb of bytes used between two resets */
+	unsigned	nb_fallback;	/* allocations that did not fit and were passed to malloc */
+};
+
+/* Allocate the buffer of the arena, return -1 if it could not be allocated. */
+int arena_init(struct arena *a, size_t size);
+void arena_free(struct arena *a);
+
+/* Drop all the blocks of the arena, the peak and fallback counters are kept. */
+void arena_reset(struct arena *a);
+
+/* Register the arena allocator with parson, to be called once before parsing anything. */
+void arena_install(void);
+
+/* Make parson allocate from a in the calling thread, NULL to go back to malloc. */
+void arena_use(struct arena *a);
+
+#endif /* _ARENA_H_ */
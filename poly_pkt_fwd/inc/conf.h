@@ -6,10 +6,41 @@
 #define DEFAULT_KEEPALIVE	5	/* default time interval for downstream keep-alive packet */
 #define DEFAULT_STAT		30	/* default time interval for statistics */
 #define PUSH_TIMEOUT_MS		100
+#define PUSH_RETX_MAX		2	/* default max nb of retransmissions of an unacknowledged PUSH_DATA */
+#define PUSH_RETX_RATE		2	/* default max nb of PUSH_DATA retransmissions per second and per server */
 #define PULL_TIMEOUT_MS		200
 #define GPS_REF_MAX_AGE		30	/* maximum admitted delay in seconds of GPS loss before considering latest GPS sync unusable */
-#define FETCH_SLEEP_MS		10	/* nb of ms waited when a fetch return no packets */
-#define BEACON_POLL_MS		50	/* time in ms between polling of beacon TX status */
+#define FETCH_SLEEP_MS		10	/* default max nb of ms waited when fetches return no packets */
+#define FETCH_SLEEP_MIN_MS	1	/* first wait after an empty fetch, doubled on each empty fetch up to the max */
+#ifndef NB_PKT_MAX
+#define NB_PKT_MAX			16	/* max number of packets per fetch, the concentrator FIFO depth, may be raised at build time */
+#endif
+#define RX_RING_SIZE		16	/* nb of fetched batches buffered between the fetch and the upstream thread, power of 2 */
+#define UP_WAIT_MS			100	/* max time in ms the upstream thread waits for a batch before checking for a status report */
+#define SHED_DEPTH_BAD		8	/* default queue depth, in batches, from which packets with a CRC error or no CRC are shed */
+#define SHED_DEPTH_DUP		10	/* same, for the packets looking like copies of a recent one */
+#define SHED_DEPTH_UNCONF	12	/* same, for the unconfirmed uplinks and the other frames, only a full queue drops the rest */
+#define SHED_RECENT			32	/* nb of recently fetched payloads compared to spot the copies */
+#define PUSH_MAX_SIZE		1472	/* default size limit of a PUSH_DATA datagram, fits a 1500-byte MTU */
+#define PUSH_MIN_SIZE		576		/* smallest size limit, a JSON rxpk of a 255-byte payload still fits */
+#define PMTU_CHECK_MS		1000	/* period in ms at which the path MTU of the servers is read again */
+#define DEDUP_WINDOW_MS		200	/* default time in ms during which the copies of an uplink are dropped */
+#define LINKQ_SIZE			1024	/* default nb of devices whose link quality is tracked */
+#define LINKQ_TOP			5	/* nb of devices with the highest loss displayed with the statistics */
+#define LINKQ_TOP_MIN_RX	8	/* frames received from a device before its loss is displayed */
+#define JIT_LEAD_MS			30	/* default time in ms before its start at which a downlink is loaded in the concentrator */
+#define JIT_MARGIN_US		1500	/* min time in us between two downlinks, to load the second one */
+#define JIT_IDLE_MS			100	/* max time in ms the downlink dispatcher sleeps when nothing is due */
+#define CNT_DRIFT_PPM		50	/* max drift between the host clock and the concentrator counter, the counter estimate is kept ahead by it */
+#define CNT_REF_MAX_S		60	/* age in s after which an uplink no longer dates the concentrator counter, the drift then reaches 3 ms */
+#define STAT_WAIT_MS		100	/* period in ms at which the main thread checks for a signal between reports */
+#define PUSH_DGRAM_OVERHEAD	50	/* bytes of header, rxpk envelope and IPv4/UDP headers saved per merged fetch */
+#define JOURNAL_SIZE		262144	/* default size in bytes of the upstream journal ring */
+#define JOURNAL_CATCHUP_RATE	20	/* default nb of journaled datagrams replayed per second to a server catching up */
+#define JOURNAL_SYNC_MS		1000	/* default max time in ms before journal writes are flushed to the storage */
+#define JOURNAL_OUTAGE_MS	3000	/* default time in ms without PUSH_ACK after which a server is considered unreachable */
+#define ARENA_DOWN_SIZE		16384	/* bytes of the arena each downstream thread parses its PULL_RESP in */
+#define ARENA_CONF_SIZE		131072	/* bytes of the arena the configuration files are parsed in, released once loaded */
 
 //TODO: This default values are a code-smell, remove.
 #define DEFAULT_SERVER		127.0.0.1 /* hostname also supported */
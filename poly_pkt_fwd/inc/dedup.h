@@ -0,0 +1,63 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+#ifndef _DEDUP_H_
+#define _DEDUP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Table of the recently forwarded uplinks, to drop the copies of a frame
+ * received several times: on overlapping IF chains, from the ghost source and
+ * over the air, or repeated within a short window. A frame is identified by a
+ * hash of its payload, and a copy matches when it arrives within the window
+ * of the first one, whatever its source, since the clocks of the sources may
+ * differ. Within a fetch, the copies are told apart with their concentrator
+ * timestamps. Open addressing with a bounded probe, the entries older than
+ * the window are free.
+ */
+
+#define DEDUP_TABLE_SIZE	256		/* nb of entries, power of 2 */
+#define DEDUP_PROBE_MAX		16		/* nb of entries probed per lookup */
+
+struct dedup_entry {
+	uint32_t			hash;			/* 0 if never used */
+	uint32_t			time_ms;		/* arrival time of the first copy */
+};
+
+struct dedup {
+	uint32_t			window_ms;
+	struct dedup_entry	e[DEDUP_TABLE_SIZE];
+};
+
+void dedup_init(struct dedup *table, uint32_t window_ms);
+
+/* Hash of a frame, never 0. */
+uint32_t dedup_hash(const uint8_t *payload, uint16_t size);
+
+/* Returns true if the frame was already seen within the window, records it otherwise. */
+bool dedup_check(struct dedup *table, uint32_t hash, uint32_t now_ms);
+
+/* True if two copies of a fetch with these concentrator timestamps may be the same frame. */
+bool dedup_close(const struct dedup *table, uint32_t count_a, uint32_t count_b);
+
+#endif /* _DEDUP_H_ */
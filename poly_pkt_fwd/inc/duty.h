@@ -0,0 +1,95 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+#ifndef _DUTY_H_
+#define _DUTY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Airtime of the downlinks per regulated sub-band, over a sliding window. The
+ * window is a ring of buckets shared by the sub-bands, each holding the
+ * airtime charged during its period: the oldest bucket is emptied as time
+ * goes on, so that a check costs the same whatever the traffic. A sub-band
+ * may also limit the airtime of a single packet (dwell time), and keep part
+ * of its budget for the beacon: the reserve shrinks as the beacons of the
+ * window are charged, so they are not counted twice. The first sub-band holding a frequency
+ * applies, frequencies outside the sub-bands are not limited.
+ */
+
+#define DUTY_NB_BUCKET		60
+#define DUTY_BAND_MAX		8
+#define DUTY_WINDOW_S		3600	/* default window, the one of the ETSI duty-cycle limits */
+
+enum duty_verdict {
+	DUTY_OK,
+	DUTY_DWELL,							/* the packet lasts longer than the dwell time */
+	DUTY_BUDGET,						/* the sub-band has not enough airtime left */
+	DUTY_NB_VERDICT
+};
+
+struct duty_band {
+	uint32_t			freq_min;		/* in Hz, included */
+	uint32_t			freq_max;		/* in Hz, excluded */
+	uint64_t			budget_us;		/* airtime allowed over the window, 0 = no limit */
+	uint32_t			dwell_us;		/* max airtime of a packet, 0 = no limit */
+	uint64_t			reserve_us;		/* part of the budget kept for the beacon */
+	uint64_t			used_us;		/* sum of the buckets */
+	uint64_t			beacon_us;		/* part of used_us charged by the beacon */
+	uint32_t			bucket[DUTY_NB_BUCKET];
+	uint32_t			beacon_bucket[DUTY_NB_BUCKET];	/* part of each bucket charged by the beacon */
+};
+
+struct duty_cycle {
+	uint32_t			window_s;
+	uint32_t			bucket_s;		/* period of a bucket */
+	uint32_t			epoch;			/* nb of bucket periods elapsed at the current bucket */
+	int					nb_band;
+	struct duty_band	band[DUTY_BAND_MAX];
+};
+
+/* Accountant without sub-band over a window of window_s (at least DUTY_NB_BUCKET) seconds, NULL if out of memory. */
+struct duty_cycle *duty_create(uint32_t window_s);
+
+void duty_free(struct duty_cycle *d);
+
+/* Add a sub-band, percent of the window (0 = no limit) and dwell_ms (0 = no limit), returns -1 if the table is full or the band invalid. */
+int duty_add_band(struct duty_cycle *d, uint32_t freq_min, uint32_t freq_max, float percent, uint32_t dwell_ms);
+
+/* Add the sub-bands of a region ("EU868", "AS923"), returns -1 if the region is unknown or the table full. */
+int duty_add_region(struct duty_cycle *d, const char *region);
+
+/* Keep reserve_us of the budget of the sub-band of freq_hz for the beacon. */
+void duty_reserve(struct duty_cycle *d, uint32_t freq_hz, uint32_t reserve_us);
+
+/* Charge a packet to its sub-band if it fits, the beacon may use the reserve, now_s is a monotonic time in seconds. */
+enum duty_verdict duty_take(struct duty_cycle *d, uint32_t freq_hz, uint32_t toa_us, bool beacon, uint32_t now_s);
+
+/* Give back the airtime of a packet charged but not sent after all, from the latest buckets of the window. */
+void duty_release(struct duty_cycle *d, uint32_t freq_hz, uint32_t toa_us, bool beacon, uint32_t now_s);
+
+/* Airtime left to the other packets in a sub-band, UINT64_MAX if it has no limit. */
+uint64_t duty_remaining(struct duty_cycle *d, int band, uint32_t now_s);
+
+const char *duty_verdict_name(enum duty_verdict v);
+
+#endif /* _DUTY_H_ */
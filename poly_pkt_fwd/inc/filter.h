@@ -0,0 +1,84 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+#ifndef _FILTER_H_
+#define _FILTER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lorawan.h"
+#include "parson.h"
+
+/*
+ * LoRaWAN rules matching the uplinks, used for the network filter file and
+ * for the routes of the servers. They are described by a JSON object:
+ *  "netid": NetIDs whose DevAddr block is accepted, eg. ["000013"]
+ *  "devaddr_prefix": other accepted DevAddr blocks, eg. ["26011000/20"]
+ *  "devaddr": accepted DevAddr, eg. ["26011BDA"]
+ *  "join_eui": accepted JoinEUIs or ranges, eg. ["70B3D57ED0000000-70B3D57ED00000FF"]
+ *  "frame_types": accepted frames among "join", "rejoin", "confirmed",
+ *      "unconfirmed", "data" (both), "proprietary" and "other", by default all
+ *      but "proprietary" and "other"
+ *  "forward_other": also accept "proprietary" and "other"
+ * "other" covers the join-accepts, the downlinks and the invalid frames.
+ * A data uplink matches if its DevAddr is in a block or in the list, or if
+ * there is neither. A join-request matches if its JoinEUI is in a range, or if
+ * there is none. The lists are sorted for a binary search.
+ */
+
+#define FILTER_PREFIX_MAX	16
+#define FILTER_INVALID		8	/* bit of the frames that are not LoRaWAN in the type mask, after the MTypes */
+
+enum filter_verdict {
+	FILTER_PASS = 0,
+	FILTER_DROP_DATA,
+	FILTER_DROP_JOIN,
+	FILTER_DROP_OTHER
+};
+
+struct eui_range {
+	uint64_t			min;
+	uint64_t			max;
+};
+
+struct lw_filter {
+	uint16_t			types;					/* accepted MTypes, and FILTER_INVALID */
+	int					nb_prefix;
+	uint32_t			prefix[FILTER_PREFIX_MAX];
+	uint32_t			mask[FILTER_PREFIX_MAX];
+	int					nb_devaddr;
+	uint32_t			*devaddr;
+	int					nb_join_eui;
+	struct eui_range	*join_eui;				/* sorted, without overlap */
+};
+
+/* Build rules from a JSON object, name identifies it in the log, returns NULL if it is invalid. */
+struct lw_filter *filter_parse(const JSON_Object *obj, const char *name);
+
+/* Load a filter file, returns NULL if it is invalid. */
+struct lw_filter *filter_load(const char *path);
+void filter_free(struct lw_filter *f);
+
+/* Verdict for a frame, f is NULL for a frame that is not LoRaWAN. */
+enum filter_verdict filter_check(const struct lw_filter *filter, const struct lw_frame *f);
+
+#endif /* _FILTER_H_ */
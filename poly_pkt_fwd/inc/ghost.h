@@ -18,13 +18,12 @@
 
 
 /* Note that the ghost receive buffer must be large enough to store the
- * burst of data coming in just after the wait period in the main cycle
- * has commenced. In reality this wait state is one of the limiting factors
- * of the capacity. I am unaware of the number of packates the concentrator
- * can store, but my suspicion is 8. In this code the wait state is 10ms,
- * so this limits the maximum throughput in reality on: 8/0.01 = 800 packets/sec.
- * Although in burst mode it may be higher, since the wait time is not the
- * limiting factor at that moment.
+ * burst of data coming in between two fetches. The fetch thread re-fetches
+ * immediately as long as fetches come back full, and only backs off (from
+ * FETCH_SLEEP_MIN_MS doubling up to fetch_sleep_max_ms, FETCH_SLEEP_MS by
+ * default) when fetches come back empty. So the wait is no longer a limit on
+ * the throughput during a burst, it only delays the first packets of a burst
+ * after an idle period by up to fetch_sleep_max_ms.
  */
 
 /* The total number of buffer bytes equals: (GHST_RX_BUFFSIZE + GHST_TX_BUFFSIZE) * GHST_NM_RCV */
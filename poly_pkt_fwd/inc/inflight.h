@@ -0,0 +1,102 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+#ifndef _INFLIGHT_H_
+#define _INFLIGHT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+
+/*
+ * Per server table of the PUSH_DATA datagrams waiting for their PUSH_ACK.
+ * Tokens are allocated sequentially, so the slot of a datagram is given by the
+ * low bits of its token and no search is needed. A slot is recycled when the
+ * token counter wraps around the table, the previous datagram is then
+ * considered lost.
+ * The ACK round-trips feed a smoothed RTT estimator (SRTT/RTTVAR, as for TCP)
+ * giving the retransmission time-out. The last datagrams are kept so that an
+ * unacknowledged one can be sent again, with the same token, up to retx_max
+ * times with a doubled time-out each time, and within a per server budget of
+ * retransmissions per second. A retransmitted datagram gives no RTT sample,
+ * since its ACK cannot be matched to one of the transmissions.
+ */
+
+#define PUSH_INFLIGHT_MAX	64		/* max nb of PUSH_DATA waiting for an ACK per server, power of 2 */
+#define PUSH_RETX_COPIES	16		/* nb of the last datagrams kept for retransmission, power of 2 */
+#define PUSH_RETX_SIZE		2048	/* larger datagrams are not retransmitted */
+#define PUSH_RTO_INIT_MS	1000	/* time-out before the first RTT sample */
+#define PUSH_RTO_MAX_MS		8000
+
+struct inflight_entry {
+	bool				used;
+	uint16_t			token;
+	uint8_t				retx;					/* nb of retransmissions */
+	bool				expired;				/* given up, only a late ACK is expected */
+	struct timespec		send_time;				/* CLOCK_MONOTONIC time of the last send() */
+	struct timespec		deadline;				/* retransmission time */
+};
+
+struct inflight_copy {
+	uint16_t			token;
+	uint16_t			len;
+	uint8_t				buf[PUSH_RETX_SIZE];
+};
+
+struct inflight {
+	pthread_mutex_t			m;
+	struct inflight_entry	e[PUSH_INFLIGHT_MAX];
+	struct inflight_copy	copy[PUSH_RETX_COPIES];
+	/* RTT estimator, in ms */
+	bool					rtt_valid;
+	float					srtt;
+	float					rttvar;
+	int						rto_min;
+	int						rto;
+	/* retransmission policy */
+	int						retx_max;
+	float					retx_rate;			/* budget refill, in retransmissions per second */
+	float					retx_credit;
+	struct timespec			credit_time;
+};
+
+void inflight_init(struct inflight *table, int rto_min_ms, int retx_max, float retx_rate);
+
+/* Record a datagram just sent, returns true if an unacknowledged datagram had to be evicted. */
+bool inflight_add(struct inflight *table, uint16_t token, struct timespec send_time, const void *buf, int len);
+
+/* Match an ACK, returns true if the token was pending, with the round-trip
+ * time in ms, or -1 if the datagram was retransmitted. */
+bool inflight_ack(struct inflight *table, uint16_t token, struct timespec recv_time, int *rtt_ms);
+
+/* Copy in buf the next datagram to retransmit at time now and return its
+ * length, or 0 if none. The datagrams overdue and out of retries are counted
+ * in *expired. */
+int inflight_retx(struct inflight *table, struct timespec now, uint8_t *buf, int *expired);
+
+/* Time in ms until the next retransmission deadline, at most max_ms. */
+int inflight_wait_ms(struct inflight *table, struct timespec now, int max_ms);
+
+/* Current smoothed RTT and time-out, in ms, srtt is -1 without RTT sample. */
+void inflight_rtt(struct inflight *table, int *srtt_ms, int *rto_ms);
+
+#endif /* _INFLIGHT_H_ */
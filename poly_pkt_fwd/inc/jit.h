@@ -0,0 +1,100 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+#ifndef _JIT_H_
+#define _JIT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "loragw_hal.h"
+
+/*
+ * Just-in-time queue of the downlinks, shared by the downstream threads of
+ * all the servers and emptied by a single dispatcher, since the concentrator
+ * only holds one pending packet. Each packet occupies the concentrator from
+ * its start, in concentrator counter microseconds, until the end of its time
+ * on air, plus a margin to load the next one. A packet overlapping others is
+ * refused unless it has a higher priority, in which case it replaces them.
+ * The slots, sorted by start time, only carry the index of their packet so
+ * that an insertion moves a few bytes per slot.
+ */
+
+#define JIT_QUEUE_SIZE		32		/* max nb of queued downlinks */
+#define JIT_AHEAD_MAX_US	60000000	/* packets starting later are refused, 32-bit counter times compare up to 35 minutes apart */
+
+/* by decreasing priority */
+enum jit_class {
+	JIT_BEACON = 0,
+	JIT_CLASS_A,
+	JIT_CLASS_C,						/* class C, and any packet sent immediately */
+	JIT_NB_CLASS
+};
+
+enum jit_error {
+	JIT_OK = 0,
+	JIT_TOO_LATE,						/* starts too soon to be loaded */
+	JIT_TOO_EARLY,						/* starts after JIT_AHEAD_MAX_US */
+	JIT_COLLISION_BEACON,				/* overlaps a beacon */
+	JIT_COLLISION,						/* overlaps a packet of the same or a higher priority */
+	JIT_FULL,
+	JIT_NB_ERROR
+};
+
+struct jit_slot {
+	uint32_t			start_us;
+	uint32_t			end_us;			/* end of the time on air */
+	uint8_t				cls;
+	uint8_t				pkt;			/* index in pkt[] */
+};
+
+struct jit_queue {
+	uint32_t			margin_us;		/* min time between the end of a packet and the start of the next one */
+	unsigned			nb;
+	struct jit_slot		slot[JIT_QUEUE_SIZE];
+	unsigned			nb_free;
+	uint8_t				free[JIT_QUEUE_SIZE];	/* unused entries of pkt[] */
+	bool				loaded;			/* a packet was handed to the concentrator */
+	struct jit_slot		last;			/* that packet */
+	struct lgw_pkt_tx_s	pkt[JIT_QUEUE_SIZE];
+};
+
+void jit_init(struct jit_queue *q, uint32_t margin_us);
+
+/* Queue a packet of toa_us on air starting at start_us, now_us being the
+ * current counter value. The queued packets of lower priority it overlaps are
+ * dropped, copied to evicted[] (JIT_QUEUE_SIZE packets) and counted in
+ * *preempted, so that their airtime can be given back. */
+enum jit_error jit_enqueue(struct jit_queue *q, const struct lgw_pkt_tx_s *pkt, enum jit_class cls, uint32_t start_us, uint32_t toa_us, uint32_t now_us, struct lgw_pkt_tx_s *evicted, unsigned *preempted);
+
+/* Earliest start, from from_us on, of a packet of toa_us fitting between the queued ones. */
+uint32_t jit_gap(const struct jit_queue *q, uint32_t from_us, uint32_t toa_us);
+
+/* Time until the first packet must be loaded, lead_us before its start, negative if overdue, INT32_MAX if the queue is empty. */
+int32_t jit_due(const struct jit_queue *q, uint32_t now_us, uint32_t lead_us);
+
+/* Remove the first packet, recorded as the one loaded in the concentrator. */
+void jit_dequeue(struct jit_queue *q, struct lgw_pkt_tx_s *pkt, struct jit_slot *slot);
+
+/* Description of an error. */
+const char *jit_error_name(enum jit_error err);
+
+#endif /* _JIT_H_ */
@@ -0,0 +1,95 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+
+#include "conf.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Store-and-forward journal of the upstream datagrams, kept in a memory
+ * mapped file so that it survives a restart of the forwarder. The file holds a
+ * header page followed by a ring of records, each one a complete datagram in
+ * one encoding. Positions are logical byte offsets that only grow, the oldest
+ * records are overwritten when the ring is full. Every server has its own read
+ * cursor, records are tagged with the servers they are meant for, the others
+ * skip them. The header keeps a hash of the address of each server, so that a
+ * cursor recovered for a server that changed is moved after the last record.
+ * Writes go to the page cache, journal_sync() flushes them to the storage and
+ * is meant to be called at a bounded rate since flash may be slow.
+ * The journal is only used by the upstream thread, it has no locking.
+ */
+
+#define JOURNAL_MAGIC		0x4A524E33	/* "JRN3" */
+#define JOURNAL_MIN_SIZE	16384		/* smallest ring accepted, in bytes */
+
+struct journal_hdr {
+	uint32_t			magic;
+	uint32_t			size;					/* size of the ring, in bytes */
+	uint64_t			head;					/* position of the next record to write */
+	uint64_t			tail;					/* position of the oldest record */
+	uint64_t			cursor[MAX_SERVERS];	/* position of the next record to read, per server */
+	uint32_t			server[MAX_SERVERS];	/* journal_server_id() of the server of each cursor */
+};
+
+struct journal {
+	int					fd;
+	struct journal_hdr	*hdr;
+	uint8_t				*ring;
+	size_t				map_len;
+	int					nb_reader;				/* nb of cursors in use */
+	uint8_t				moved;					/* cursors moved at recovery because their server changed, bit ic for server ic */
+	bool				dirty;					/* written since the last sync */
+};
+
+/* Identifier of a server, a hash of its address and upstream port. */
+uint32_t journal_server_id(const char *addr, const char *port);
+
+/* Map the journal file for the nb_reader servers identified by server_id[],
+ * returns 1 if its records were recovered, 0 if it was created or reset because
+ * its layout did not match, -1 on error. */
+int journal_open(struct journal *j, const char *path, uint32_t size, int nb_reader, const uint32_t *server_id);
+void journal_close(struct journal *j);
+
+/* Append a datagram for the servers of the readers mask (bit ic for server ic),
+ * returns its position, and in *lost the nb of records overwritten before being
+ * read by one of their servers, or -1 if it cannot fit. */
+int64_t journal_append(struct journal *j, uint8_t readers, const uint8_t *buf, uint16_t len, unsigned *lost);
+
+/* Next record for server ic, NULL when the server is caught up. The cursor is
+ * left on the record until journal_next(). */
+uint8_t *journal_peek(struct journal *j, int ic, uint16_t *len);
+void journal_next(struct journal *j, int ic);
+
+/* Position of the cursor of server ic, and rewind to an earlier position still in the ring. */
+uint64_t journal_pos(const struct journal *j, int ic);
+void journal_rewind(struct journal *j, int ic, uint64_t pos);
+
+/* Set the cursor of server ic after the last record. */
+void journal_skip(struct journal *j, int ic);
+
+/* Flush the records and cursors written since the last call to the storage. */
+void journal_sync(struct journal *j);
+
+#endif /* _JOURNAL_H_ */
@@ -0,0 +1,86 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+#ifndef _LINKQ_H_
+#define _LINKQ_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Link quality of the devices heard by the gateway, per DevAddr: frames
+ * received, frames lost according to the gaps of the frame counter, and
+ * moving averages of the RSSI and SNR per spreading factor. The table holds
+ * a bounded nb of devices, the least recently heard one is evicted to make
+ * room. Open addressing with linear probing over twice as many slots as
+ * devices, the totals are kept up to date on each frame.
+ */
+
+#define LINKQ_SF_MIN		7
+#define LINKQ_NB_SF			6		/* SF7 to SF12 */
+#define LINKQ_GAP_MAX		16384	/* larger FCnt jumps are a reset of the device, not losses */
+#define LINKQ_EWMA_ALPHA	0.125f	/* weight of a new RSSI/SNR sample */
+#define LINKQ_NONE			0xFFFFFFFFu
+
+struct linkq_sf {
+	uint32_t			nb;				/* frames received at this SF */
+	float				rssi;			/* moving averages */
+	float				snr;
+};
+
+struct linkq_dev {
+	uint32_t			devaddr;
+	uint16_t			fcnt;			/* last frame counter */
+	uint32_t			nb_rx;			/* distinct frames received */
+	uint32_t			nb_repeat;		/* frames received again with the same FCnt */
+	uint32_t			nb_lost;		/* frames missing in the FCnt sequence */
+	uint32_t			prev, next;		/* least recently used list, most recent first */
+	struct linkq_sf		sf[LINKQ_NB_SF];
+};
+
+struct linkq {
+	uint32_t			capacity;		/* max nb of devices */
+	uint32_t			nb_dev;
+	uint32_t			mask;			/* nb of slots - 1 */
+	uint32_t			*slot;			/* index of the device of each slot, LINKQ_NONE if empty */
+	struct linkq_dev	*dev;
+	uint32_t			head, tail;		/* most and least recently heard devices */
+	/* totals over the devices in the table */
+	uint32_t			nb_rx;
+	uint32_t			nb_lost;
+	uint32_t			nb_evicted;		/* since the start */
+};
+
+/* Allocate a table of capacity devices, returns -1 if out of memory. */
+int linkq_init(struct linkq *t, uint32_t capacity);
+
+void linkq_free(struct linkq *t);
+
+/* Account for an uplink, sf is 0 for a FSK frame. */
+void linkq_update(struct linkq *t, uint32_t devaddr, uint16_t fcnt, int sf, float rssi, float snr);
+
+/* Estimated loss ratio of a device, between 0 and 1. */
+float linkq_loss(const struct linkq_dev *d);
+
+/* Copy up to n devices having lost frames with the highest loss ratio and at least min_rx frames, worst first, returns their nb. */
+int linkq_worst(const struct linkq *t, struct linkq_dev *worst, int n, uint32_t min_rx);
+
+#endif /* _LINKQ_H_ */
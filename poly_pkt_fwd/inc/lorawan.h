@@ -0,0 +1,76 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+#ifndef _LORAWAN_H_
+#define _LORAWAN_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Decoding of the clear part of the LoRaWAN frame headers (MHDR, FHDR, and
+ * the EUIs of the join-request), without any key. Multi-byte fields are
+ * little endian on the air.
+ */
+
+#define LW_JOIN_REQUEST		0
+#define LW_JOIN_ACCEPT		1
+#define LW_UNCONF_UP		2
+#define LW_UNCONF_DOWN		3
+#define LW_CONF_UP			4
+#define LW_CONF_DOWN		5
+#define LW_REJOIN_REQUEST	6
+#define LW_PROPRIETARY		7
+
+#define LW_MIC_SIZE			4
+
+struct lw_frame {
+	uint8_t				mtype;
+	uint8_t				major;
+	/* data frames */
+	uint32_t			devaddr;
+	uint8_t				fctrl;
+	uint16_t			fcnt;				/* 16 LSB of the frame counter */
+	int					fport;				/* -1 if absent */
+	/* join-request */
+	uint64_t			join_eui;
+	uint64_t			dev_eui;
+	uint16_t			dev_nonce;
+};
+
+/* Decode the headers, returns 0 or -1 if the frame is too short or not LoRaWAN R1. */
+int lw_parse(const uint8_t *payload, uint16_t size, struct lw_frame *f);
+
+/* True for the frames carrying a DevAddr. */
+bool lw_is_data(const struct lw_frame *f);
+
+/* DevAddr prefix and nb of prefix bits allocated to a NetID, returns -1 for an invalid NetID. */
+int lw_netid_prefix(uint32_t netid, uint32_t *prefix, int *bits);
+
+/* Name of the message type. */
+const char *lw_mtype_name(uint8_t mtype);
+
+/* Write the decoded header fields as JSON members, each preceded by a comma,
+ * returns the nb of bytes written (at most LW_JSON_MAX) or -1 if buf is too small. */
+#define LW_JSON_MAX			96
+int lw_json_fields(const struct lw_frame *f, char *buf, int size);
+
+#endif /* _LORAWAN_H_ */
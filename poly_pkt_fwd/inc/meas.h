@@ -0,0 +1,139 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+#ifndef _MEAS_H_
+#define _MEAS_H_
+
+#include "conf.h"
+#include <stdint.h>
+
+/*
+ * Statistics counters, one cache line aligned block per writer thread so that
+ * no lock is taken and no cache line is shared on the hot path. A block is
+ * only written by its owner thread, which wraps each group of updates between
+ * meas_begin() and meas_end(). The main thread sums all blocks with
+ * meas_snapshot(), reading again a block updated meanwhile, and gets the
+ * values of an interval as the difference of two snapshots: counters are
+ * never reset and may wrap around.
+ */
+
+#define MEAS_RTT_BINS		14		/* RTT histogram bin i counts the RTT below 2^i ms, the last one the others */
+#define MEAS_DEPTH_BINS		(RX_RING_SIZE + 1)	/* queue depth histogram bin i counts the fetches finding i batches queued */
+#define MEAS_SLACK_BINS		14		/* slack histogram bin i counts the downlinks received less than 2^i ms before their start */
+#define MEAS_IF_CHAIN_NB	10		/* IF chains of the concentrator, LGW_IF_CHAIN_NB of the HAL */
+
+enum meas_id {
+	/* upstream */
+	MEAS_NB_RX_RCV,			/* count packets received */
+	MEAS_NB_RX_OK,			/* count packets received with PAYLOAD CRC OK */
+	MEAS_NB_RX_BAD,			/* count packets received with PAYLOAD CRC ERROR */
+	MEAS_NB_RX_NOCRC,		/* count packets received with NO PAYLOAD CRC */
+	MEAS_NB_RX_DROP,		/* count packets fetched but dropped because the upstream thread lagged behind */
+	MEAS_NB_RX_SHED_BAD,	/* count packets with a CRC error or no CRC shed as the upstream queue filled up */
+	MEAS_NB_RX_SHED_DUP,	/* count packets looking like copies shed as the upstream queue filled up */
+	MEAS_NB_RX_SHED_UNCONF,	/* count unconfirmed uplinks and other frames shed as the upstream queue filled up */
+	MEAS_NB_RX_DUP,			/* count packets dropped as copies of a frame already forwarded */
+	MEAS_NB_RX_FLT_DATA,	/* count data frames dropped by the network filter */
+	MEAS_NB_RX_FLT_JOIN,	/* count join-requests dropped by the network filter */
+	MEAS_NB_RX_FLT_OTHER,	/* count other frames dropped by the network filter */
+	MEAS_NB_RX_UNROUTED,	/* count packets dropped because no server route matches them */
+	MEAS_UP_PKT_FWD,		/* number of radio packet forwarded to the server */
+	MEAS_UP_NETWORK_BYTE,	/* sum of UDP bytes sent for upstream traffic */
+	MEAS_UP_PAYLOAD_BYTE,	/* sum of radio payload bytes sent for upstream traffic */
+	MEAS_UP_DGRAM_SENT,		/* number of datagrams sent for upstream traffic */
+	MEAS_UP_ACK_RCV,		/* number of datagrams acknowledged for upstream traffic */
+	MEAS_UP_ACK_LOST,		/* number of datagrams evicted from the in-flight table without ACK */
+	MEAS_UP_DGRAM_SAVED,	/* number of datagrams not sent thanks to the aggregation of fetches */
+	MEAS_UP_BYTE_SAVED,		/* sum of UDP bytes not sent thanks to the aggregation of fetches */
+	MEAS_UP_JOURNAL_REPLAY,	/* number of datagrams sent from the journal after a server outage */
+	MEAS_UP_JOURNAL_LOST,	/* number of journaled datagrams overwritten before being sent to every server */
+	MEAS_UP_RETX,			/* number of datagrams retransmitted for lack of ACK */
+	MEAS_UP_RETX_BYTE,		/* sum of UDP bytes retransmitted, not in MEAS_UP_NETWORK_BYTE */
+	MEAS_UP_RETX_EXPIRED,	/* number of datagrams still unacknowledged after their last retransmission */
+	MEAS_UP_RTT,			/* histogram of the ACK round-trip times, MEAS_RTT_BINS counters */
+	MEAS_UP_RTT_END = MEAS_UP_RTT + MEAS_RTT_BINS - 1,
+	MEAS_FETCH_NB,			/* number of fetches from the concentrator */
+	MEAS_FETCH_FULL,		/* number of fetches that returned a full batch */
+	MEAS_FETCH_EMPTY,		/* number of fetches that returned no packets */
+	MEAS_FETCH_BUSY_US,		/* time spent by the fetch thread fetching and queuing */
+	MEAS_FETCH_IDLE_US,		/* time spent by the fetch thread waiting between fetches */
+	MEAS_FETCH_DEPTH,		/* histogram of the upstream queue depth seen by the fetches, MEAS_DEPTH_BINS counters */
+	MEAS_FETCH_DEPTH_END = MEAS_FETCH_DEPTH + MEAS_DEPTH_BINS - 1,
+	MEAS_RX_BUSY_US,		/* time on air of the packets received, in us, MEAS_IF_CHAIN_NB counters (one per IF chain) */
+	MEAS_RX_BUSY_US_END = MEAS_RX_BUSY_US + MEAS_IF_CHAIN_NB - 1,
+	/* downstream */
+	MEAS_DW_PULL_SENT,		/* number of PULL requests sent for downstream traffic */
+	MEAS_DW_ACK_RCV,		/* number of PULL requests acknowledged for downstream traffic */
+	MEAS_DW_DGRAM_RCV,		/* count PULL response packets received for downstream traffic */
+	MEAS_DW_NETWORK_BYTE,	/* sum of UDP bytes received for downstream traffic */
+	MEAS_DW_PAYLOAD_BYTE,	/* sum of radio payload bytes sent for downstream traffic */
+	MEAS_DW_JIT_QUEUED,		/* count packets accepted in the JIT queue */
+	MEAS_DW_JIT_LATE,		/* count packets refused by the JIT queue, one counter per jit_error from JIT_TOO_LATE on */
+	MEAS_DW_JIT_EARLY,
+	MEAS_DW_JIT_COLL_BEACON,
+	MEAS_DW_JIT_COLL,
+	MEAS_DW_JIT_FULL,
+	MEAS_DW_JIT_PREEMPTED,	/* count queued packets replaced by an overlapping packet of higher priority */
+	MEAS_DW_SLACK,			/* histogram of the time left before the start of the timestamped downlinks when received, MEAS_SLACK_BINS counters */
+	MEAS_DW_SLACK_END = MEAS_DW_SLACK + MEAS_SLACK_BINS - 1,
+	MEAS_DW_DUTY_DWELL,		/* count packets refused for their sub-band, one counter per duty_verdict from DUTY_DWELL on */
+	MEAS_DW_DUTY_BUDGET,
+	MEAS_NB_TX_OK,			/* count packets emitted successfully */
+	MEAS_NB_TX_FAIL,		/* count packets were TX failed for other reasons */
+	MEAS_NB_TX_LATE,		/* count queued packets dropped because they could no longer be loaded before their start */
+	MEAS_TX_BUSY_US,		/* time on air of the packets emitted, in us */
+	MEAS_NB
+};
+
+/* writer threads, one block each */
+#define MEAS_FETCH			0
+#define MEAS_UP				1
+#define MEAS_ACK(ic)		(2 + (ic))
+#define MEAS_DOWN(ic)		(2 + MAX_SERVERS + (ic))
+#define MEAS_JIT			(2 + 2 * MAX_SERVERS)
+#define MEAS_BLOCK_NB		(3 + 2 * MAX_SERVERS)
+
+struct meas_block {
+	unsigned			seq;			/* odd while the owner is updating the block */
+	uint32_t			val[MEAS_NB];
+} __attribute__((aligned(64)));
+
+struct meas_snap {
+	uint32_t			val[MEAS_NB];
+};
+
+extern struct meas_block meas_blocks[MEAS_BLOCK_NB];
+
+/* Writer side, only called by the owner thread of the block. */
+void meas_begin(struct meas_block *b);
+void meas_add(struct meas_block *b, enum meas_id id, uint32_t n);
+void meas_end(struct meas_block *b);
+
+/* Reader side: sum of all blocks, and difference between two sums. */
+void meas_snapshot(struct meas_snap *snap);
+void meas_delta(const struct meas_snap *now, const struct meas_snap *prev, struct meas_snap *delta);
+
+/* Histogram with power of 2 bounds: bin of a value, and bin holding the given
+ * percentile, or -1 for an empty histogram. */
+int meas_hist_bin(uint32_t v, int nb_bin);
+int meas_hist_pct(const uint32_t *hist, int nb_bin, unsigned pct);
+
+#endif /* _MEAS_H_ */
@@ -48,6 +48,13 @@ typedef enum json_value_type {
     JSONBoolean = 6
 } JSON_Value_Type;
 
+typedef void * (*JSON_Malloc_Function)(size_t);
+typedef void   (*JSON_Free_Function)(void *);
+typedef void * (*JSON_Realloc_Function)(void *, size_t);
+
+/* Call only once, before calling any other function from parson API. If not called, malloc,
+   free and realloc from stdlib will be used for all allocations */
+void json_set_allocation_functions(JSON_Malloc_Function malloc_fun, JSON_Free_Function free_fun, JSON_Realloc_Function realloc_fun);
    
 /* Parses first JSON value in a file, returns NULL in case of error */
 JSON_Value  * json_parse_file(const char *filename);
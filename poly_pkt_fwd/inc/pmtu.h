@@ -0,0 +1,41 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+#ifndef _PMTU_H_
+#define _PMTU_H_
+
+/*
+ * Path MTU of the connected UDP sockets. The kernel is asked to set the DF bit
+ * and to learn the path MTU from the ICMP "fragmentation needed" messages, the
+ * largest payload that then avoids IP fragmentation is read back. Where the
+ * system does not expose the path MTU, it is unknown and -1 is returned.
+ */
+
+#define PMTU_UDP4_OVERHEAD	28	/* IPv4 and UDP headers */
+#define PMTU_UDP6_OVERHEAD	48	/* IPv6 and UDP headers */
+
+/* Enable the path MTU discovery on a connected socket, returns 0 or -1 if unsupported. */
+int pmtu_enable(int sock);
+
+/* Largest UDP payload sent without fragmentation on a connected socket, -1 if unknown. */
+int pmtu_payload(int sock);
+
+#endif /* _PMTU_H_ */
@@ -0,0 +1,65 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+#ifndef _RING_H_
+#define _RING_H_
+
+#include "conf.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <semaphore.h>
+
+#include "loragw_hal.h"
+
+/*
+ * Single producer / single consumer ring of fetched packet batches.
+ * The fetch thread is the only producer, the upstream thread the only consumer,
+ * so the indexes can be exchanged without any lock. The semaphore is only used
+ * to wake up the consumer, the producer never blocks on it.
+ */
+
+struct rx_batch {
+	struct timespec		fetch_time;		/* system time at which the batch was fetched */
+	int					nb_pkt;			/* nb of valid packets in pkt[] */
+	struct lgw_pkt_rx_s	pkt[NB_PKT_MAX];
+};
+
+struct rx_ring {
+	unsigned			head;			/* next slot to be written, only modified by the producer */
+	unsigned			tail;			/* next slot to be read, only modified by the consumer */
+	sem_t				filled;			/* counts the committed batches */
+	struct rx_batch		slot[RX_RING_SIZE];
+};
+
+void rx_ring_init(struct rx_ring *ring);
+
+/* Producer side: get a free slot (NULL if the ring is full), and publish it once filled. */
+struct rx_batch *rx_ring_reserve(struct rx_ring *ring);
+void rx_ring_commit(struct rx_ring *ring);
+
+/* Consumer side: wait up to timeout_ms for a batch (NULL on time-out), and give it back once processed. */
+struct rx_batch *rx_ring_peek(struct rx_ring *ring, unsigned timeout_ms);
+void rx_ring_release(struct rx_ring *ring);
+
+unsigned rx_ring_count(struct rx_ring *ring);
+
+#endif /* _RING_H_ */
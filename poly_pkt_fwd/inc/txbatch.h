@@ -0,0 +1,57 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+#ifndef _TXBATCH_H_
+#define _TXBATCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/uio.h>
+
+/*
+ * Batch of datagrams to be sent on connected UDP sockets. The datagrams are
+ * queued with their socket, then flushed with one sendmmsg() per run of
+ * consecutive datagrams sharing a socket. The buffers are referenced, not
+ * copied, so they must stay valid until the flush. After the flush, result[]
+ * holds the number of bytes sent for each datagram, or -1 if it failed.
+ */
+
+#define TX_BATCH_MAX	32	/* max nb of datagrams per flush */
+
+struct tx_batch {
+	int				nb;							/* nb of queued datagrams */
+	int				sock[TX_BATCH_MAX];			/* socket of each datagram */
+	int				tag[TX_BATCH_MAX];			/* caller data, eg. the server index */
+	int				result[TX_BATCH_MAX];		/* bytes sent or -1, valid after the flush */
+	struct iovec	iov[TX_BATCH_MAX];			/* buffer of each datagram */
+};
+
+void tx_batch_init(struct tx_batch *batch);
+
+/* Queue a datagram, returns false if the batch is full. */
+bool tx_batch_add(struct tx_batch *batch, int sock, const void *buf, size_t len, int tag);
+
+/* Send all the queued datagrams, returns the nb of datagrams sent. The batch
+ * must be re-initialized before queuing new datagrams. */
+int tx_batch_flush(struct tx_batch *batch);
+
+#endif /* _TXBATCH_H_ */
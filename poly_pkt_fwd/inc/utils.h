@@ -32,6 +32,9 @@ Maintainer: Ruud Vlaming
 #define STR(x)			STRINGIFY(x)
 #define TRACE() 		fprintf(stderr, "@ %s %d\n", __FUNCTION__, __LINE__);
 
+struct lw_filter;
+struct duty_cycle;
+
 void log_set_output(char *log_output);
 int log_msg(const char *format, ...);
 
@@ -43,10 +46,42 @@ struct gateway_conf{
 	char 	serv_addr[MAX_SERVERS][64]; 	/* addresses of the server (host name or IPv4/IPv6) */
 	char 	serv_port_up[MAX_SERVERS][8]; 	/* servers port for upstream traffic */
 	char 	serv_port_down[MAX_SERVERS][8]; /* servers port for downstream traffic */
+	bool	serv_binary[MAX_SERVERS];		/* server uses the binary encoding instead of JSON */
+	bool	serv_enrich[MAX_SERVERS];		/* rxpk objects carry the decoded LoRaWAN header fields */
+	struct lw_filter *serv_route[MAX_SERVERS];	/* uplinks routed to the server, NULL = all */
 	int 	keepalive_time; 				/* send a PULL_DATA request every X seconds, negative = disabled */
 	/* statistics collection configuration variables */
 	unsigned stat_interval; 				/* time interval (in sec) at which statistics are collected and displayed */
 
+	/* fetch loop scheduling */
+	int 	fetch_pkt_max;					/* max number of packets per fetch, up to NB_PKT_MAX */
+	unsigned fetch_sleep_max_ms;			/* ceiling of the back-off between fetches returning no packets */
+	unsigned shed_depth[3];					/* upstream queue depth from which each class of packets is shed, lowest priority first */
+
+	/* upstream aggregation window */
+	unsigned aggr_hold_ms;					/* max time a packet is held to share its datagram with later fetches, 0 = disabled */
+	int 	push_max_size;					/* size limit of a PUSH_DATA datagram, in bytes */
+
+	/* duplicate suppression */
+	unsigned dedup_window_ms;				/* time during which the copies of an uplink are dropped, 0 = disabled */
+
+	/* downlink scheduling */
+	unsigned jit_lead_ms;					/* time before its start at which a downlink is loaded in the concentrator */
+	struct duty_cycle *duty_cycle;			/* airtime limits of the downlinks per sub-band, NULL = none */
+
+	/* link quality of the devices */
+	unsigned link_table_size;				/* nb of devices tracked, 0 = disabled */
+
+	/* LoRaWAN network filter */
+	char 	filter_file[128];				/* path of the filter file, empty = every uplink is forwarded */
+
+	/* store-and-forward journal of the upstream datagrams */
+	char 	journal_path[128];				/* path of the journal file, empty = disabled */
+	uint32_t journal_size;					/* size of the journal ring, in bytes */
+	unsigned journal_catchup_rate;			/* max nb of journaled datagrams replayed per second and per server */
+	unsigned journal_sync_ms;				/* max time journal writes stay in the page cache */
+	unsigned journal_outage_ms;				/* time without PUSH_ACK after which a server is considered unreachable */
+
 	//TODO: This default values are a code-smell, remove.
 	char 	ghost_addr[64]; 				/* address of the server (host name or IPv4/IPv6) */
 	char 	ghost_port[8];					/* port to listen on */
@@ -60,6 +95,8 @@ struct gateway_conf{
 	bool 	gps_fake_enable; 				/* fake coordinates override real coordinates */
 
 	struct 	timeval push_timeout_half;
+	int 	push_retx_max;					/* max nb of retransmissions of an unacknowledged PUSH_DATA, 0 = disabled */
+	float 	push_retx_rate;					/* max nb of retransmissions per second and per server */
 	struct 	timeval pull_timeout;
 
 	bool 	fwd_valid_pkt;					/* packets with PAYLOAD CRC OK are forwarded */
@@ -104,11 +141,28 @@ struct gateway_conf{
 	.serv_count = 0, \
     .keepalive_time = DEFAULT_KEEPALIVE, \
 	.stat_interval = DEFAULT_STAT, \
+	.fetch_pkt_max = NB_PKT_MAX, \
+	.fetch_sleep_max_ms = FETCH_SLEEP_MS, \
+	.shed_depth = {SHED_DEPTH_BAD, SHED_DEPTH_DUP, SHED_DEPTH_UNCONF}, \
+	.aggr_hold_ms = 0, \
+	.push_max_size = PUSH_MAX_SIZE, \
+	.dedup_window_ms = DEDUP_WINDOW_MS, \
+	.link_table_size = LINKQ_SIZE, \
+	.jit_lead_ms = JIT_LEAD_MS, \
+	.duty_cycle = NULL, \
+	.filter_file = "", \
+	.journal_path = "", \
+	.journal_size = JOURNAL_SIZE, \
+	.journal_catchup_rate = JOURNAL_CATCHUP_RATE, \
+	.journal_sync_ms = JOURNAL_SYNC_MS, \
+	.journal_outage_ms = JOURNAL_OUTAGE_MS, \
 	.ghost_addr = "127.0.0.1", \
 	.ghost_port = "1914", \
 	.monitor_addr = "127.0.0.1", \
 	.monitor_port = "2008", \
 	.push_timeout_half = {0, (PUSH_TIMEOUT_MS * 500)}, \
+	.push_retx_max = PUSH_RETX_MAX, \
+	.push_retx_rate = PUSH_RETX_RATE, \
 	.pull_timeout = {0, (PULL_TIMEOUT_MS * 1000)}, \
 	.fwd_valid_pkt = true, \
 	.fwd_error_pkt = false, \
@@ -0,0 +1,154 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+#include "airtime.h"
+
+#define LORA_PREAMB_DEFAULT	8
+#define FSK_PREAMB_DEFAULT	5
+#define FSK_SYNC_SIZE		3
+
+#define TAB_SF_MIN			7
+#define TAB_NB_SF			6		/* SF7 to SF12 */
+#define TAB_NB_BW			3		/* 125, 250 and 500 kHz */
+#define TAB_NB_SIZE			256
+
+static bool tab_ok = false;
+static uint8_t tab_blocks[2][2][TAB_NB_SF][2][TAB_NB_SIZE];	/* [crc][implicit][sf][low data rate optimization][size] */
+static uint32_t tab_tsym_ns[TAB_NB_SF][TAB_NB_BW];
+
+/* nb of 4-bit coding blocks of the payload beyond the first 8 symbols */
+static int lora_blocks(int sf, int de, unsigned size, bool crc, bool implicit){
+	int num = 8 * (int)size - 4 * sf + 28 + (crc ? 16 : 0) - (implicit ? 20 : 0);
+	int den = 4 * (sf - 2 * de);
+
+	return (num > 0) ? ((num + den - 1) / den) : 0;
+}
+
+static int bw_index(int bw_khz){
+	switch(bw_khz){
+		case 125: return 0;
+		case 250: return 1;
+		case 500: return 2;
+		default: return -1;
+	}
+}
+
+void airtime_init(void){
+	static const int bw_khz[TAB_NB_BW] = {125, 250, 500};
+	int crc, ih, sf, de, b;
+	unsigned size;
+
+	for(crc = 0; crc < 2; ++crc)
+	for(ih = 0; ih < 2; ++ih)
+	for(sf = 0; sf < TAB_NB_SF; ++sf)
+	for(de = 0; de < 2; ++de)
+	for(size = 0; size < TAB_NB_SIZE; ++size){
+		tab_blocks[crc][ih][sf][de][size] = (uint8_t)lora_blocks(TAB_SF_MIN + sf, de, size, crc, ih);
+	}
+	for(sf = 0; sf < TAB_NB_SF; ++sf)
+	for(b = 0; b < TAB_NB_BW; ++b){
+		tab_tsym_ns[sf][b] = (uint32_t)((1000000u << (TAB_SF_MIN + sf)) / (uint32_t)bw_khz[b]);
+	}
+	tab_ok = true;
+}
+
+uint32_t airtime_lora(int sf, int bw_khz, int cr, unsigned preamble, unsigned size, bool crc, bool implicit){
+	int de = ((sf >= 11) && (bw_khz == 125)) ? 1 : 0; /* low data rate optimization, symbols over 16 ms */
+	int b = bw_index(bw_khz);
+	int nb_sym, blocks;
+	uint32_t tsym_ns;
+
+	if(tab_ok && (sf >= TAB_SF_MIN) && (sf < TAB_SF_MIN + TAB_NB_SF) && (size < TAB_NB_SIZE) && (b >= 0)){
+		blocks = tab_blocks[crc][implicit][sf - TAB_SF_MIN][de][size];
+		tsym_ns = tab_tsym_ns[sf - TAB_SF_MIN][b];
+	}else{
+		blocks = lora_blocks(sf, de, size, crc, implicit);
+		tsym_ns = (uint32_t)((1000000u << sf) / (uint32_t)bw_khz);
+	}
+	nb_sym = 8 + blocks * (cr + 4);
+
+	/* the preamble lasts n + 4.25 symbols, counted in quarters of symbol */
+	return (uint32_t)((((uint64_t)(4 * preamble + 17 + 4 * nb_sym)) * tsym_ns / 4 + 999) / 1000);
+}
+
+uint32_t airtime_fsk(uint32_t bps, unsigned preamble, unsigned size, bool crc){
+	uint32_t bits = 8 * (preamble + FSK_SYNC_SIZE + 1 + size + (crc ? 2 : 0));
+
+	return (uint32_t)(((uint64_t)bits * 1000000 + bps - 1) / bps);
+}
+
+/* LoRa settings of the HAL in the units of airtime_lora(), false if invalid */
+static bool lora_settings(uint32_t datarate, uint8_t bandwidth, uint8_t coderate, int *sf, int *bw, int *cr){
+	switch(datarate){
+		case DR_LORA_SF7:  *sf = 7;  break;
+		case DR_LORA_SF8:  *sf = 8;  break;
+		case DR_LORA_SF9:  *sf = 9;  break;
+		case DR_LORA_SF10: *sf = 10; break;
+		case DR_LORA_SF11: *sf = 11; break;
+		case DR_LORA_SF12: *sf = 12; break;
+		default: return false;
+	}
+	switch(bandwidth){
+		case BW_125KHZ: *bw = 125; break;
+		case BW_250KHZ: *bw = 250; break;
+		case BW_500KHZ: *bw = 500; break;
+		default: return false;
+	}
+	switch(coderate){
+		case CR_LORA_4_5: *cr = 1; break;
+		case CR_LORA_4_6: *cr = 2; break;
+		case CR_LORA_4_7: *cr = 3; break;
+		case CR_LORA_4_8: *cr = 4; break;
+		default: return false;
+	}
+	return true;
+}
+
+uint32_t airtime_tx(const struct lgw_pkt_tx_s *p){
+	int sf, bw, cr;
+
+	if(p->modulation == MOD_FSK){
+		if(p->datarate == 0){
+			return 0;
+		}
+		return airtime_fsk(p->datarate, (p->preamble > 0) ? p->preamble : FSK_PREAMB_DEFAULT, p->size, !p->no_crc);
+	}
+	if((p->modulation != MOD_LORA) || !lora_settings(p->datarate, p->bandwidth, p->coderate, &sf, &bw, &cr)){
+		return 0;
+	}
+	return airtime_lora(sf, bw, cr, (p->preamble > 0) ? p->preamble : LORA_PREAMB_DEFAULT, p->size, !p->no_crc, p->no_header);
+}
+
+uint32_t airtime_rx(const struct lgw_pkt_rx_s *p){
+	int sf, bw, cr;
+
+	if(p->modulation == MOD_FSK){
+		if(p->datarate == 0){
+			return 0;
+		}
+		return airtime_fsk(p->datarate, FSK_PREAMB_DEFAULT, p->size, p->status != STAT_NO_CRC);
+	}
+	if((p->modulation != MOD_LORA) || !lora_settings(p->datarate, p->bandwidth, p->coderate, &sf, &bw, &cr)){
+		return 0;
+	}
+	return airtime_lora(sf, bw, cr, LORA_PREAMB_DEFAULT, p->size, p->status != STAT_NO_CRC, false);
+}
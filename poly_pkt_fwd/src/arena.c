@@ -0,0 +1,136 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+#include "arena.h"
+#include "parson.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN		16	/* alignment of the blocks, enough for any type parson stores */
+#define ARENA_HDR		ARENA_ALIGN	/* the size of a block is stored just before it, keeping the alignment */
+#define ARENA_NONE		((size_t)-1)
+#define ALIGN_UP(n)		(((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+static __thread struct arena *arena_cur = NULL;
+
+int arena_init(struct arena *a, size_t size){
+	memset(a, 0, sizeof *a);
+	a->buf = malloc(size);
+	if(a->buf == NULL){
+		return -1;
+	}
+	a->size = size;
+	a->last = ARENA_NONE;
+	return 0;
+}
+
+void arena_free(struct arena *a){
+	free(a->buf);
+	a->buf = NULL;
+	a->size = 0;
+	a->used = 0;
+	a->last = ARENA_NONE;
+}
+
+void arena_reset(struct arena *a){
+	a->used = 0;
+	a->last = ARENA_NONE;
+}
+
+void arena_use(struct arena *a){
+	arena_cur = a;
+}
+
+static int arena_owns(const struct arena *a, const void *ptr){
+	return (a != NULL) && ((const uint8_t *)ptr >= a->buf) && ((const uint8_t *)ptr < a->buf + a->size);
+}
+
+static size_t *block_size(void *ptr){
+	return (size_t *)((uint8_t *)ptr - ARENA_HDR);
+}
+
+static void arena_used(struct arena *a, size_t used){
+	a->used = used;
+	if(used > a->peak){
+		__atomic_store_n(&a->peak, used, __ATOMIC_RELAXED); /* read by the statistics */
+	}
+}
+
+static void *arena_malloc(size_t n){
+	struct arena *a = arena_cur;
+	size_t need = ARENA_HDR + ALIGN_UP(n);
+	uint8_t *block;
+
+	if(a == NULL){
+		return malloc(n);
+	}
+	if(need > a->size - a->used){
+		__atomic_store_n(&a->nb_fallback, a->nb_fallback + 1, __ATOMIC_RELAXED);
+		return malloc(n);
+	}
+	block = a->buf + a->used;
+	*(size_t *)block = n;
+	a->last = a->used;
+	arena_used(a, a->used + need);
+	return block + ARENA_HDR;
+}
+
+static void arena_release(void *ptr){
+	if(!arena_owns(arena_cur, ptr)){
+		free(ptr);
+	}
+	/* the blocks of the arena go away with the next reset */
+}
+
+static void *arena_realloc(void *ptr, size_t n){
+	struct arena *a = arena_cur;
+	size_t need = ARENA_HDR + ALIGN_UP(n);
+	size_t old;
+	void *moved;
+
+	if(ptr == NULL){
+		return arena_malloc(n);
+	}
+	if(!arena_owns(a, ptr)){
+		return realloc(ptr, n);
+	}
+	old = *block_size(ptr);
+	/* the latest block grows or shrinks in place while the buffer allows it */
+	if(((uint8_t *)ptr - ARENA_HDR == a->buf + a->last) && (need <= a->size - a->last)){
+		*block_size(ptr) = n;
+		arena_used(a, a->last + need);
+		return ptr;
+	}
+	if(n <= old){
+		*block_size(ptr) = n;
+		return ptr;
+	}
+	moved = arena_malloc(n);
+	if(moved != NULL){
+		memcpy(moved, ptr, old);
+	}
+	return moved;
+}
+
+void arena_install(void){
+	json_set_allocation_functions(arena_malloc, arena_release, arena_realloc);
+}
@@ -0,0 +1,77 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+#include "dedup.h"
+#include <string.h>
+
+void dedup_init(struct dedup *table, uint32_t window_ms){
+	table->window_ms = window_ms;
+	memset(table->e, 0, sizeof table->e);
+}
+
+uint32_t dedup_hash(const uint8_t *payload, uint16_t size){
+	uint32_t h = 2166136261u; /* FNV-1a */
+	uint16_t i;
+
+	for(i = 0; i < size; ++i){
+		h = (h ^ payload[i]) * 16777619u;
+	}
+	h ^= size;
+	return (h != 0) ? h : 1;
+}
+
+bool dedup_close(const struct dedup *table, uint32_t count_a, uint32_t count_b){
+	uint32_t diff = count_a - count_b;
+
+	if(diff > 0x80000000u){
+		diff = -diff; /* counter wrap-around */
+	}
+	return diff <= table->window_ms * 1000;
+}
+
+bool dedup_check(struct dedup *table, uint32_t hash, uint32_t now_ms){
+	struct dedup_entry *e, *spare = NULL, *oldest = NULL;
+	int i;
+
+	for(i = 0; i < DEDUP_PROBE_MAX; ++i){
+		e = &table->e[(hash + i) & (DEDUP_TABLE_SIZE - 1)];
+		if(e->hash == 0){
+			if(spare == NULL) spare = e;
+			break; /* never used, the frame cannot be further */
+		}
+		if(now_ms - e->time_ms > table->window_ms){
+			if(spare == NULL) spare = e; /* expired */
+			continue;
+		}
+		if(e->hash == hash){
+			return true;
+		}
+		if((oldest == NULL) || (now_ms - e->time_ms > now_ms - oldest->time_ms)){
+			oldest = e;
+		}
+	}
+	/* the first free entry, or the oldest one if all are in use */
+	e = (spare != NULL) ? spare : oldest;
+	e->hash = hash;
+	e->time_ms = now_ms;
+	return false;
+}
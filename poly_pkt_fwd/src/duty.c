@@ -0,0 +1,217 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "duty.h"
+
+struct region_band {
+	uint32_t			freq_min, freq_max;
+	float				percent;
+	uint32_t			dwell_ms;
+};
+
+/* ETSI EN 300 220 sub-bands used by LoRaWAN */
+static const struct region_band eu868[] = {
+	{863000000, 865000000, 0.1, 0},
+	{865000000, 868000000, 1.0, 0},
+	{868000000, 868600000, 1.0, 0},
+	{868700000, 869200000, 0.1, 0},
+	{869400000, 869650000, 10.0, 0},
+	{869700000, 870000000, 1.0, 0},
+};
+
+/* dwell time limit of the AS923 countries enforcing it */
+static const struct region_band as923[] = {
+	{915000000, 928000000, 0.0, 400},
+};
+
+static struct duty_band *find(struct duty_cycle *d, uint32_t freq_hz){
+	int i;
+
+	for(i = 0; i < d->nb_band; ++i){
+		if((freq_hz >= d->band[i].freq_min) && (freq_hz < d->band[i].freq_max)){
+			return &d->band[i];
+		}
+	}
+	return NULL;
+}
+
+/* empty the buckets whose period left the window */
+static void advance(struct duty_cycle *d, uint32_t now_s){
+	uint32_t epoch = now_s / d->bucket_s;
+	uint32_t n = epoch - d->epoch;
+	uint32_t k, idx;
+	int i;
+
+	if(n > DUTY_NB_BUCKET){
+		n = DUTY_NB_BUCKET;
+	}
+	for(k = 1; k <= n; ++k){
+		idx = (epoch - n + k) % DUTY_NB_BUCKET;
+		for(i = 0; i < d->nb_band; ++i){
+			d->band[i].used_us -= d->band[i].bucket[idx];
+			d->band[i].beacon_us -= d->band[i].beacon_bucket[idx];
+			d->band[i].bucket[idx] = 0;
+			d->band[i].beacon_bucket[idx] = 0;
+		}
+	}
+	d->epoch = epoch;
+}
+
+/* airtime the band allows over the window, the other packets leave what the beacon has not used of its reserve */
+static uint64_t limit(const struct duty_band *b, bool beacon){
+	if(beacon || (b->beacon_us >= b->reserve_us)){
+		return b->budget_us;
+	}
+	return b->budget_us - (b->reserve_us - b->beacon_us);
+}
+
+struct duty_cycle *duty_create(uint32_t window_s){
+	struct duty_cycle *d;
+
+	if(window_s < DUTY_NB_BUCKET){
+		return NULL;
+	}
+	d = calloc(1, sizeof *d);
+	if(d == NULL){
+		return NULL;
+	}
+	d->window_s = window_s;
+	d->bucket_s = window_s / DUTY_NB_BUCKET;
+	return d;
+}
+
+void duty_free(struct duty_cycle *d){
+	free(d);
+}
+
+int duty_add_band(struct duty_cycle *d, uint32_t freq_min, uint32_t freq_max, float percent, uint32_t dwell_ms){
+	struct duty_band *b;
+
+	if((d->nb_band >= DUTY_BAND_MAX) || (freq_min >= freq_max) || (percent < 0.0) || (percent > 100.0)){
+		return -1;
+	}
+	b = &d->band[d->nb_band++];
+	memset(b, 0, sizeof *b);
+	b->freq_min = freq_min;
+	b->freq_max = freq_max;
+	b->budget_us = (uint64_t)((double)d->bucket_s * DUTY_NB_BUCKET * 1e4 * percent);
+	b->dwell_us = 1000 * dwell_ms;
+	return 0;
+}
+
+int duty_add_region(struct duty_cycle *d, const char *region){
+	const struct region_band *r;
+	int i, n;
+
+	if(strcmp(region, "EU868") == 0){
+		r = eu868;
+		n = sizeof eu868 / sizeof eu868[0];
+	}else if(strcmp(region, "AS923") == 0){
+		r = as923;
+		n = sizeof as923 / sizeof as923[0];
+	}else{
+		return -1;
+	}
+	for(i = 0; i < n; ++i){
+		if(duty_add_band(d, r[i].freq_min, r[i].freq_max, r[i].percent, r[i].dwell_ms) != 0){
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void duty_reserve(struct duty_cycle *d, uint32_t freq_hz, uint32_t reserve_us){
+	struct duty_band *b = find(d, freq_hz);
+
+	if(b != NULL){
+		b->reserve_us = (reserve_us < b->budget_us) ? reserve_us : b->budget_us;
+	}
+}
+
+enum duty_verdict duty_take(struct duty_cycle *d, uint32_t freq_hz, uint32_t toa_us, bool beacon, uint32_t now_s){
+	struct duty_band *b = find(d, freq_hz);
+	uint32_t idx;
+
+	if(b == NULL){
+		return DUTY_OK;
+	}
+	if((b->dwell_us > 0) && (toa_us > b->dwell_us)){
+		return DUTY_DWELL;
+	}
+	advance(d, now_s);
+	if((b->budget_us > 0) && (b->used_us + toa_us > limit(b, beacon))){
+		return DUTY_BUDGET;
+	}
+	idx = d->epoch % DUTY_NB_BUCKET;
+	b->bucket[idx] += toa_us;
+	b->used_us += toa_us;
+	if(beacon){
+		b->beacon_bucket[idx] += toa_us;
+		b->beacon_us += toa_us;
+	}
+	return DUTY_OK;
+}
+
+void duty_release(struct duty_cycle *d, uint32_t freq_hz, uint32_t toa_us, bool beacon, uint32_t now_s){
+	struct duty_band *b = find(d, freq_hz);
+	uint32_t k, idx, take;
+
+	if(b == NULL){
+		return;
+	}
+	advance(d, now_s);
+	/* the packet was charged when queued, possibly in an earlier bucket, what left the window is not given back */
+	for(k = 0; (k < DUTY_NB_BUCKET) && (toa_us > 0); ++k){
+		idx = (d->epoch % DUTY_NB_BUCKET + DUTY_NB_BUCKET - k) % DUTY_NB_BUCKET;
+		take = beacon ? b->beacon_bucket[idx] : (b->bucket[idx] - b->beacon_bucket[idx]);
+		if(take > toa_us){
+			take = toa_us;
+		}
+		b->bucket[idx] -= take;
+		b->used_us -= take;
+		if(beacon){
+			b->beacon_bucket[idx] -= take;
+			b->beacon_us -= take;
+		}
+		toa_us -= take;
+	}
+}
+
+uint64_t duty_remaining(struct duty_cycle *d, int band, uint32_t now_s){
+	struct duty_band *b = &d->band[band];
+	uint64_t max_us;
+
+	if(b->budget_us == 0){
+		return UINT64_MAX;
+	}
+	advance(d, now_s);
+	max_us = limit(b, false);
+	return (b->used_us < max_us) ? (max_us - b->used_us) : 0;
+}
+
+const char *duty_verdict_name(enum duty_verdict v){
+	static const char *name[DUTY_NB_VERDICT] = {"ok", "longer than the dwell time", "over the duty-cycle budget"};
+	return ((unsigned)v < DUTY_NB_VERDICT) ? name[v] : "unknown";
+}
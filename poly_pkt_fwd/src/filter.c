@@ -0,0 +1,253 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+/* fix an issue between POSIX and C99 */
+#ifdef __MACH__
+#elif __STDC_VERSION__ >= 199901L
+	#define _XOPEN_SOURCE 600
+#else
+	#define _XOPEN_SOURCE 500
+#endif
+
+#include "filter.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TYPE(mtype)		(1u << (mtype))
+#define TYPES_DEFAULT	(TYPE(LW_JOIN_REQUEST) | TYPE(LW_REJOIN_REQUEST) | TYPE(LW_UNCONF_UP) | TYPE(LW_CONF_UP))
+#define TYPES_OTHER		(TYPE(LW_JOIN_ACCEPT) | TYPE(LW_UNCONF_DOWN) | TYPE(LW_CONF_DOWN) | TYPE(FILTER_INVALID))
+
+static const struct {
+	const char *name;
+	uint16_t types;
+} type_names[] = {
+	{"join",		TYPE(LW_JOIN_REQUEST)},
+	{"rejoin",		TYPE(LW_REJOIN_REQUEST)},
+	{"unconfirmed",	TYPE(LW_UNCONF_UP)},
+	{"confirmed",	TYPE(LW_CONF_UP)},
+	{"data",		TYPE(LW_UNCONF_UP) | TYPE(LW_CONF_UP)},
+	{"proprietary",	TYPE(LW_PROPRIETARY)},
+	{"other",		TYPES_OTHER}
+};
+
+static int cmp_u32(const void *a, const void *b){
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+static int cmp_range(const void *a, const void *b){
+	uint64_t x = ((const struct eui_range *)a)->min, y = ((const struct eui_range *)b)->min;
+	return (x > y) - (x < y);
+}
+
+/* nb of entries of an optional array of strings, 0 if absent */
+static int get_count(const JSON_Object *obj, const char *key){
+	JSON_Array *arr = json_object_get_array(obj, key);
+	return (arr != NULL) ? (int)json_array_get_count(arr) : 0;
+}
+
+static const char *get_entry(const JSON_Object *obj, const char *key, int i){
+	return json_array_get_string(json_object_get_array(obj, key), i);
+}
+
+/* the last range starting at or before eui, if it covers it */
+static bool range_match(const struct eui_range *r, int nb, uint64_t eui){
+	int lo = 0, hi = nb - 1, mid;
+
+	while(lo <= hi){
+		mid = (lo + hi) / 2;
+		if(r[mid].min > eui){
+			hi = mid - 1;
+		} else if(r[mid].max < eui){
+			lo = mid + 1;
+		} else {
+			return true;
+		}
+	}
+	return false;
+}
+
+struct lw_filter *filter_parse(const JSON_Object *obj, const char *name){
+	struct lw_filter *f;
+	const char *str;
+	unsigned long long min, max;
+	unsigned addr;
+	int i, j, nb, bits;
+
+	f = calloc(1, sizeof *f);
+
+	/* frame types */
+	nb = get_count(obj, "frame_types");
+	if(nb == 0){
+		f->types = TYPES_DEFAULT;
+		if(json_object_get_boolean(obj, "forward_other") == 1){
+			f->types |= TYPE(LW_PROPRIETARY) | TYPES_OTHER;
+		}
+	}
+	for(i = 0; i < nb; ++i){
+		str = get_entry(obj, "frame_types", i);
+		for(j = 0; (str != NULL) && (j < (int)ARRAY_SIZE(type_names)) && (strcmp(str, type_names[j].name) != 0); ++j);
+		if((str == NULL) || (j == (int)ARRAY_SIZE(type_names))){
+			log_msg("ERROR: [filter] %s: unknown frame type %i\n", name, i);
+			goto fail;
+		}
+		f->types |= type_names[j].types;
+	}
+
+	/* the NetIDs and the explicit blocks share the prefix table */
+	if(get_count(obj, "netid") + get_count(obj, "devaddr_prefix") > FILTER_PREFIX_MAX){
+		log_msg("ERROR: [filter] %s: too many NetIDs and DevAddr prefixes, %i max\n", name, FILTER_PREFIX_MAX);
+		goto fail;
+	}
+	nb = get_count(obj, "netid");
+	for(i = 0; i < nb; ++i){
+		str = get_entry(obj, "netid", i);
+		if((str == NULL) || (sscanf(str, "%x", &addr) != 1) || (lw_netid_prefix(addr, &f->prefix[f->nb_prefix], &bits) != 0)){
+			log_msg("ERROR: [filter] %s: invalid NetID %i\n", name, i);
+			goto fail;
+		}
+		f->mask[f->nb_prefix++] = ~0u << (32 - bits);
+	}
+	nb = get_count(obj, "devaddr_prefix");
+	for(i = 0; i < nb; ++i){
+		str = get_entry(obj, "devaddr_prefix", i);
+		if((str == NULL) || (sscanf(str, "%x/%i", &addr, &bits) != 2) || (bits < 1) || (bits > 32)){
+			log_msg("ERROR: [filter] %s: invalid DevAddr prefix %i, expected eg. 26011000/20\n", name, i);
+			goto fail;
+		}
+		f->mask[f->nb_prefix] = ~0u << (32 - bits);
+		f->prefix[f->nb_prefix] = addr & f->mask[f->nb_prefix];
+		++f->nb_prefix;
+	}
+
+	/* DevAddr list */
+	nb = get_count(obj, "devaddr");
+	f->devaddr = malloc((nb + 1) * sizeof *f->devaddr);
+	for(i = 0; i < nb; ++i){
+		str = get_entry(obj, "devaddr", i);
+		if((str == NULL) || (sscanf(str, "%x", &addr) != 1)){
+			log_msg("ERROR: [filter] %s: invalid DevAddr %i\n", name, i);
+			goto fail;
+		}
+		f->devaddr[f->nb_devaddr++] = addr;
+	}
+	qsort(f->devaddr, f->nb_devaddr, sizeof *f->devaddr, cmp_u32);
+
+	/* JoinEUI ranges, merged when they overlap */
+	nb = get_count(obj, "join_eui");
+	f->join_eui = malloc((nb + 1) * sizeof *f->join_eui);
+	for(i = 0; i < nb; ++i){
+		str = get_entry(obj, "join_eui", i);
+		j = (str != NULL) ? sscanf(str, "%llx-%llx", &min, &max) : 0;
+		if(j == 1){
+			max = min;
+		}
+		if((j < 1) || (max < min)){
+			log_msg("ERROR: [filter] %s: invalid JoinEUI %i, expected eg. 70B3D57ED0000000 or 70B3D57ED0000000-70B3D57ED00000FF\n", name, i);
+			goto fail;
+		}
+		f->join_eui[i].min = min;
+		f->join_eui[i].max = max;
+	}
+	qsort(f->join_eui, nb, sizeof *f->join_eui, cmp_range);
+	for(i = 0; i < nb; ++i){
+		if((f->nb_join_eui > 0) && (f->join_eui[i].min <= f->join_eui[f->nb_join_eui - 1].max)){
+			if(f->join_eui[i].max > f->join_eui[f->nb_join_eui - 1].max){
+				f->join_eui[f->nb_join_eui - 1].max = f->join_eui[i].max;
+			}
+		} else {
+			f->join_eui[f->nb_join_eui++] = f->join_eui[i];
+		}
+	}
+	return f;
+
+fail:
+	filter_free(f);
+	return NULL;
+}
+
+struct lw_filter *filter_load(const char *path){
+	JSON_Value *root_val;
+	struct lw_filter *f = NULL;
+
+	root_val = json_parse_file_with_comments(path);
+	if(json_value_get_object(root_val) == NULL){
+		log_msg("ERROR: [filter] %s is not a valid JSON object\n", path);
+	} else {
+		f = filter_parse(json_value_get_object(root_val), path);
+	}
+	json_value_free(root_val);
+	if(f != NULL){
+		log_msg("INFO: [filter] %s loaded: %i DevAddr blocks, %i DevAddr, %i JoinEUI ranges, frame types 0x%03X\n", path, f->nb_prefix, f->nb_devaddr, f->nb_join_eui, f->types);
+	}
+	return f;
+}
+
+void filter_free(struct lw_filter *f){
+	if(f != NULL){
+		free(f->devaddr);
+		free(f->join_eui);
+		free(f);
+	}
+}
+
+enum filter_verdict filter_check(const struct lw_filter *filter, const struct lw_frame *f){
+	int i;
+
+	if(f == NULL){
+		return (filter->types & TYPE(FILTER_INVALID)) ? FILTER_PASS : FILTER_DROP_OTHER;
+	}
+	switch(f->mtype){
+		case LW_UNCONF_UP:
+		case LW_CONF_UP:
+			if(!(filter->types & TYPE(f->mtype))){
+				return FILTER_DROP_DATA;
+			}
+			if((filter->nb_prefix == 0) && (filter->nb_devaddr == 0)){
+				return FILTER_PASS;
+			}
+			for(i = 0; i < filter->nb_prefix; ++i){
+				if((f->devaddr & filter->mask[i]) == filter->prefix[i]){
+					return FILTER_PASS;
+				}
+			}
+			if(bsearch(&f->devaddr, filter->devaddr, filter->nb_devaddr, sizeof *filter->devaddr, cmp_u32) != NULL){
+				return FILTER_PASS;
+			}
+			return FILTER_DROP_DATA;
+		case LW_JOIN_REQUEST:
+			if(!(filter->types & TYPE(f->mtype))){
+				return FILTER_DROP_JOIN;
+			}
+			if((filter->nb_join_eui == 0) || range_match(filter->join_eui, filter->nb_join_eui, f->join_eui)){
+				return FILTER_PASS;
+			}
+			return FILTER_DROP_JOIN;
+		case LW_REJOIN_REQUEST:
+			/* the NetID or JoinEUI is in the encrypted part for some types */
+			return (filter->types & TYPE(f->mtype)) ? FILTER_PASS : FILTER_DROP_JOIN;
+		default:
+			return (filter->types & TYPE(f->mtype)) ? FILTER_PASS : FILTER_DROP_OTHER;
+	}
+}
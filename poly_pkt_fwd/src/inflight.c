@@ -0,0 +1,195 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+/* fix an issue between POSIX and C99 */
+#ifdef __MACH__
+#elif __STDC_VERSION__ >= 199901L
+	#define _XOPEN_SOURCE 600
+#else
+	#define _XOPEN_SOURCE 500
+#endif
+
+#include "inflight.h"
+#include "utils.h"
+#include <string.h>
+
+#define INFLIGHT_MASK	(PUSH_INFLIGHT_MAX - 1)
+#define COPY_MASK		(PUSH_RETX_COPIES - 1)
+
+static struct timespec add_ms(struct timespec t, int ms){
+	t.tv_sec += ms / 1000;
+	t.tv_nsec += (long)(ms % 1000) * 1000000;
+	if(t.tv_nsec >= 1000000000){
+		t.tv_sec += 1;
+		t.tv_nsec -= 1000000000;
+	}
+	return t;
+}
+
+/* time-out of an entry, doubled on each retransmission */
+static int entry_rto(const struct inflight *table, const struct inflight_entry *e){
+	int rto = table->rto << e->retx;
+	return (rto < PUSH_RTO_MAX_MS) ? rto : PUSH_RTO_MAX_MS;
+}
+
+/* budget of retransmissions at now, one second of it or a single one if the rate is lower */
+static float credit(const struct inflight *table, struct timespec now){
+	float c = table->retx_credit + table->retx_rate * difftimespec(now, table->credit_time);
+	float cap = (table->retx_rate > 1) ? table->retx_rate : 1;
+
+	return (c > cap) ? cap : c;
+}
+
+void inflight_init(struct inflight *table, int rto_min_ms, int retx_max, float retx_rate){
+	pthread_mutex_init(&table->m, NULL);
+	memset(table->e, 0, sizeof table->e);
+	memset(table->copy, 0, sizeof table->copy);
+	table->rtt_valid = false;
+	table->rto_min = rto_min_ms;
+	table->rto = (rto_min_ms > PUSH_RTO_INIT_MS) ? rto_min_ms : PUSH_RTO_INIT_MS;
+	table->retx_max = retx_max;
+	table->retx_rate = retx_rate;
+	table->retx_credit = 0;
+	clock_gettime(CLOCK_MONOTONIC, &table->credit_time);
+}
+
+bool inflight_add(struct inflight *table, uint16_t token, struct timespec send_time, const void *buf, int len){
+	struct inflight_entry *e = &table->e[token & INFLIGHT_MASK];
+	struct inflight_copy *c = &table->copy[token & COPY_MASK];
+	bool evicted;
+
+	pthread_mutex_lock(&table->m);
+	evicted = e->used;
+	e->used = true;
+	e->token = token;
+	e->retx = 0;
+	e->expired = (table->retx_max == 0); /* nothing to wait for without retransmission */
+	e->send_time = send_time;
+	e->deadline = add_ms(send_time, table->rto);
+	if((table->retx_max > 0) && (len <= PUSH_RETX_SIZE)){
+		c->token = token;
+		c->len = len;
+		memcpy(c->buf, buf, len);
+	}else{
+		c->len = 0;
+	}
+	pthread_mutex_unlock(&table->m);
+
+	return evicted;
+}
+
+bool inflight_ack(struct inflight *table, uint16_t token, struct timespec recv_time, int *rtt_ms){
+	struct inflight_entry *e = &table->e[token & INFLIGHT_MASK];
+	float rtt, err;
+	bool match;
+
+	pthread_mutex_lock(&table->m);
+	match = e->used && (e->token == token);
+	if(match){
+		e->used = false;
+		*rtt_ms = -1;
+		if(e->retx == 0){
+			rtt = 1000 * difftimespec(recv_time, e->send_time);
+			*rtt_ms = (int)rtt;
+			if(table->rtt_valid){
+				err = (rtt > table->srtt) ? (rtt - table->srtt) : (table->srtt - rtt);
+				table->rttvar = 0.75 * table->rttvar + 0.25 * err;
+				table->srtt = 0.875 * table->srtt + 0.125 * rtt;
+			}else{
+				table->srtt = rtt;
+				table->rttvar = rtt / 2;
+				table->rtt_valid = true;
+			}
+			table->rto = (int)(table->srtt + 4 * table->rttvar) + 1;
+			if(table->rto < table->rto_min) table->rto = table->rto_min;
+			if(table->rto > PUSH_RTO_MAX_MS) table->rto = PUSH_RTO_MAX_MS;
+		}
+	}
+	pthread_mutex_unlock(&table->m);
+
+	return match;
+}
+
+int inflight_retx(struct inflight *table, struct timespec now, uint8_t *buf, int *expired){
+	struct inflight_entry *e;
+	struct inflight_copy *c;
+	int i, len = 0;
+
+	*expired = 0;
+	pthread_mutex_lock(&table->m);
+	table->retx_credit = credit(table, now);
+	table->credit_time = now;
+	for(i = 0; i < PUSH_INFLIGHT_MAX; ++i){
+		e = &table->e[i];
+		if(!e->used || e->expired || (difftimespec(now, e->deadline) < 0)){
+			continue;
+		}
+		c = &table->copy[e->token & COPY_MASK];
+		if((e->retx >= table->retx_max) || (c->len == 0) || (c->token != e->token)){
+			e->expired = true; /* out of retries, or too old or too large to have been kept */
+			++*expired;
+			continue;
+		}
+		if(table->retx_credit < 1){
+			break; /* over budget, waits for the next call */
+		}
+		table->retx_credit -= 1;
+		++e->retx;
+		e->send_time = now;
+		e->deadline = add_ms(now, entry_rto(table, e));
+		len = c->len;
+		memcpy(buf, c->buf, len);
+		break;
+	}
+	pthread_mutex_unlock(&table->m);
+
+	return len;
+}
+
+int inflight_wait_ms(struct inflight *table, struct timespec now, int max_ms){
+	int i, ms, wait = max_ms;
+	int refill = 0; /* time until the budget allows a retransmission */
+	float c;
+
+	pthread_mutex_lock(&table->m);
+	c = credit(table, now);
+	if(c < 1){
+		refill = (int)(1000 * (1 - c) / table->retx_rate) + 1; /* rounded up */
+	}
+	for(i = 0; i < PUSH_INFLIGHT_MAX; ++i){
+		if(table->e[i].used && !table->e[i].expired){
+			ms = (int)(1000 * difftimespec(table->e[i].deadline, now));
+			if(ms < refill) ms = refill; /* an overdue packet over budget is not sent before */
+			if(ms < wait) wait = ms;
+		}
+	}
+	pthread_mutex_unlock(&table->m);
+
+	return wait;
+}
+
+void inflight_rtt(struct inflight *table, int *srtt_ms, int *rto_ms){
+	pthread_mutex_lock(&table->m);
+	*srtt_ms = table->rtt_valid ? (int)table->srtt : -1;
+	*rto_ms = table->rto;
+	pthread_mutex_unlock(&table->m);
+}
@@ -0,0 +1,133 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+#include "jit.h"
+#include <string.h>
+
+/* both packets are on air or too close to load the second one, counter wrap-around included */
+static bool overlap(const struct jit_queue *q, uint32_t start_us, uint32_t end_us, const struct jit_slot *s){
+	return ((int32_t)(start_us - (s->end_us + q->margin_us)) < 0) && ((int32_t)(s->start_us - (end_us + q->margin_us)) < 0);
+}
+
+void jit_init(struct jit_queue *q, uint32_t margin_us){
+	unsigned i;
+
+	memset(q, 0, sizeof *q);
+	q->margin_us = margin_us;
+	q->nb_free = JIT_QUEUE_SIZE;
+	for(i = 0; i < JIT_QUEUE_SIZE; ++i){
+		q->free[i] = (uint8_t)i;
+	}
+}
+
+enum jit_error jit_enqueue(struct jit_queue *q, const struct lgw_pkt_tx_s *pkt, enum jit_class cls, uint32_t start_us, uint32_t toa_us, uint32_t now_us, struct lgw_pkt_tx_s *evicted, unsigned *preempted){
+	uint32_t end_us = start_us + toa_us;
+	int32_t ahead = (int32_t)(start_us - now_us);
+	unsigned i, k, nb_over = 0;
+
+	if(ahead < (int32_t)q->margin_us){
+		return JIT_TOO_LATE;
+	}
+	if(ahead > JIT_AHEAD_MAX_US){
+		return JIT_TOO_EARLY;
+	}
+	/* the packet in the concentrator cannot be taken back */
+	if(q->loaded && overlap(q, start_us, end_us, &q->last) && ((int32_t)(q->last.end_us - now_us) > 0)){
+		return (q->last.cls == JIT_BEACON) ? JIT_COLLISION_BEACON : JIT_COLLISION;
+	}
+	for(i = 0; i < q->nb; ++i){
+		if(!overlap(q, start_us, end_us, &q->slot[i])){
+			continue;
+		}
+		if(q->slot[i].cls <= cls){
+			return (q->slot[i].cls == JIT_BEACON) ? JIT_COLLISION_BEACON : JIT_COLLISION;
+		}
+		++nb_over;
+	}
+	if(q->nb - nb_over >= JIT_QUEUE_SIZE){
+		return JIT_FULL;
+	}
+
+	/* the packets of lower priority make room */
+	*preempted = nb_over;
+	if(nb_over > 0){
+		for(i = 0, k = 0, nb_over = 0; i < q->nb; ++i){
+			if(overlap(q, start_us, end_us, &q->slot[i])){
+				evicted[nb_over++] = q->pkt[q->slot[i].pkt];
+				q->free[q->nb_free++] = q->slot[i].pkt;
+			}else{
+				q->slot[k++] = q->slot[i];
+			}
+		}
+		q->nb = k;
+	}
+
+	/* insertion by start time */
+	for(i = q->nb; (i > 0) && ((int32_t)(q->slot[i - 1].start_us - start_us) > 0); --i){
+		q->slot[i] = q->slot[i - 1];
+	}
+	q->slot[i].start_us = start_us;
+	q->slot[i].end_us = end_us;
+	q->slot[i].cls = (uint8_t)cls;
+	q->slot[i].pkt = q->free[--q->nb_free];
+	q->pkt[q->slot[i].pkt] = *pkt;
+	++q->nb;
+	return JIT_OK;
+}
+
+uint32_t jit_gap(const struct jit_queue *q, uint32_t from_us, uint32_t toa_us){
+	uint32_t start_us = from_us;
+	unsigned i;
+
+	if(q->loaded && overlap(q, start_us, start_us + toa_us, &q->last)){
+		start_us = q->last.end_us + q->margin_us;
+	}
+	/* the slots are sorted and do not overlap, one pass finds the first hole */
+	for(i = 0; i < q->nb; ++i){
+		if(overlap(q, start_us, start_us + toa_us, &q->slot[i])){
+			start_us = q->slot[i].end_us + q->margin_us;
+		}
+	}
+	return start_us;
+}
+
+int32_t jit_due(const struct jit_queue *q, uint32_t now_us, uint32_t lead_us){
+	if(q->nb == 0){
+		return INT32_MAX;
+	}
+	return (int32_t)(q->slot[0].start_us - lead_us - now_us);
+}
+
+void jit_dequeue(struct jit_queue *q, struct lgw_pkt_tx_s *pkt, struct jit_slot *slot){
+	*slot = q->slot[0];
+	*pkt = q->pkt[slot->pkt];
+	q->free[q->nb_free++] = slot->pkt;
+	--q->nb;
+	memmove(&q->slot[0], &q->slot[1], q->nb * sizeof q->slot[0]);
+	q->last = *slot;
+	q->loaded = true;
+}
+
+const char *jit_error_name(enum jit_error err){
+	static const char *name[JIT_NB_ERROR] = {"ok", "too late", "too early", "collision with a beacon", "collision", "queue full"};
+	return ((unsigned)err < JIT_NB_ERROR) ? name[err] : "unknown";
+}
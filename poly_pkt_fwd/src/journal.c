@@ -0,0 +1,271 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+/* fix an issue between POSIX and C99 */
+#ifdef __MACH__
+#elif __STDC_VERSION__ >= 199901L
+	#define _XOPEN_SOURCE 600
+#else
+	#define _XOPEN_SOURCE 500
+#endif
+
+#include "journal.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* record header, followed by the datagram padded to 4 bytes, a zero length marks the end of the ring */
+struct journal_rec {
+	uint16_t			len;
+	uint8_t				readers;			/* mask of the servers the datagram is meant for */
+	uint8_t				pad;
+};
+
+#define REC_SIZE(len)	(sizeof(struct journal_rec) + (((len) + 3) & ~3u))
+
+static struct journal_rec *rec_at(const struct journal *j, uint64_t pos){
+	return (struct journal_rec *)(j->ring + (pos % j->hdr->size));
+}
+
+/* size taken by the record at pos, up to the end of the ring for the end marker */
+static uint32_t rec_span(const struct journal *j, uint64_t pos){
+	const struct journal_rec *r = rec_at(j, pos);
+	return (r->len == 0) ? (j->hdr->size - (pos % j->hdr->size)) : REC_SIZE(r->len);
+}
+
+static void hdr_reset(struct journal *j, uint32_t size){
+	memset(j->hdr, 0, sizeof *j->hdr);
+	j->hdr->magic = JOURNAL_MAGIC;
+	j->hdr->size = size;
+	j->dirty = true;
+}
+
+/* check that the records between tail and head, and the cursors, are consistent */
+static bool hdr_valid(const struct journal *j, uint32_t size){
+	const struct journal_hdr *h = j->hdr;
+	uint64_t pos;
+	uint32_t span;
+	unsigned aligned = 0; /* cursors found on a record boundary */
+	int ic;
+
+	if((h->magic != JOURNAL_MAGIC) || (h->size != size) || (h->tail > h->head) || (h->head - h->tail > size) || ((h->tail | h->head) & 3)){
+		return false;
+	}
+	for(ic = 0; ic < MAX_SERVERS; ++ic){
+		if((h->cursor[ic] < h->tail) || (h->cursor[ic] > h->head)){
+			return false;
+		}
+	}
+	for(pos = h->tail; pos < h->head; pos += span){
+		for(ic = 0; ic < MAX_SERVERS; ++ic){
+			if(h->cursor[ic] == pos) aligned |= 1 << ic;
+		}
+		span = rec_span(j, pos);
+		if(span > size - (pos % size)){
+			return false;
+		}
+	}
+	for(ic = 0; ic < MAX_SERVERS; ++ic){
+		if(h->cursor[ic] == h->head) aligned |= 1 << ic;
+	}
+	return (pos == h->head) && (aligned == (1u << MAX_SERVERS) - 1);
+}
+
+uint32_t journal_server_id(const char *addr, const char *port){
+	uint32_t h = 2166136261u; /* FNV-1a */
+	const char *s;
+
+	for(s = addr; *s != 0; ++s){
+		h = (h ^ (uint8_t)*s) * 16777619u;
+	}
+	h = (h ^ ':') * 16777619u;
+	for(s = port; *s != 0; ++s){
+		h = (h ^ (uint8_t)*s) * 16777619u;
+	}
+	return h;
+}
+
+int journal_open(struct journal *j, const char *path, uint32_t size, int nb_reader, const uint32_t *server_id){
+	long page = sysconf(_SC_PAGESIZE);
+	struct stat st;
+	void *map;
+	int ic;
+
+	size -= size % page;
+	if(size < JOURNAL_MIN_SIZE){
+		return -1;
+	}
+	j->map_len = page + size;
+	j->fd = open(path, O_RDWR | O_CREAT, 0644);
+	if(j->fd < 0){
+		return -1;
+	}
+	if((fstat(j->fd, &st) != 0) || (((size_t)st.st_size != j->map_len) && (ftruncate(j->fd, j->map_len) != 0))){
+		close(j->fd);
+		return -1;
+	}
+	map = mmap(NULL, j->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, j->fd, 0);
+	if(map == MAP_FAILED){
+		close(j->fd);
+		return -1;
+	}
+	j->hdr = map;
+	j->ring = (uint8_t *)map + page;
+	j->nb_reader = nb_reader;
+	j->moved = 0;
+	j->dirty = false;
+
+	if(((size_t)st.st_size == j->map_len) && hdr_valid(j, size)){
+		/* cursors not used by the previous run, or recorded for another server, start after the last record */
+		for(ic = 0; ic < MAX_SERVERS; ++ic){
+			if((ic < nb_reader) && (j->hdr->server[ic] == server_id[ic])){
+				continue;
+			}
+			if((ic < nb_reader) && (j->hdr->cursor[ic] != j->hdr->head)){
+				j->moved |= 1 << ic;
+			}
+			j->hdr->cursor[ic] = j->hdr->head;
+			j->hdr->server[ic] = (ic < nb_reader) ? server_id[ic] : 0;
+			j->dirty = true;
+		}
+		return 1;
+	}
+	hdr_reset(j, size);
+	for(ic = 0; ic < nb_reader; ++ic){
+		j->hdr->server[ic] = server_id[ic];
+	}
+	return 0;
+}
+
+void journal_close(struct journal *j){
+	journal_sync(j);
+	munmap(j->hdr, j->map_len);
+	close(j->fd);
+}
+
+/* drop the oldest record, moving the cursors still on it */
+static bool evict(struct journal *j){
+	struct journal_hdr *h = j->hdr;
+	uint32_t span = rec_span(j, h->tail);
+	bool unread = false;
+	int ic;
+
+	for(ic = 0; ic < MAX_SERVERS; ++ic){
+		if(h->cursor[ic] == h->tail){
+			h->cursor[ic] += span;
+			unread = unread || ((ic < j->nb_reader) && (rec_at(j, h->tail)->readers & (1 << ic)));
+		}
+	}
+	unread = unread && (rec_at(j, h->tail)->len != 0);
+	h->tail += span;
+	return unread;
+}
+
+int64_t journal_append(struct journal *j, uint8_t readers, const uint8_t *buf, uint16_t len, unsigned *lost){
+	struct journal_hdr *h = j->hdr;
+	uint32_t need = REC_SIZE(len);
+	uint32_t room = h->size - (h->head % h->size); /* contiguous space up to the end of the ring */
+	struct journal_rec *r;
+	int64_t pos;
+
+	*lost = 0;
+	if((len == 0) || (need > h->size / 2)){
+		return -1;
+	}
+	/* records are not split, skip the end of the ring if too short */
+	if(room < need){
+		while(h->head + room - h->tail > h->size){
+			*lost += evict(j);
+		}
+		rec_at(j, h->head)->len = 0;
+		h->head += room;
+	}
+	while(h->head + need - h->tail > h->size){
+		*lost += evict(j);
+	}
+	pos = (int64_t)h->head;
+	r = rec_at(j, h->head);
+	r->len = len;
+	r->readers = readers;
+	r->pad = 0;
+	memcpy(r + 1, buf, len);
+	__atomic_signal_fence(__ATOMIC_RELEASE);
+	h->head += need; /* after the record, so that an interrupted write is not seen */
+	j->dirty = true;
+	return pos;
+}
+
+uint8_t *journal_peek(struct journal *j, int ic, uint16_t *len){
+	struct journal_hdr *h = j->hdr;
+	struct journal_rec *r;
+
+	while(h->cursor[ic] < h->head){
+		r = rec_at(j, h->cursor[ic]);
+		if((r->len != 0) && (r->readers & (1 << ic))){
+			*len = r->len;
+			return (uint8_t *)(r + 1);
+		}
+		h->cursor[ic] += rec_span(j, h->cursor[ic]);
+		j->dirty = true;
+	}
+	return NULL;
+}
+
+void journal_next(struct journal *j, int ic){
+	struct journal_hdr *h = j->hdr;
+
+	if(h->cursor[ic] < h->head){
+		h->cursor[ic] += rec_span(j, h->cursor[ic]);
+		j->dirty = true;
+	}
+}
+
+uint64_t journal_pos(const struct journal *j, int ic){
+	return j->hdr->cursor[ic];
+}
+
+void journal_rewind(struct journal *j, int ic, uint64_t pos){
+	struct journal_hdr *h = j->hdr;
+
+	if(pos < h->tail){
+		pos = h->tail; /* the records have been overwritten meanwhile */
+	}
+	if(pos < h->cursor[ic]){
+		h->cursor[ic] = pos;
+		j->dirty = true;
+	}
+}
+
+void journal_skip(struct journal *j, int ic){
+	j->hdr->cursor[ic] = j->hdr->head;
+	j->dirty = true;
+}
+
+void journal_sync(struct journal *j){
+	if(j->dirty){
+		/* only the dirty pages are written */
+		msync(j->hdr, j->map_len, MS_SYNC);
+		j->dirty = false;
+	}
+}
@@ -0,0 +1,197 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+#include "linkq.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t home(const struct linkq *t, uint32_t devaddr){
+	devaddr ^= devaddr >> 16;
+	devaddr *= 0x45D9F3Bu;
+	devaddr ^= devaddr >> 16;
+	return devaddr & t->mask;
+}
+
+/* slot of the device, or of the free slot ending its probe sequence */
+static uint32_t find(const struct linkq *t, uint32_t devaddr){
+	uint32_t i = home(t, devaddr);
+
+	while((t->slot[i] != LINKQ_NONE) && (t->dev[t->slot[i]].devaddr != devaddr)){
+		i = (i + 1) & t->mask;
+	}
+	return i;
+}
+
+/* empty slot i, moving back the following entries so that no probe sequence is broken */
+static void slot_remove(struct linkq *t, uint32_t i){
+	uint32_t j = i, k;
+
+	for(;;){
+		t->slot[i] = LINKQ_NONE;
+		for(;;){
+			j = (j + 1) & t->mask;
+			if(t->slot[j] == LINKQ_NONE){
+				return;
+			}
+			k = home(t, t->dev[t->slot[j]].devaddr);
+			/* the entry moves to the hole unless its home is cyclically in ]i, j] */
+			if((i <= j) ? ((i >= k) || (k > j)) : ((i >= k) && (k > j))){
+				break;
+			}
+		}
+		t->slot[i] = t->slot[j];
+		i = j;
+	}
+}
+
+static void lru_unlink(struct linkq *t, uint32_t n){
+	struct linkq_dev *d = &t->dev[n];
+
+	if(d->prev != LINKQ_NONE) t->dev[d->prev].next = d->next; else t->head = d->next;
+	if(d->next != LINKQ_NONE) t->dev[d->next].prev = d->prev; else t->tail = d->prev;
+}
+
+static void lru_push(struct linkq *t, uint32_t n){
+	struct linkq_dev *d = &t->dev[n];
+
+	d->prev = LINKQ_NONE;
+	d->next = t->head;
+	if(t->head != LINKQ_NONE) t->dev[t->head].prev = n; else t->tail = n;
+	t->head = n;
+}
+
+int linkq_init(struct linkq *t, uint32_t capacity){
+	uint32_t nb_slot = 2;
+
+	memset(t, 0, sizeof *t);
+	while(nb_slot < 2 * capacity){
+		nb_slot <<= 1;
+	}
+	t->slot = malloc(nb_slot * sizeof *t->slot);
+	t->dev = malloc(capacity * sizeof *t->dev);
+	if((t->slot == NULL) || (t->dev == NULL)){
+		linkq_free(t);
+		return -1;
+	}
+	memset(t->slot, 0xFF, nb_slot * sizeof *t->slot);
+	t->capacity = capacity;
+	t->mask = nb_slot - 1;
+	t->head = t->tail = LINKQ_NONE;
+	return 0;
+}
+
+void linkq_free(struct linkq *t){
+	free(t->slot);
+	free(t->dev);
+	t->slot = NULL;
+	t->dev = NULL;
+	t->capacity = 0;
+}
+
+void linkq_update(struct linkq *t, uint32_t devaddr, uint16_t fcnt, int sf, float rssi, float snr){
+	struct linkq_dev *d;
+	struct linkq_sf *s;
+	uint32_t i, n;
+	uint16_t gap;
+
+	if(t->capacity == 0){
+		return;
+	}
+	i = find(t, devaddr);
+	if(t->slot[i] != LINKQ_NONE){
+		n = t->slot[i];
+		d = &t->dev[n];
+		gap = fcnt - d->fcnt;
+		if(gap == 0){
+			++d->nb_repeat;
+		}else{
+			if(gap <= LINKQ_GAP_MAX){
+				d->nb_lost += gap - 1;
+				t->nb_lost += gap - 1;
+			}
+			d->fcnt = fcnt;
+			++d->nb_rx;
+			++t->nb_rx;
+		}
+		lru_unlink(t, n);
+	}else{
+		if(t->nb_dev < t->capacity){
+			n = t->nb_dev++;
+		}else{
+			/* the least recently heard device makes room */
+			n = t->tail;
+			d = &t->dev[n];
+			t->nb_rx -= d->nb_rx;
+			t->nb_lost -= d->nb_lost;
+			++t->nb_evicted;
+			lru_unlink(t, n);
+			slot_remove(t, find(t, d->devaddr));
+			i = find(t, devaddr);
+		}
+		t->slot[i] = n;
+		d = &t->dev[n];
+		memset(d, 0, sizeof *d);
+		d->devaddr = devaddr;
+		d->fcnt = fcnt;
+		d->nb_rx = 1;
+		++t->nb_rx;
+	}
+	lru_push(t, n);
+
+	if((sf >= LINKQ_SF_MIN) && (sf < LINKQ_SF_MIN + LINKQ_NB_SF)){
+		s = &d->sf[sf - LINKQ_SF_MIN];
+		if(s->nb == 0){
+			s->rssi = rssi;
+			s->snr = snr;
+		}else{
+			s->rssi += LINKQ_EWMA_ALPHA * (rssi - s->rssi);
+			s->snr += LINKQ_EWMA_ALPHA * (snr - s->snr);
+		}
+		++s->nb;
+	}
+}
+
+float linkq_loss(const struct linkq_dev *d){
+	return (float)d->nb_lost / (float)(d->nb_lost + d->nb_rx);
+}
+
+int linkq_worst(const struct linkq *t, struct linkq_dev *worst, int n, uint32_t min_rx){
+	uint32_t i;
+	int k, nb = 0;
+	float loss;
+
+	for(i = 0; i < t->nb_dev; ++i){
+		if((t->dev[i].nb_rx < min_rx) || (t->dev[i].nb_lost == 0)){
+			continue;
+		}
+		loss = linkq_loss(&t->dev[i]);
+		/* insertion in the sorted selection */
+		for(k = nb; (k > 0) && (linkq_loss(&worst[k - 1]) < loss); --k){
+			if(k < n) worst[k] = worst[k - 1];
+		}
+		if(k < n){
+			worst[k] = t->dev[i];
+			if(nb < n) ++nb;
+		}
+	}
+	return nb;
+}
@@ -0,0 +1,115 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+#include "lorawan.h"
+#include <stdio.h>
+
+static uint64_t get_le(const uint8_t *b, int n){
+	uint64_t v = 0;
+
+	while(n-- > 0){
+		v = (v << 8) | b[n];
+	}
+	return v;
+}
+
+int lw_parse(const uint8_t *payload, uint16_t size, struct lw_frame *f){
+	int fopts_len;
+
+	if(size < 1){
+		return -1;
+	}
+	f->mtype = payload[0] >> 5;
+	f->major = payload[0] & 0x03;
+	f->fport = -1;
+	if(f->major != 0){
+		return -1;
+	}
+	switch(f->mtype){
+		case LW_JOIN_REQUEST:
+			if(size != 1 + 8 + 8 + 2 + LW_MIC_SIZE){
+				return -1;
+			}
+			f->join_eui = get_le(payload + 1, 8);
+			f->dev_eui = get_le(payload + 9, 8);
+			f->dev_nonce = (uint16_t)get_le(payload + 17, 2);
+			return 0;
+		case LW_UNCONF_UP:
+		case LW_UNCONF_DOWN:
+		case LW_CONF_UP:
+		case LW_CONF_DOWN:
+			if(size < 1 + 7 + LW_MIC_SIZE){
+				return -1;
+			}
+			f->devaddr = (uint32_t)get_le(payload + 1, 4);
+			f->fctrl = payload[5];
+			f->fcnt = (uint16_t)get_le(payload + 6, 2);
+			fopts_len = f->fctrl & 0x0F;
+			if(size < 1 + 7 + fopts_len + LW_MIC_SIZE){
+				return -1;
+			}
+			if(size > 1 + 7 + fopts_len + LW_MIC_SIZE){
+				f->fport = payload[8 + fopts_len];
+			}
+			return 0;
+		default:
+			return 0; /* join-accept and rejoin are encrypted or not needed, proprietary is opaque */
+	}
+}
+
+bool lw_is_data(const struct lw_frame *f){
+	return (f->mtype >= LW_UNCONF_UP) && (f->mtype <= LW_CONF_DOWN);
+}
+
+int lw_netid_prefix(uint32_t netid, uint32_t *prefix, int *bits){
+	static const int nwkid_bits[8] = {6, 6, 9, 11, 12, 13, 15, 17}; /* per NetID type */
+	int type = (netid >> 21) & 0x07;
+	uint32_t nwkid;
+
+	if(netid > 0xFFFFFF){
+		return -1;
+	}
+	nwkid = netid & ((1u << nwkid_bits[type]) - 1);
+	*bits = type + 1 + nwkid_bits[type];
+	/* type prefix: type ones followed by a zero, then the NwkID */
+	*prefix = ((0xFEu << (7 - type)) & 0xFF) << 24;
+	*prefix |= nwkid << (32 - *bits);
+	return 0;
+}
+
+const char *lw_mtype_name(uint8_t mtype){
+	static const char *name[8] = {"JoinRequest", "JoinAccept", "UnconfirmedDataUp", "UnconfirmedDataDown", "ConfirmedDataUp", "ConfirmedDataDown", "RejoinRequest", "Proprietary"};
+	return name[mtype & 0x07];
+}
+
+int lw_json_fields(const struct lw_frame *f, char *buf, int size){
+	int n;
+
+	if(lw_is_data(f)){
+		n = snprintf(buf, size, ",\"mtype\":\"%s\",\"devaddr\":\"%08X\",\"fcnt\":%u", lw_mtype_name(f->mtype), f->devaddr, f->fcnt);
+	}else if(f->mtype == LW_JOIN_REQUEST){
+		n = snprintf(buf, size, ",\"mtype\":\"%s\",\"joineui\":\"%016llX\",\"deveui\":\"%016llX\"", lw_mtype_name(f->mtype), (unsigned long long)f->join_eui, (unsigned long long)f->dev_eui);
+	}else{
+		n = snprintf(buf, size, ",\"mtype\":\"%s\"", lw_mtype_name(f->mtype));
+	}
+	return ((n < 0) || (n >= size)) ? -1 : n;
+}
@@ -0,0 +1,104 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+#include "meas.h"
+#include <sched.h>
+
+struct meas_block meas_blocks[MEAS_BLOCK_NB];
+
+void meas_begin(struct meas_block *b){
+	__atomic_store_n(&b->seq, b->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void meas_add(struct meas_block *b, enum meas_id id, uint32_t n){
+	/* single writer, no read-modify-write needed */
+	__atomic_store_n(&b->val[id], b->val[id] + n, __ATOMIC_RELAXED);
+}
+
+void meas_end(struct meas_block *b){
+	__atomic_store_n(&b->seq, b->seq + 1, __ATOMIC_RELEASE);
+}
+
+void meas_snapshot(struct meas_snap *snap){
+	struct meas_snap blk;
+	unsigned seq;
+	int i, j;
+
+	for(j = 0; j < MEAS_NB; ++j){
+		snap->val[j] = 0;
+	}
+	for(i = 0; i < MEAS_BLOCK_NB; ++i){
+		for(;;){
+			seq = __atomic_load_n(&meas_blocks[i].seq, __ATOMIC_ACQUIRE);
+			if(seq & 1){
+				sched_yield(); /* the owner is in the middle of an update */
+				continue;
+			}
+			for(j = 0; j < MEAS_NB; ++j){
+				blk.val[j] = __atomic_load_n(&meas_blocks[i].val[j], __ATOMIC_RELAXED);
+			}
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if(__atomic_load_n(&meas_blocks[i].seq, __ATOMIC_RELAXED) == seq){
+				break;
+			}
+		}
+		for(j = 0; j < MEAS_NB; ++j){
+			snap->val[j] += blk.val[j];
+		}
+	}
+}
+
+void meas_delta(const struct meas_snap *now, const struct meas_snap *prev, struct meas_snap *delta){
+	int j;
+
+	for(j = 0; j < MEAS_NB; ++j){
+		delta->val[j] = now->val[j] - prev->val[j]; /* modulo 2^32, wrap-around safe */
+	}
+}
+
+int meas_hist_bin(uint32_t v, int nb_bin){
+	int i = 0;
+
+	while((i < nb_bin - 1) && (v >= (1u << i))){
+		++i;
+	}
+	return i;
+}
+
+int meas_hist_pct(const uint32_t *hist, int nb_bin, unsigned pct){
+	uint32_t total = 0, sum = 0;
+	int i;
+
+	for(i = 0; i < nb_bin; ++i){
+		total += hist[i];
+	}
+	if(total == 0){
+		return -1;
+	}
+	for(i = 0; i < nb_bin - 1; ++i){
+		sum += hist[i];
+		if((uint64_t)sum * 100 >= (uint64_t)total * pct){
+			break;
+		}
+	}
+	return i;
+}
@@ -39,9 +39,13 @@
 #define skip_whitespaces(str) while (isspace(**str)) { skip_char(str); }
 #define MAX(a, b)             ((a) > (b) ? (a) : (b))
 
-#define parson_malloc(a)     malloc(a)
-#define parson_free(a)       free((void*)a)
-#define parson_realloc(a, b) realloc(a, b)
+#define parson_malloc(a)     parson_malloc_fun(a)
+#define parson_free(a)       parson_free_fun((void*)a)
+#define parson_realloc(a, b) parson_realloc_fun(a, b)
+
+static JSON_Malloc_Function  parson_malloc_fun  = malloc;
+static JSON_Free_Function    parson_free_fun    = free;
+static JSON_Realloc_Function parson_realloc_fun = realloc;
 
 /* Type definitions */
 typedef union json_value_value {
@@ -780,3 +784,9 @@ void json_value_free(JSON_Value *value) {
     }
     parson_free(value);
 }
+
+void json_set_allocation_functions(JSON_Malloc_Function malloc_fun, JSON_Free_Function free_fun, JSON_Realloc_Function realloc_fun) {
+    parson_malloc_fun = malloc_fun;
+    parson_free_fun = free_fun;
+    parson_realloc_fun = realloc_fun;
+}
@@ -0,0 +1,89 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+/* fix an issue between POSIX and C99 */
+#ifdef __MACH__
+#elif __STDC_VERSION__ >= 199901L
+	#define _XOPEN_SOURCE 600
+#else
+	#define _XOPEN_SOURCE 500
+#endif
+
+#include "pmtu.h"
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+static int sock_family(int sock){
+	struct sockaddr_storage addr;
+	socklen_t len = sizeof addr;
+
+	if(getsockname(sock, (struct sockaddr *)&addr, &len) != 0){
+		return -1;
+	}
+	return addr.ss_family;
+}
+
+int pmtu_enable(int sock){
+#if defined(IP_MTU_DISCOVER) && defined(IPV6_MTU_DISCOVER)
+	/* DF is set but the kernel still fragments above the path MTU it learned, nothing is refused */
+	int v4 = IP_PMTUDISC_WANT, v6 = IPV6_PMTUDISC_WANT;
+
+	switch(sock_family(sock)){
+		case AF_INET:
+			return setsockopt(sock, IPPROTO_IP, IP_MTU_DISCOVER, &v4, sizeof v4);
+		case AF_INET6:
+			return setsockopt(sock, IPPROTO_IPV6, IPV6_MTU_DISCOVER, &v6, sizeof v6);
+		default:
+			errno = EAFNOSUPPORT;
+			return -1;
+	}
+#else
+	(void)sock;
+	errno = ENOPROTOOPT;
+	return -1;
+#endif
+}
+
+int pmtu_payload(int sock){
+#if defined(IP_MTU) && defined(IPV6_MTU)
+	int mtu;
+	socklen_t len = sizeof mtu;
+
+	switch(sock_family(sock)){
+		case AF_INET:
+			if(getsockopt(sock, IPPROTO_IP, IP_MTU, &mtu, &len) == 0){
+				return mtu - PMTU_UDP4_OVERHEAD;
+			}
+			break;
+		case AF_INET6:
+			if(getsockopt(sock, IPPROTO_IPV6, IPV6_MTU, &mtu, &len) == 0){
+				return mtu - PMTU_UDP6_OVERHEAD;
+			}
+			break;
+	}
+#else
+	(void)sock;
+#endif
+	return -1;
+}
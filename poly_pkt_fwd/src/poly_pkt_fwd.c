@@ -43,7 +43,6 @@ Maintainer: Ruud Vlaming
 #include <unistd.h>		/* getopt, access */
 #include <stdlib.h>		/* atoi, exit */
 #include <errno.h>		/* error messages */
-#include <math.h>		/* modf */
 
 #include <sys/socket.h> /* socket specific definitions */
 #include <netinet/in.h> /* INET constants and stuff */
@@ -51,9 +50,14 @@ Maintainer: Ruud Vlaming
 #include <netdb.h>		/* gai_strerror */
 
 #include <pthread.h>
+#include <poll.h>			/* poll */
 
 #include "parson.h"
 #include "base64.h"
+#include "rxpk.h"
+#include "binpk.h"
+#include "txpk.h"
+#include "isotime.h"
 
 #include "loragw_hal.h"
 #include "loragw_gps.h"
@@ -66,6 +70,20 @@ Maintainer: Ruud Vlaming
 #include "utils.h"
 #include "conf.h"
 #include "server.h"
+#include "ring.h"
+#include "inflight.h"
+#include "txbatch.h"
+#include "meas.h"
+#include "journal.h"
+#include "dedup.h"
+#include "lorawan.h"
+#include "filter.h"
+#include "pmtu.h"
+#include "linkq.h"
+#include "airtime.h"
+#include "jit.h"
+#include "duty.h"
+#include "arena.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
@@ -92,15 +110,67 @@ Maintainer: Ruud Vlaming
 #define PKT_PULL_RESP	3
 #define PKT_PULL_ACK	4
 
-#define NB_PKT_MAX		8 /* max number of packets per fetch/send cycle */
-
 #define MIN_LORA_PREAMB	6 /* minimum Lora preamble length for this application */
 #define STD_LORA_PREAMB	8
 #define MIN_FSK_PREAMB	3 /* minimum FSK preamble length for this application */
 #define STD_FSK_PREAMB	4
 
-#define STATUS_SIZE		328
-#define TX_BUFF_SIZE	((540 * NB_PKT_MAX) + 30 + STATUS_SIZE)
+#define STATUS_SIZE		512	/* stat object with GPS, the longest pfrm, mail and desc, the link and occupancy fields: 492 bytes */
+
+#define JOURNAL_NO_PROBE	UINT64_MAX	/* no probe sent to a server in outage */
+#define TX_BUFF_SIZE	(((RXPK_MAX_SIZE + LW_JSON_MAX) * NB_PKT_MAX) + 30 + STATUS_SIZE)
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE TYPES -------------------------------------------------------- */
+
+/* outcome of loading a downlink in the concentrator */
+enum load_result {
+	LOAD_OK = 0,
+	LOAD_FAIL,							/* refused by the HAL */
+	LOAD_BUSY,							/* the previous packet has not left the concentrator */
+	LOAD_LATE							/* starts too soon to be loaded */
+};
+
+/* PUSH_DATA datagram being composed, in each encoding used by at least one server */
+struct push_dgram {
+	bool			use_json;				/* at least one server uses the JSON encoding */
+	bool			use_bin;				/* at least one server uses the binary encoding */
+	bool			enrich;					/* the rxpk objects carry the LoRaWAN header fields, for some servers */
+	uint8_t			json[TX_BUFF_SIZE];
+	int				json_len;
+	uint8_t			bin[TX_BUFF_SIZE];
+	int				bin_len;
+	unsigned		nb_pkt;					/* nb of packets in the datagram */
+	struct binpk_rx	prev;					/* last binary record, for the delta encoding of the radio settings */
+	struct isotime_cache time_cache;		/* last "time" field written */
+	/* routing of the packets, the servers receiving only some of them get a spliced copy */
+	uint8_t			route[BINPK_UP_COUNT_MAX];	/* mask of the servers each packet is routed to */
+	uint8_t			route_all;				/* servers receiving all the packets */
+	uint8_t			route_any;				/* servers receiving at least one packet */
+	bool			report;					/* the status report is attached */
+	int				json_frag[BINPK_UP_COUNT_MAX + 1];	/* offset of the rxpk object of each packet, then end of the array */
+	int				json_enr[BINPK_UP_COUNT_MAX];	/* offset of the header fields in each rxpk object, or of its closing brace */
+	int				json_stat;				/* offset of the stat object */
+	int				bin_rec;				/* offset of the first rxpk record */
+	int				bin_stat;				/* offset of the stat record */
+	uint8_t			split[MAX_SERVERS][TX_BUFF_SIZE];
+	const uint8_t	*out[MAX_SERVERS];		/* datagram for each server, NULL if none */
+	int				out_len[MAX_SERVERS];
+};
+
+/* delivery of the journaled datagrams to one server */
+struct journal_link {
+	bool			live;					/* caught up, new datagrams are sent as soon as journaled */
+	bool			outage;					/* no PUSH_ACK for journal_outage_ms, only probes are sent */
+	bool			unacked;				/* datagrams were sent since the last PUSH_ACK */
+	uint64_t		unacked_pos;			/* journal position of the first of them */
+	struct timespec	unacked_since;
+	uint32_t		ack_nb;					/* PUSH_ACK count at the last check */
+	struct timespec	last_check;
+	struct timespec	last_send;
+	float			credit;					/* nb of datagrams that may be replayed now */
+	uint64_t		probe_pos;				/* journal position of the probe sent during the outage, JOURNAL_NO_PROBE if none */
+};
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE VARIABLES (GLOBAL) ------------------------------------------- */
@@ -108,6 +178,7 @@ Maintainer: Ruud Vlaming
 /* signal handling variables */
 volatile bool exit_sig = false; /* 1 -> application terminates cleanly (shut down hardware, close open files, etc) */
 volatile bool quit_sig = false; /* 1 -> application terminates without shutting down the hardware */
+volatile bool reload_sig = false; /* 1 -> the network filter file must be reloaded */
 
 /* gateway <-> MAC protocol variables */
 static uint32_t net_mac_h; /* Most Significant Nibble, network order */
@@ -123,32 +194,30 @@ static pthread_mutex_t mx_xcorr = PTHREAD_MUTEX_INITIALIZER; /* control access t
 static bool xtal_correct_ok = false; /* set true when XTAL correction is stable enough */
 static double xtal_correct = 1.0;
 
+/* concentrator counter dated with the monotonic clock, from the latest packet received over the air */
+static pthread_mutex_t mx_cntref = PTHREAD_MUTEX_INITIALIZER; /* control access to the counter reference */
+static bool cnt_ref_valid = false;
+static uint32_t cnt_ref_count; /* counter value of the packet */
+static struct timespec cnt_ref_time; /* monotonic time at which it was fetched */
+
+/* downlinks waiting for their turn, see jit.h */
+static pthread_mutex_t mx_jit = PTHREAD_MUTEX_INITIALIZER; /* control access to the JIT queue */
+static pthread_cond_t cv_jit = PTHREAD_COND_INITIALIZER; /* signals a new packet to the dispatcher */
+static struct jit_queue jit_queue;
+
+/* airtime of the downlinks per sub-band, see duty.h, gtw_conf.duty_cycle is NULL without limits */
+static pthread_mutex_t mx_duty = PTHREAD_MUTEX_INITIALIZER; /* control access to the airtime accountant */
+
+/* memory the JSON is parsed in, see arena.h, the configuration one only lives while the files are loaded */
+static struct arena conf_arena;
+static struct arena down_arena[MAX_SERVERS]; /* one per downstream thread, emptied after each PULL_RESP */
+
 /* GPS time reference */
 static pthread_mutex_t mx_timeref = PTHREAD_MUTEX_INITIALIZER; /* control access to GPS time reference */
 static bool gps_ref_valid; /* is GPS reference acceptable (ie. not too old) */
 static struct tref time_reference_gps; /* time reference used for UTC <-> timestamp conversion */
 
-/* measurements to establish statistics */
-static pthread_mutex_t mx_meas_up = PTHREAD_MUTEX_INITIALIZER; /* control access to the upstream measurements */
-static uint32_t meas_nb_rx_rcv = 0; /* count packets received */
-static uint32_t meas_nb_rx_ok = 0; /* count packets received with PAYLOAD CRC OK */
-static uint32_t meas_nb_rx_bad = 0; /* count packets received with PAYLOAD CRC ERROR */
-static uint32_t meas_nb_rx_nocrc = 0; /* count packets received with NO PAYLOAD CRC */
-static uint32_t meas_up_pkt_fwd = 0; /* number of radio packet forwarded to the server */
-static uint32_t meas_up_network_byte = 0; /* sum of UDP bytes sent for upstream traffic */
-static uint32_t meas_up_payload_byte = 0; /* sum of radio payload bytes sent for upstream traffic */
-static uint32_t meas_up_dgram_sent = 0; /* number of datagrams sent for upstream traffic */
-static uint32_t meas_up_ack_rcv = 0; /* number of datagrams acknowledged for upstream traffic */
-
-static pthread_mutex_t mx_meas_dw = PTHREAD_MUTEX_INITIALIZER; /* control access to the downstream measurements */
-static uint32_t meas_dw_pull_sent = 0; /* number of PULL requests sent for downstream traffic */
-static uint32_t meas_dw_ack_rcv = 0; /* number of PULL requests acknowledged for downstream traffic */
-static uint32_t meas_dw_dgram_rcv = 0; /* count PULL response packets received for downstream traffic */
-static uint32_t meas_dw_network_byte = 0; /* sum of UDP bytes sent for upstream traffic */
-static uint32_t meas_dw_payload_byte = 0; /* sum of radio payload bytes sent for upstream traffic */
-static uint32_t meas_nb_tx_ok = 0; /* count packets emitted successfully */
-static uint32_t meas_nb_tx_fail = 0; /* count packets were TX failed for other reasons */
-
+/* measurements to establish statistics, see meas.h for the upstream and downstream counters */
 static pthread_mutex_t mx_meas_gps = PTHREAD_MUTEX_INITIALIZER; /* control access to the GPS statistics */
 static bool gps_coord_valid; /* could we get valid GPS coordinates ? */
 static struct coord_s meas_gps_coord; /* GPS position of the gateway */
@@ -161,6 +230,37 @@ static char status_report[STATUS_SIZE]; /* status report as a JSON object */
 struct gateway_conf gtw_conf = GATEWAY_CONF_INITIALIZER;
 struct servers servers;
 
+/* batches of packets fetched by the fetch thread, waiting for the upstream thread */
+static struct rx_ring rx_ring;
+
+/* uplinks recently forwarded, only used by the upstream thread */
+static struct dedup rx_dedup;
+
+/* payloads recently fetched, to spot the copies when shedding, only used by the fetch thread */
+static uint32_t shed_recent[SHED_RECENT];
+static unsigned shed_recent_idx;
+
+/* LoRaWAN network filter, replaced by the main thread on reload */
+static pthread_mutex_t mx_filter = PTHREAD_MUTEX_INITIALIZER; /* control access to the filter */
+
+/* link quality of the devices, updated by the upstream thread and reported by the main one */
+static struct linkq link_table;
+static pthread_mutex_t mx_linkq = PTHREAD_MUTEX_INITIALIZER; /* control access to the link table */
+static struct lw_filter *rx_filter;
+
+/* largest datagram reaching each server unfragmented, -1 if unknown, only used by the upstream thread */
+static int push_pmtu[MAX_SERVERS];
+
+/* PUSH_DATA datagrams waiting for their PUSH_ACK, per server */
+static struct inflight push_inflight[MAX_SERVERS];
+static uint32_t push_ack_nb[MAX_SERVERS]; /* PUSH_ACK received, written by the ACK threads */
+
+/* store-and-forward journal of the PUSH_DATA datagrams, only used by the upstream thread */
+static bool journal_on;
+static struct journal push_journal;
+static struct journal_link journal_links[MAX_SERVERS];
+static struct timespec journal_last_sync;
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DECLARATION ---------------------------------------- */
 
@@ -170,13 +270,49 @@ struct servers servers;
 
 static void sig_handler(int sigio);
 
+static int rx_to_binpk(const struct lgw_pkt_rx_s *p, const struct timespec *utc, struct binpk_rx *rx);
+static void push_data_init(struct push_dgram *d);
+static void push_data_open(struct push_dgram *d, uint16_t token);
+static bool push_data_room(const struct push_dgram *d, unsigned size, int max_len);
+static void push_data_add(struct push_dgram *d, const struct lgw_pkt_rx_s *p, const struct timespec *utc, const struct lw_frame *f, uint8_t route);
+static bool push_data_close(struct push_dgram *d, int max_len);
+static void push_data_split(struct push_dgram *d);
+static int push_data_splice(const struct push_dgram *d, int ic, uint8_t *out);
+static void push_data_send(const struct push_dgram *d, uint16_t token, bool *started, const bool *held, unsigned nb_merged);
+static void hist_format(const uint32_t *hist, int nb_bin, unsigned pct, char *str);
+static void dedup_batch(const struct rx_batch *batch, bool *dup);
+static int shed_class(const struct lgw_pkt_rx_s *p);
+static int shed_batch(struct lgw_pkt_rx_s *pkt, int nb_pkt, unsigned depth, uint32_t *shed);
+static void lw_parse_batch(const struct rx_batch *batch, struct lw_frame *frame, bool *valid);
+static void filter_batch(const struct rx_batch *batch, const struct lw_frame *frame, const bool *valid, enum filter_verdict *verdict);
+static void filter_reload(void);
+static void parse_configuration(const char *path);
+static void link_batch(const struct rx_batch *batch, const struct lw_frame *frame, const bool *valid, const bool *dup, const enum filter_verdict *verdict);
+static uint8_t route_packet(const struct lw_frame *f);
+static void push_data_forward(const struct push_dgram *d, uint16_t token, bool *started, unsigned nb_merged);
+static int push_size_limit(const bool *started);
+static void push_journal_open(void);
+static void push_journal_add(const struct push_dgram *d, uint16_t token, bool *started, unsigned nb_merged);
+static void push_journal_drain(uint16_t *token, bool *started);
+static int utc_to_count(const struct timespec *utc, uint32_t *count_us);
+static int parse_txpk_tree(const char *json, struct lgw_pkt_tx_s *txpkt);
+static int parse_txpk_json(const char *json, int len, struct lgw_pkt_tx_s *txpkt);
+static int parse_txpk_fields(const struct binpk_tx *tx, struct lgw_pkt_tx_s *txpkt);
+static int parse_txpk_bin(const uint8_t *body, int len, struct lgw_pkt_tx_s *txpkt);
+static void cnt_ref_update(uint32_t count_us, const struct timespec *since);
+static bool cnt_now(uint32_t *count_us);
+static enum jit_error downlink_queue(struct lgw_pkt_tx_s *pkt, enum jit_class cls, unsigned *preempted);
+static enum load_result downlink_load(const struct lgw_pkt_tx_s *pkt);
 
 
 /* threads */
+void *thread_fetch(void *arg);
 void thread_up(void);
+void *thread_ack(void *pic);
 void thread_down(void* pic);
 void thread_gps(void);
 void thread_valid(void);
+void *thread_jit(void *arg);
 void thread_connect(void *pic);
 
 /* -------------------------------------------------------------------------- */
@@ -187,6 +323,8 @@ static void sig_handler(int sigio) {
 		quit_sig = true;;
 	} else if ((sigio == SIGINT) || (sigio == SIGTERM)) {
 		exit_sig = true;
+	} else if (sigio == SIGHUP) {
+		reload_sig = true;
 	}
 	return;
 }
@@ -202,6 +340,1284 @@ void display_usage(){
     exit(EXIT_FAILURE);
 }
 
+/* convert the metadata of a received packet to the units of the binary encoding */
+static int rx_to_binpk(const struct lgw_pkt_rx_s *p, const struct timespec *utc, struct binpk_rx *rx) {
+	rx->tmst = p->count_us;
+	rx->has_time = (utc != NULL);
+	if (utc != NULL) {
+		rx->time_us = ((uint64_t)utc->tv_sec * 1000000) + (utc->tv_nsec / 1000);
+	}
+	rx->freq_hz = p->freq_hz;
+	rx->chan = p->if_chain;
+	rx->rfch = p->rf_chain;
+	if (p->modulation == MOD_LORA) {
+		rx->modu = BINPK_LORA;
+		switch (p->datarate) {
+			case DR_LORA_SF7:  rx->sf = 7;  break;
+			case DR_LORA_SF8:  rx->sf = 8;  break;
+			case DR_LORA_SF9:  rx->sf = 9;  break;
+			case DR_LORA_SF10: rx->sf = 10; break;
+			case DR_LORA_SF11: rx->sf = 11; break;
+			case DR_LORA_SF12: rx->sf = 12; break;
+			default: return -1;
+		}
+		switch (p->bandwidth) {
+			case BW_125KHZ: rx->bw_khz = 125; break;
+			case BW_250KHZ: rx->bw_khz = 250; break;
+			case BW_500KHZ: rx->bw_khz = 500; break;
+			default: return -1;
+		}
+		switch (p->coderate) {
+			case CR_LORA_4_5: rx->codr = 5; break;
+			case CR_LORA_4_6: rx->codr = 6; break;
+			case CR_LORA_4_7: rx->codr = 7; break;
+			case CR_LORA_4_8: rx->codr = 8; break;
+			default: rx->codr = 0; /* CR0 case (mostly false sync) */
+		}
+		rx->datr = 0;
+		rx->lsnr = (int16_t)((p->snr < 0) ? (10 * p->snr - 0.5) : (10 * p->snr + 0.5));
+	} else if (p->modulation == MOD_FSK) {
+		rx->modu = BINPK_FSK;
+		rx->sf = 0;
+		rx->bw_khz = 0;
+		rx->codr = 0;
+		rx->datr = p->datarate;
+		rx->lsnr = 0;
+	} else {
+		return -1;
+	}
+	switch (p->status) {
+		case STAT_CRC_OK:  rx->stat = 1;  break;
+		case STAT_CRC_BAD: rx->stat = -1; break;
+		default:           rx->stat = 0;
+	}
+	rx->rssi = (int16_t)((p->rssi < 0) ? (p->rssi - 0.5) : (p->rssi + 0.5));
+	rx->size = (uint8_t)p->size;
+	rx->payload = p->payload;
+	return 0;
+}
+
+/* prepare the fixed fields of the datagram buffers, for the encodings used by the servers */
+static void push_data_init(struct push_dgram *d) {
+	int ic;
+	uint8_t hdr[12];
+	
+	d->use_json = false;
+	d->use_bin = false;
+	d->enrich = false;
+	for (ic = 0; ic < gtw_conf.serv_count; ic++) {
+		if (gtw_conf.serv_binary[ic]) {
+			d->use_bin = true;
+		} else {
+			d->use_json = true;
+		}
+		d->enrich |= gtw_conf.serv_enrich[ic];
+	}
+	isotime_cache_init(&d->time_cache);
+	
+	hdr[0] = PROTOCOL_VERSION;
+	hdr[3] = PKT_PUSH_DATA;
+	*(uint32_t *)(hdr + 4) = net_mac_h;
+	*(uint32_t *)(hdr + 8) = net_mac_l;
+	memcpy((void *)d->json, (void *)hdr, 12);
+	memcpy((void *)d->bin, (void *)hdr, 12);
+	d->bin[12] = BINPK_VERSION;
+}
+
+/* start a new datagram */
+static void push_data_open(struct push_dgram *d, uint16_t token) {
+	d->json[1] = d->bin[1] = (uint8_t)(token >> 8);
+	d->json[2] = d->bin[2] = (uint8_t)token;
+	memcpy((void *)(d->json + 12), (void *)"{\"rxpk\":[", 9); /* after the 12-byte header */
+	d->json_len = 12 + 9;
+	d->bin[12 + BINPK_UP_FLAGS] = 0;
+	d->bin_len = 12 + BINPK_UP_HDR;
+	d->nb_pkt = 0;
+	d->route_all = 0xFF;
+	d->route_any = 0;
+	d->report = false;
+	d->bin_rec = d->bin_len;
+}
+
+/* check that a packet of 'size' bytes fits in the datagram without exceeding max_len */
+static bool push_data_room(const struct push_dgram *d, unsigned size, int max_len) {
+	if (d->nb_pkt == 0) {
+		return true; /* a single packet is always sent, whatever the limit */
+	}
+	if (d->nb_pkt >= BINPK_UP_COUNT_MAX) {
+		return false;
+	}
+	if (d->use_json && (d->json_len + 1 + RXPK_FIXED_MAX + (d->enrich ? LW_JSON_MAX : 0) + (int)(4 * ((size + 2) / 3)) + 2 > max_len)) {
+		return false;
+	}
+	if (d->use_bin && (d->bin_len + BINPK_RX_FIXED_MAX + (int)size > max_len)) {
+		return false;
+	}
+	return true;
+}
+
+/* append a packet routed to the servers of the mask to the datagram, utc is its RX time or NULL if unknown,
+ * f its LoRaWAN headers or NULL if it could not be decoded */
+static void push_data_add(struct push_dgram *d, const struct lgw_pkt_rx_s *p, const struct timespec *utc, const struct lw_frame *f, uint8_t route) {
+	struct binpk_rx rx;
+	int j = 0, k;
+	
+	if (d->use_json) {
+		/* add inter-packet separator if necessary */
+		if (d->nb_pkt > 0) {
+			d->json[d->json_len] = ',';
+			++d->json_len;
+		}
+		d->json_frag[d->nb_pkt] = d->json_len;
+		/* packet metadata and base64-encoded payload */
+		j = rxpk_serialize(p, (utc != NULL) ? isotime_format(&d->time_cache, utc) : NULL, (char *)(d->json + d->json_len), TX_BUFF_SIZE - d->json_len);
+		if (j > 0) {
+			d->json_len += j;
+			d->json_enr[d->nb_pkt] = d->json_len - 1;
+		}
+		/* header fields inserted before the closing brace, the servers without them get a spliced copy */
+		if ((j > 0) && d->enrich && (f != NULL)) {
+			k = lw_json_fields(f, (char *)(d->json + d->json_len - 1), TX_BUFF_SIZE - d->json_len);
+			if (k > 0) {
+				d->json_len += k;
+				d->json[d->json_len - 1] = '}';
+			}
+		}
+	}
+	if ((j >= 0) && d->use_bin) {
+		j = rx_to_binpk(p, utc, &rx);
+		if (j == 0) {
+			/* radio settings are only sent when they differ from the previous packet */
+			j = binpk_rx_write(&rx, (d->nb_pkt > 0) ? &d->prev : NULL, d->bin + d->bin_len, TX_BUFF_SIZE - d->bin_len);
+		}
+		if (j > 0) {
+			d->bin_len += j;
+			d->prev = rx;
+		}
+	}
+	if (j <= 0) {
+		log_msg("ERROR: [up] failed to serialize packet (status %u, modulation %u, BW %u, DR %u, CR %u)\n", p->status, p->modulation, p->bandwidth, p->datarate, p->coderate);
+		exit(EXIT_FAILURE);
+	}
+	d->route[d->nb_pkt] = route;
+	d->route_all &= route;
+	d->route_any |= route;
+	++d->nb_pkt;
+}
+
+/* end the datagram, attach the status report if one is ready and fits in max_len
+ * bytes, return false if the datagram is empty */
+static bool push_data_close(struct push_dgram *d, int max_len) {
+	const int key_len = sizeof "\"stat\":" - 1; /* the binary stat record only carries the object */
+	bool report = false;
+	int j;
+	
+	d->json_frag[d->nb_pkt] = d->json_len;
+	d->bin_stat = d->bin_len;
+	if (d->nb_pkt == 0) {
+		d->json_len = 13; /* removes "rxpk":[ */
+	} else {
+		d->json[d->json_len] = ']';
+		++d->json_len;
+	}
+	
+	/* no mutex, only this thread clears the flag */
+	if (report_ready == true) {
+		pthread_mutex_lock(&mx_stat_rep);
+		j = strlen(status_report);
+		/* a report that does not fit waits for the next datagram */
+		if ((d->nb_pkt == 0) || ((!d->use_json || (d->json_len + 1 + j + 1 <= max_len)) && (!d->use_bin || (d->bin_len + 2 + j - key_len <= max_len)))) {
+			if (d->use_json) {
+				if (d->nb_pkt > 0) {
+					d->json[d->json_len] = ',';
+					++d->json_len;
+				}
+				d->json_stat = d->json_len;
+				memcpy((void *)(d->json + d->json_len), (void *)status_report, j);
+				d->json_len += j;
+			}
+			if (d->use_bin) {
+				d->bin_len += binpk_stat_write(status_report + key_len, j - key_len, d->bin + d->bin_len, TX_BUFF_SIZE - d->bin_len);
+				d->bin[12 + BINPK_UP_FLAGS] |= BINPK_UP_STAT;
+			}
+			report_ready = false;
+			report = true;
+		}
+		pthread_mutex_unlock(&mx_stat_rep);
+	}
+	
+	/* nothing to send if all packets have been filtered out and no report */
+	if ((d->nb_pkt == 0) && (report == false)) {
+		return false;
+	}
+	
+	/* end of JSON datagram payload */
+	d->json[d->json_len] = '}';
+	++d->json_len;
+	d->json[d->json_len] = 0; /* add string terminator, for safety */
+	d->bin[12 + BINPK_UP_COUNT] = (uint8_t)d->nb_pkt;
+	d->report = report;
+	push_data_split(d);
+	return true;
+}
+
+/* select the datagram of each server, the shared one when it receives all the packets with the fields it expects */
+static void push_data_split(struct push_dgram *d) {
+	uint8_t bit;
+	int ic;
+	
+	for (ic = 0; ic < gtw_conf.serv_count; ic++) {
+		bit = 1 << ic;
+		if ((d->route_all & bit) && (!d->enrich || gtw_conf.serv_enrich[ic] || gtw_conf.serv_binary[ic])) {
+			d->out[ic] = gtw_conf.serv_binary[ic] ? d->bin : d->json;
+			d->out_len[ic] = gtw_conf.serv_binary[ic] ? d->bin_len : d->json_len;
+		} else if ((d->route_any & bit) || d->report) {
+			d->out_len[ic] = push_data_splice(d, ic, d->split[ic]);
+			d->out[ic] = d->split[ic];
+		} else {
+			d->out[ic] = NULL; /* nothing for that server */
+		}
+	}
+}
+
+/* compose the datagram of server ic from the serialized packets routed to it, returns its length */
+static int push_data_splice(const struct push_dgram *d, int ic, uint8_t *out) {
+	struct binpk_rx rx, prev;
+	unsigned k, nb = 0;
+	int n, len, pos;
+	
+	if (gtw_conf.serv_binary[ic]) {
+		/* records are decoded and written again, the delta encoding depends on the previous one */
+		memcpy(out, d->bin, d->bin_rec);
+		len = d->bin_rec;
+		pos = d->bin_rec;
+		memset(&rx, 0, sizeof rx);
+		for (k = 0; k < d->nb_pkt; ++k) {
+			n = binpk_rx_read(d->bin + pos, d->bin_stat - pos, &rx);
+			pos += n;
+			if (d->route[k] & (1 << ic)) {
+				len += binpk_rx_write(&rx, (nb > 0) ? &prev : NULL, out + len, TX_BUFF_SIZE - len);
+				prev = rx;
+				++nb;
+			}
+		}
+		memcpy(out + len, d->bin + d->bin_stat, d->bin_len - d->bin_stat);
+		len += d->bin_len - d->bin_stat;
+		out[12 + BINPK_UP_COUNT] = (uint8_t)nb;
+		return len;
+	}
+	
+	/* the JSON objects are copied, without their separators */
+	memcpy(out, d->json, 13);
+	len = 13;
+	for (k = 0; k < d->nb_pkt; ++k) {
+		if (d->route[k] & (1 << ic)) {
+			if (nb == 0) {
+				memcpy(out + len, "\"rxpk\":[", 8);
+				len += 8;
+			} else {
+				out[len++] = ',';
+			}
+			if (d->enrich && !gtw_conf.serv_enrich[ic]) {
+				n = d->json_enr[k] - d->json_frag[k];
+				memcpy(out + len, d->json + d->json_frag[k], n);
+				len += n;
+				out[len++] = '}';
+			} else {
+				n = d->json_frag[k + 1] - d->json_frag[k] - ((k + 1 < d->nb_pkt) ? 1 : 0);
+				memcpy(out + len, d->json + d->json_frag[k], n);
+				len += n;
+			}
+			++nb;
+		}
+	}
+	if (nb > 0) {
+		out[len++] = ']';
+	}
+	if (d->report) {
+		if (nb > 0) {
+			out[len++] = ',';
+		}
+		n = d->json_len - 1 - d->json_stat;
+		memcpy(out + len, d->json + d->json_stat, n);
+		len += n;
+	}
+	out[len++] = '}';
+	out[len] = 0;
+	return len;
+}
+
+/* send the datagram to all started servers but the held ones, in their encoding and with their packets, the ACKs are collected asynchronously by the ACK threads */
+static void push_data_send(const struct push_dgram *d, uint16_t token, bool *started, const bool *held, unsigned nb_merged) {
+	int i, ic;
+	struct tx_batch tx; /* one datagram per server */
+	struct timespec send_time;
+	bool evicted[TX_BATCH_MAX]; /* an unacknowledged datagram was pushed out of the in-flight table */
+	struct meas_block *meas = &meas_blocks[MEAS_UP]; /* only called by the upstream thread */
+	
+	// printf("\nJSON up: %s\n", (char *)(d->json + 12)); /* DEBUG: display JSON payload */
+	
+	tx_batch_init(&tx);
+	for (ic = 0; ic < gtw_conf.serv_count; ic++) {
+		if (!started[ic]) {
+			if (!server_is_started(&servers.s[ic])) continue;
+			started[ic] = true;
+		}
+		if (((held != NULL) && held[ic]) || (d->out[ic] == NULL)) {
+			continue;
+		}
+		tx_batch_add(&tx, sock_up[ic], d->out[ic], d->out_len[ic], ic);
+	}
+	
+	/* recorded before the send, so that an early ACK finds its datagram, a failed send is retransmitted */
+	clock_gettime(CLOCK_MONOTONIC, &send_time);
+	for (i = 0; i < tx.nb; ++i) {
+		evicted[i] = inflight_add(&push_inflight[tx.tag[i]], token, send_time, tx.iov[i].iov_base, tx.iov[i].iov_len);
+	}
+	tx_batch_flush(&tx);
+	
+	/* account only for the datagrams actually handed to the network */
+	for (i = 0; i < tx.nb; ++i) {
+		if (evicted[i]) {
+			meas_begin(meas);
+			meas_add(meas, MEAS_UP_ACK_LOST, 1);
+			meas_end(meas);
+		}
+		if (tx.result[i] < 0) {
+			continue;
+		}
+		meas_begin(meas);
+		meas_add(meas, MEAS_UP_DGRAM_SENT, 1);
+		meas_add(meas, MEAS_UP_NETWORK_BYTE, tx.result[i]);
+		meas_add(meas, MEAS_UP_DGRAM_SAVED, nb_merged);
+		meas_add(meas, MEAS_UP_BYTE_SAVED, nb_merged * PUSH_DGRAM_OVERHEAD);
+		meas_end(meas);
+	}
+}
+
+/* format the bound of the bin of a histogram of milliseconds holding a percentile */
+static void hist_format(const uint32_t *hist, int nb_bin, unsigned pct, char *str) {
+	int i = meas_hist_pct(hist, nb_bin, pct);
+	
+	if (i < 0) {
+		strcpy(str, "-");
+	} else if (i == nb_bin - 1) {
+		sprintf(str, ">= %i ms", 1 << (i - 1));
+	} else {
+		sprintf(str, "< %i ms", 1 << i);
+	}
+}
+
+/* mark the copies of frames already forwarded, among the copies of a frame in the batch only the best SNR is kept */
+static void dedup_batch(const struct rx_batch *batch, bool *dup) {
+	uint32_t hash[NB_PKT_MAX];
+	const struct lgw_pkt_rx_s *p, *q;
+	struct timespec now;
+	uint32_t now_ms;
+	int i, j;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	now_ms = (uint32_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+	for (i = 0; i < batch->nb_pkt; ++i) {
+		p = &batch->pkt[i];
+		dup[i] = false;
+		if (p->status == STAT_CRC_BAD) {
+			continue; /* the payload cannot be trusted */
+		}
+		hash[i] = dedup_hash(p->payload, p->size);
+		for (j = 0; j < i; ++j) {
+			q = &batch->pkt[j];
+			if (dup[j] || (q->status == STAT_CRC_BAD) || (hash[j] != hash[i]) || !dedup_close(&rx_dedup, p->count_us, q->count_us)) {
+				continue;
+			}
+			if (p->snr > q->snr) {
+				dup[j] = true;
+			} else {
+				dup[i] = true;
+				break;
+			}
+		}
+	}
+	for (i = 0; i < batch->nb_pkt; ++i) {
+		if (!dup[i] && (batch->pkt[i].status != STAT_CRC_BAD)) {
+			dup[i] = dedup_check(&rx_dedup, hash[i], now_ms);
+		}
+	}
+}
+
+/* priority of a packet when the upstream queue fills up: 0 for a CRC error or no
+ * CRC, 1 for a copy of a recent payload, 2 for an unconfirmed uplink or a frame
+ * that is not an uplink, 3 for the join-requests and confirmed uplinks */
+static int shed_class(const struct lgw_pkt_rx_s *p) {
+	struct lw_frame f;
+	uint32_t hash;
+	bool copy = false;
+	int i;
+	
+	if (p->status != STAT_CRC_OK) {
+		return 0;
+	}
+	hash = dedup_hash(p->payload, p->size);
+	for (i = 0; (i < SHED_RECENT) && !copy; ++i) {
+		copy = (shed_recent[i] == hash);
+	}
+	shed_recent[shed_recent_idx++ % SHED_RECENT] = hash;
+	if (copy) {
+		return 1;
+	}
+	if (lw_parse(p->payload, p->size, &f) != 0) {
+		return 2;
+	}
+	switch (f.mtype) {
+		case LW_JOIN_REQUEST:
+		case LW_REJOIN_REQUEST:
+		case LW_CONF_UP:
+			return 3;
+		default:
+			return 2;
+	}
+}
+
+/* drop the packets whose class is shed at this queue depth, count them per
+ * class in shed[], returns the nb of packets kept at the start of pkt[] */
+static int shed_batch(struct lgw_pkt_rx_s *pkt, int nb_pkt, unsigned depth, uint32_t *shed) {
+	int i, c, nb = 0;
+	
+	for (i = 0; i < nb_pkt; ++i) {
+		c = shed_class(&pkt[i]);
+		if ((c < (int)ARRAY_SIZE(gtw_conf.shed_depth)) && (depth >= gtw_conf.shed_depth[c])) {
+			++shed[c];
+			continue;
+		}
+		if (nb != i) {
+			pkt[nb] = pkt[i];
+		}
+		++nb;
+	}
+	return nb;
+}
+
+/* decode the LoRaWAN headers of the packets of the batch, once for the network filter and the routes */
+static void lw_parse_batch(const struct rx_batch *batch, struct lw_frame *frame, bool *valid) {
+	const struct lgw_pkt_rx_s *p;
+	int i;
+	
+	for (i = 0; i < batch->nb_pkt; ++i) {
+		p = &batch->pkt[i];
+		/* the header of a frame with a CRC error cannot be trusted */
+		valid[i] = (p->status != STAT_CRC_BAD) && (lw_parse(p->payload, p->size, &frame[i]) == 0);
+	}
+}
+
+/* apply the network filter to the packets of the batch */
+static void filter_batch(const struct rx_batch *batch, const struct lw_frame *frame, const bool *valid, enum filter_verdict *verdict) {
+	int i;
+	
+	pthread_mutex_lock(&mx_filter);
+	for (i = 0; i < batch->nb_pkt; ++i) {
+		if (batch->pkt[i].status == STAT_CRC_BAD) {
+			verdict[i] = FILTER_PASS;
+		} else {
+			verdict[i] = filter_check(rx_filter, valid[i] ? &frame[i] : NULL);
+		}
+	}
+	pthread_mutex_unlock(&mx_filter);
+}
+
+/* account for the uplinks of the batch that are forwarded, whatever their route, in the link table */
+static void link_batch(const struct rx_batch *batch, const struct lw_frame *frame, const bool *valid, const bool *dup, const enum filter_verdict *verdict) {
+	const struct lgw_pkt_rx_s *p;
+	int i, sf;
+	
+	pthread_mutex_lock(&mx_linkq);
+	for (i = 0; i < batch->nb_pkt; ++i) {
+		p = &batch->pkt[i];
+		if ((p->status != STAT_CRC_OK) || !valid[i] || dup[i] || (verdict[i] != FILTER_PASS)) {
+			continue;
+		}
+		if ((frame[i].mtype != LW_UNCONF_UP) && (frame[i].mtype != LW_CONF_UP)) {
+			continue;
+		}
+		switch (p->datarate) {
+			case DR_LORA_SF7:  sf = 7;  break;
+			case DR_LORA_SF8:  sf = 8;  break;
+			case DR_LORA_SF9:  sf = 9;  break;
+			case DR_LORA_SF10: sf = 10; break;
+			case DR_LORA_SF11: sf = 11; break;
+			case DR_LORA_SF12: sf = 12; break;
+			default: sf = 0;
+		}
+		if (p->modulation != MOD_LORA) {
+			sf = 0;
+		}
+		linkq_update(&link_table, frame[i].devaddr, frame[i].fcnt, sf, p->rssi, p->snr);
+	}
+	pthread_mutex_unlock(&mx_linkq);
+}
+
+/* parse a configuration file in the configuration arena, emptied after each parser is done with it */
+static void parse_configuration(const char *path) {
+	parse_SX1301_configuration(path);
+	arena_reset(&conf_arena);
+	parse_gateway_configuration(path, &gtw_conf);
+	arena_reset(&conf_arena);
+}
+
+/* load the filter file again, the current filter is kept if the file is invalid */
+static void filter_reload(void) {
+	struct lw_filter *f, *old;
+	
+	if (gtw_conf.filter_file[0] == 0) {
+		log_msg("INFO: [main] no filter file configured, nothing to reload\n");
+		return;
+	}
+	f = filter_load(gtw_conf.filter_file);
+	if (f == NULL) {
+		log_msg("WARNING: [main] filter file %s rejected, the previous filter is kept\n", gtw_conf.filter_file);
+		return;
+	}
+	pthread_mutex_lock(&mx_filter);
+	old = rx_filter;
+	rx_filter = f;
+	pthread_mutex_unlock(&mx_filter);
+	filter_free(old);
+}
+
+/* mask of the servers a packet is routed to, f is NULL for a frame that is not LoRaWAN */
+static uint8_t route_packet(const struct lw_frame *f) {
+	uint8_t route = 0;
+	int ic;
+	
+	for (ic = 0; ic < gtw_conf.serv_count; ic++) {
+		if ((gtw_conf.serv_route[ic] == NULL) || (filter_check(gtw_conf.serv_route[ic], f) == FILTER_PASS)) {
+			route |= 1 << ic;
+		}
+	}
+	return route;
+}
+
+/* size limit of the next datagrams: the configured one, lowered to the path MTU of the servers */
+static int push_size_limit(const bool *started) {
+	int ic, mtu, max = gtw_conf.push_max_size;
+	
+	if (max > TX_BUFF_SIZE - 1) {
+		max = TX_BUFF_SIZE - 1;
+	}
+	for (ic = 0; ic < gtw_conf.serv_count; ic++) {
+		if (!started[ic]) {
+			continue;
+		}
+		mtu = pmtu_payload(sock_up[ic]);
+		if (mtu != push_pmtu[ic]) {
+			push_pmtu[ic] = mtu;
+			if ((mtu > 0) && (mtu < gtw_conf.push_max_size)) {
+				log_msg("INFO: [up] path MTU to server %s allows %i-byte datagrams\n", gtw_conf.serv_addr[ic], mtu);
+			}
+		}
+		if ((mtu > 0) && (mtu < max)) {
+			max = (mtu < PUSH_MIN_SIZE) ? PUSH_MIN_SIZE : mtu;
+		}
+	}
+	return max;
+}
+
+/* send the datagram, through the journal when enabled */
+static void push_data_forward(const struct push_dgram *d, uint16_t token, bool *started, unsigned nb_merged) {
+	if (journal_on) {
+		push_journal_add(d, token, started, nb_merged);
+	} else {
+		push_data_send(d, token, started, NULL, nb_merged);
+	}
+}
+
+/* map the journal, the servers start from the cursors saved by the previous run */
+static void push_journal_open(void) {
+	int i, ic;
+	uint16_t len;
+	uint32_t server_id[MAX_SERVERS];
+	
+	for (ic = 0; ic < gtw_conf.serv_count; ic++) {
+		server_id[ic] = journal_server_id(gtw_conf.serv_addr[ic], gtw_conf.serv_port_up[ic]);
+	}
+	i = journal_open(&push_journal, gtw_conf.journal_path, gtw_conf.journal_size, gtw_conf.serv_count, server_id);
+	if (i < 0) {
+		log_msg("ERROR: [up] failed to open journal %s (%u bytes min)\n", gtw_conf.journal_path, JOURNAL_MIN_SIZE);
+		exit(EXIT_FAILURE);
+	}
+	log_msg("INFO: [up] journal %s %s\n", gtw_conf.journal_path, (i == 1) ? "recovered" : "initialized");
+	clock_gettime(CLOCK_MONOTONIC, &journal_last_sync);
+	for (ic = 0; ic < gtw_conf.serv_count; ic++) {
+		memset(&journal_links[ic], 0, sizeof journal_links[ic]);
+		journal_links[ic].last_check = journal_last_sync;
+		journal_links[ic].probe_pos = JOURNAL_NO_PROBE;
+		if (push_journal.moved & (1 << ic)) {
+			log_msg("WARNING: [up] server %s is not the one journaled as server %i, its journaled datagrams are skipped\n", gtw_conf.serv_addr[ic], ic);
+		}
+		journal_links[ic].live = (journal_peek(&push_journal, ic, &len) == NULL);
+		if (!journal_links[ic].live) {
+			log_msg("INFO: [up] server %s has journaled datagrams to catch up\n", gtw_conf.serv_addr[ic]);
+		}
+	}
+	journal_on = true;
+}
+
+/* journal the datagram, then send it at once to the servers that are caught up */
+static void push_journal_add(const struct push_dgram *d, uint16_t token, bool *started, unsigned nb_merged) {
+	int64_t pos[MAX_SERVERS]; /* position of the record of each server */
+	bool done[MAX_SERVERS] = {false};
+	bool held[MAX_SERVERS];
+	unsigned lost = 0, n;
+	uint8_t readers;
+	struct journal_link *l;
+	struct timespec now;
+	int ic, jc;
+	
+	/* a single record for the servers receiving the same datagram */
+	for (ic = 0; ic < gtw_conf.serv_count; ic++) {
+		if ((d->out[ic] == NULL) || done[ic]) {
+			continue;
+		}
+		readers = 0;
+		for (jc = ic; jc < gtw_conf.serv_count; jc++) {
+			if (d->out[jc] == d->out[ic]) {
+				readers |= 1 << jc;
+				done[jc] = true;
+			}
+		}
+		pos[ic] = journal_append(&push_journal, readers, d->out[ic], d->out_len[ic], &n);
+		lost += n;
+		for (jc = ic + 1; jc < gtw_conf.serv_count; jc++) {
+			if (readers & (1 << jc)) pos[jc] = pos[ic];
+		}
+	}
+	if (lost > 0) {
+		meas_begin(&meas_blocks[MEAS_UP]);
+		meas_add(&meas_blocks[MEAS_UP], MEAS_UP_JOURNAL_LOST, lost);
+		meas_end(&meas_blocks[MEAS_UP]);
+	}
+	
+	/* the others get it from the journal, in order, after their backlog */
+	for (ic = 0; ic < gtw_conf.serv_count; ic++) {
+		l = &journal_links[ic];
+		held[ic] = !started[ic] || !l->live;
+		if (held[ic]) {
+			l->live = false;
+		}
+	}
+	push_data_send(d, token, started, held, nb_merged);
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	for (ic = 0; ic < gtw_conf.serv_count; ic++) {
+		if (held[ic] || !started[ic] || (d->out[ic] == NULL)) {
+			continue;
+		}
+		l = &journal_links[ic];
+		if (!l->unacked) {
+			l->unacked = true;
+			l->unacked_pos = (pos[ic] >= 0) ? (uint64_t)pos[ic] : journal_pos(&push_journal, ic); /* not journaled if too large */
+			l->unacked_since = now;
+		}
+		journal_skip(&push_journal, ic);
+		l->last_send = now;
+	}
+}
+
+/* detect the server outages from the missing ACKs, replay the journal to the
+ * servers lagging behind at the catch-up rate, and flush the journal */
+static void push_journal_drain(uint16_t *token, bool *started) {
+	struct meas_block *meas = &meas_blocks[MEAS_UP];
+	struct journal_link *l;
+	struct tx_batch tx;
+	struct timespec now;
+	uint64_t pos;
+	uint32_t ack_nb;
+	uint16_t len;
+	uint8_t *buf;
+	float max_credit;
+	bool evicted[TX_BATCH_MAX];
+	int i, ic, nb;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	for (ic = 0; ic < gtw_conf.serv_count; ic++) {
+		if (!started[ic]) {
+			if (!server_is_started(&servers.s[ic])) continue;
+			started[ic] = true;
+		}
+		l = &journal_links[ic];
+		
+		/* any ACK since the last check proves the server reachable */
+		ack_nb = __atomic_load_n(&push_ack_nb[ic], __ATOMIC_RELAXED);
+		if (ack_nb != l->ack_nb) {
+			l->ack_nb = ack_nb;
+			l->unacked = false;
+			if (l->outage) {
+				l->outage = false;
+				log_msg("INFO: [up] server %s is reachable again, replaying the journal\n", gtw_conf.serv_addr[ic]);
+				/* the probe got through, the replay starts after it */
+				if (journal_pos(&push_journal, ic) == l->probe_pos) {
+					journal_next(&push_journal, ic);
+				}
+			}
+			l->probe_pos = JOURNAL_NO_PROBE;
+		} else if (l->unacked && !l->outage && ((1000 * difftimespec(now, l->unacked_since)) > gtw_conf.journal_outage_ms)) {
+			/* what was sent since the last ACK is sent again once the server is back */
+			l->outage = true;
+			l->live = false;
+			journal_rewind(&push_journal, ic, l->unacked_pos);
+			log_msg("WARNING: [up] no PUSH_ACK from server %s for %u ms, holding the datagrams in the journal\n", gtw_conf.serv_addr[ic], gtw_conf.journal_outage_ms);
+		}
+		
+		/* replay budget: a single probe per outage period during an outage, the catch-up rate otherwise */
+		if (l->outage) {
+			nb = ((1000 * difftimespec(now, l->last_send)) >= gtw_conf.journal_outage_ms) ? 1 : 0;
+		} else {
+			max_credit = (gtw_conf.journal_catchup_rate < TX_BATCH_MAX) ? gtw_conf.journal_catchup_rate : TX_BATCH_MAX;
+			l->credit += gtw_conf.journal_catchup_rate * difftimespec(now, l->last_check);
+			if (l->credit > max_credit) l->credit = max_credit;
+			nb = l->live ? 0 : (int)l->credit;
+		}
+		l->last_check = now;
+		if (nb == 0) {
+			continue;
+		}
+		
+		/* records are sent from the journal pages, with a new token */
+		tx_batch_init(&tx);
+		pos = journal_pos(&push_journal, ic);
+		while (tx.nb < nb) {
+			buf = journal_peek(&push_journal, ic, &len);
+			if (buf == NULL) {
+				l->live = !l->outage; /* caught up */
+				break;
+			}
+			++(*token);
+			buf[1] = (uint8_t)(*token >> 8);
+			buf[2] = (uint8_t)*token;
+			tx_batch_add(&tx, sock_up[ic], buf, len, ic);
+			if (l->outage) {
+				l->probe_pos = journal_pos(&push_journal, ic);
+				break; /* the probe stays in the journal until an ACK comes back */
+			}
+			journal_next(&push_journal, ic);
+		}
+		if (tx.nb == 0) {
+			continue;
+		}
+		for (i = 0; i < tx.nb; ++i) {
+			buf = tx.iov[i].iov_base;
+			evicted[i] = inflight_add(&push_inflight[ic], ((uint16_t)buf[1] << 8) | buf[2], now, buf, tx.iov[i].iov_len);
+		}
+		tx_batch_flush(&tx);
+		if (!l->outage) {
+			l->credit -= tx.nb;
+		}
+		if (!l->unacked) {
+			l->unacked = true;
+			l->unacked_pos = pos;
+			l->unacked_since = now;
+		}
+		l->last_send = now;
+		
+		meas_begin(meas);
+		for (i = 0; i < tx.nb; ++i) {
+			if (evicted[i]) meas_add(meas, MEAS_UP_ACK_LOST, 1);
+			if (tx.result[i] < 0) {
+				continue;
+			}
+			meas_add(meas, MEAS_UP_DGRAM_SENT, 1);
+			meas_add(meas, MEAS_UP_NETWORK_BYTE, tx.result[i]);
+			meas_add(meas, MEAS_UP_JOURNAL_REPLAY, 1);
+		}
+		meas_end(meas);
+	}
+	
+	/* writes are flushed in batches, to spare slow flash storage */
+	if ((1000 * difftimespec(now, journal_last_sync)) >= gtw_conf.journal_sync_ms) {
+		journal_sync(&push_journal);
+		journal_last_sync = now;
+	}
+}
+
+/* convert a UTC TX time to a concentrator timestamp, using the GPS time reference */
+static int utc_to_count(const struct timespec *utc, uint32_t *count_us) {
+	struct tref local_ref; /* time reference used for UTC <-> timestamp conversion */
+	
+	if (gtw_conf.gps_active == false) {
+		log_msg("WARNING: [down] GPS disabled, impossible to send packet on specific UTC time, TX aborted\n");
+		return -1;
+	}
+	pthread_mutex_lock(&mx_timeref);
+	if (gps_ref_valid == false) {
+		pthread_mutex_unlock(&mx_timeref);
+		log_msg("WARNING: [down] no valid GPS time reference yet, impossible to send packet on specific UTC time, TX aborted\n");
+		return -1;
+	}
+	local_ref = time_reference_gps;
+	pthread_mutex_unlock(&mx_timeref);
+	
+	/* transform UTC time to timestamp */
+	if (lgw_utc2cnt(local_ref, *utc, count_us) != LGW_GPS_SUCCESS) {
+		log_msg("WARNING: [down] could not convert UTC time to timestamp, TX aborted\n");
+		return -1;
+	}
+	log_msg("INFO: [down] a packet will be sent on timestamp value %u (calculated from UTC time)\n", *count_us);
+	return 0;
+}
+
+/* parse a JSON txpk object (see PROTOCOL.TXT) into txpkt with the complete JSON parser, return 0 if it can be sent */
+static int parse_txpk_tree(const char *json, struct lgw_pkt_tx_s *txpkt) {
+	int i;
+	bool sent_immediate = false; /* option to sent the packet immediately */
+	
+	/* JSON parsing variables */
+	JSON_Value *root_val = NULL;
+	JSON_Object *txpk_obj = NULL;
+	JSON_Value *val = NULL; /* needed to detect the absence of some fields */
+	const char *str; /* pointer to sub-strings in the JSON data */
+	short x0, x1;
+	char trail; /* char after the datr, which must have none */
+	
+	/* UTC time that needs to be converted to timestamp */
+	struct timespec utc_tx;
+	
+	/* try to parse JSON */
+	root_val = json_parse_string(json);
+	if (root_val == NULL) {
+		log_msg("WARNING: [down] invalid JSON, TX aborted\n");
+		return -1;
+	}
+
+	/* look for JSON sub-object 'txpk' */
+	txpk_obj = json_object_get_object(json_value_get_object(root_val), "txpk");
+	if (txpk_obj == NULL) {
+		log_msg("WARNING: [down] no \"txpk\" object in JSON, TX aborted\n");
+		json_value_free(root_val);
+		return -1;
+	}
+
+	/* Parse "immediate" tag, or target timestamp, or UTC time to be converted by GPS (mandatory) */
+	i = json_object_get_boolean(txpk_obj,"imme"); /* can be 1 if true, 0 if false, or -1 if not a JSON boolean */
+	if (i == 1) {
+		/* TX procedure: send immediately */
+		sent_immediate = true;
+		log_msg("INFO: [down] a packet will be sent in \"immediate\" mode\n");
+	} else {
+		sent_immediate = false;
+		val = json_object_get_value(txpk_obj,"tmst");
+		if (val != NULL) {
+			/* TX procedure: send on timestamp value */
+			txpkt->count_us = (uint32_t)json_value_get_number(val);
+			log_msg("INFO: [down] a packet will be sent on timestamp value %u\n", txpkt->count_us);
+		} else {
+			/* TX procedure: send on UTC time (converted to timestamp value) */
+			str = json_object_get_string(txpk_obj, "time");
+			if (str == NULL) {
+				log_msg("WARNING: [down] no mandatory \"txpk.tmst\" or \"txpk.time\" objects in JSON, TX aborted\n");
+				json_value_free(root_val);
+				return -1;
+			}
+			if (isotime_parse(str, &utc_tx) != 0) {
+				log_msg("WARNING: [down] \"txpk.time\" must follow ISO 8601 format, TX aborted\n");
+				json_value_free(root_val);
+				return -1;
+			}
+			if (utc_to_count(&utc_tx, &(txpkt->count_us)) != 0) {
+				json_value_free(root_val);
+				return -1;
+			}
+		}
+	}
+
+	/* Parse "No CRC" flag (optional field) */
+	val = json_object_get_value(txpk_obj,"ncrc");
+	if (val != NULL) {
+		txpkt->no_crc = (bool)json_value_get_boolean(val);
+	}
+
+	/* parse target frequency (mandatory) */
+	val = json_object_get_value(txpk_obj,"freq");
+	if (val == NULL) {
+		log_msg("WARNING: [down] no mandatory \"txpk.freq\" object in JSON, TX aborted\n");
+		json_value_free(root_val);
+		return -1;
+	}
+	txpkt->freq_hz = (uint32_t)((double)(1.0e6) * json_value_get_number(val));
+
+	/* parse RF chain used for TX (mandatory) */
+	val = json_object_get_value(txpk_obj,"rfch");
+	if (val == NULL) {
+		log_msg("WARNING: [down] no mandatory \"txpk.rfch\" object in JSON, TX aborted\n");
+		json_value_free(root_val);
+		return -1;
+	}
+	txpkt->rf_chain = (uint8_t)json_value_get_number(val);
+
+	/* parse TX power (optional field) */
+	val = json_object_get_value(txpk_obj,"powe");
+	if (val != NULL) {
+		txpkt->rf_power = (int8_t)json_value_get_number(val);
+	}
+
+	/* Parse modulation (mandatory) */
+	str = json_object_get_string(txpk_obj, "modu");
+	if (str == NULL) {
+		log_msg("WARNING: [down] no mandatory \"txpk.modu\" object in JSON, TX aborted\n");
+		json_value_free(root_val);
+		return -1;
+	}
+	if (strcmp(str, "LORA") == 0) {
+		/* Lora modulation */
+		txpkt->modulation = MOD_LORA;
+
+		/* Parse Lora spreading-factor and modulation bandwidth (mandatory) */
+		str = json_object_get_string(txpk_obj, "datr");
+		if (str == NULL) {
+			log_msg("WARNING: [down] no mandatory \"txpk.datr\" object in JSON, TX aborted\n");
+			json_value_free(root_val);
+			return -1;
+		}
+		i = sscanf(str, "SF%2hdBW%3hd%c", &x0, &x1, &trail);
+		if (i != 2) {
+			log_msg("WARNING: [down] format error in \"txpk.datr\", TX aborted\n");
+			json_value_free(root_val);
+			return -1;
+		}
+		switch (x0) {
+			case  7: txpkt->datarate = DR_LORA_SF7;  break;
+			case  8: txpkt->datarate = DR_LORA_SF8;  break;
+			case  9: txpkt->datarate = DR_LORA_SF9;  break;
+			case 10: txpkt->datarate = DR_LORA_SF10; break;
+			case 11: txpkt->datarate = DR_LORA_SF11; break;
+			case 12: txpkt->datarate = DR_LORA_SF12; break;
+			default:
+				log_msg("WARNING: [down] format error in \"txpk.datr\", invalid SF, TX aborted\n");
+				json_value_free(root_val);
+				return -1;
+		}
+		switch (x1) {
+			case 125: txpkt->bandwidth = BW_125KHZ; break;
+			case 250: txpkt->bandwidth = BW_250KHZ; break;
+			case 500: txpkt->bandwidth = BW_500KHZ; break;
+			default:
+				log_msg("WARNING: [down] format error in \"txpk.datr\", invalid BW, TX aborted\n");
+				json_value_free(root_val);
+				return -1;
+		}
+
+		/* Parse ECC coding rate (optional field) */
+		str = json_object_get_string(txpk_obj, "codr");
+		if (str == NULL) {
+			log_msg("WARNING: [down] no mandatory \"txpk.codr\" object in json, TX aborted\n");
+			json_value_free(root_val);
+			return -1;
+		}
+		if      (strcmp(str, "4/5") == 0) txpkt->coderate = CR_LORA_4_5;
+		else if (strcmp(str, "4/6") == 0) txpkt->coderate = CR_LORA_4_6;
+		else if (strcmp(str, "2/3") == 0) txpkt->coderate = CR_LORA_4_6;
+		else if (strcmp(str, "4/7") == 0) txpkt->coderate = CR_LORA_4_7;
+		else if (strcmp(str, "4/8") == 0) txpkt->coderate = CR_LORA_4_8;
+		else if (strcmp(str, "1/2") == 0) txpkt->coderate = CR_LORA_4_8;
+		else {
+			log_msg("WARNING: [down] format error in \"txpk.codr\", TX aborted\n");
+			json_value_free(root_val);
+			return -1;
+		}
+
+		/* Parse signal polarity switch (optional field) */
+		val = json_object_get_value(txpk_obj,"ipol");
+		if (val != NULL) {
+			txpkt->invert_pol = (bool)json_value_get_boolean(val);
+		}
+
+		/* parse Lora preamble length (optional field, optimum min value enforced) */
+		val = json_object_get_value(txpk_obj,"prea");
+		if (val != NULL) {
+			i = (int)json_value_get_number(val);
+			if (i >= MIN_LORA_PREAMB) {
+				txpkt->preamble = (uint16_t)i;
+			} else {
+				txpkt->preamble = (uint16_t)MIN_LORA_PREAMB;
+			}
+		} else {
+			txpkt->preamble = (uint16_t)STD_LORA_PREAMB;
+		}
+		
+	} else if (strcmp(str, "FSK") == 0) {
+		/* FSK modulation */
+		txpkt->modulation = MOD_FSK;
+
+		/* parse FSK bitrate (mandatory) */
+		val = json_object_get_value(txpk_obj,"datr");
+		if (val == NULL) {
+			log_msg("WARNING: [down] no mandatory \"txpk.datr\" object in JSON, TX aborted\n");
+			json_value_free(root_val);
+			return -1;
+		}
+		txpkt->datarate = (uint32_t)(json_value_get_number(val));
+		
+		/* parse frequency deviation (mandatory) */
+		val = json_object_get_value(txpk_obj,"fdev");
+		if (val == NULL) {
+			log_msg("WARNING: [down] no mandatory \"txpk.fdev\" object in JSON, TX aborted\n");
+			json_value_free(root_val);
+			return -1;
+		}
+		txpkt->f_dev = (uint8_t)(json_value_get_number(val) / 1000.0); /* JSON value in Hz, txpkt->f_dev in kHz */
+
+		/* parse FSK preamble length (optional field, optimum min value enforced) */
+		val = json_object_get_value(txpk_obj,"prea");
+		if (val != NULL) {
+			i = (int)json_value_get_number(val);
+			if (i >= MIN_FSK_PREAMB) {
+				txpkt->preamble = (uint16_t)i;
+			} else {
+				txpkt->preamble = (uint16_t)MIN_FSK_PREAMB;
+			}
+		} else {
+			txpkt->preamble = (uint16_t)STD_FSK_PREAMB;
+		}
+	
+	} else {
+		log_msg("WARNING: [down] invalid modulation in \"txpk.modu\", TX aborted\n");
+		json_value_free(root_val);
+		return -1;
+	}
+
+	/* Parse payload length (mandatory) */
+	val = json_object_get_value(txpk_obj,"size");
+	if (val == NULL) {
+		log_msg("WARNING: [down] no mandatory \"txpk.size\" object in JSON, TX aborted\n");
+		json_value_free(root_val);
+		return -1;
+	}
+	txpkt->size = (uint16_t)json_value_get_number(val);
+	
+	/* Parse payload data (mandatory) */
+	str = json_object_get_string(txpk_obj, "data");
+	if (str == NULL) {
+		log_msg("WARNING: [down] no mandatory \"txpk.data\" object in JSON, TX aborted\n");
+		json_value_free(root_val);
+		return -1;
+	}
+	i = b64_to_bin(str, strlen(str), txpkt->payload, sizeof txpkt->payload);
+	if (i != txpkt->size) {
+		log_msg("WARNING: [down] mismatch between .size and .data size once converter to binary\n");
+	}
+	
+	/* free the JSON parse tree from memory */
+	json_value_free(root_val);
+	
+	/* select TX mode */
+	if (sent_immediate) {
+		txpkt->tx_mode = IMMEDIATE;
+	} else {
+		txpkt->tx_mode = TIMESTAMPED;
+	}
+	
+	return 0;
+}
+
+/* parse a JSON txpk object in a single pass, the objects the decoder leaves aside go through the complete JSON parser */
+static int parse_txpk_json(const char *json, int len, struct lgw_pkt_tx_s *txpkt) {
+	struct binpk_tx tx;
+	
+	if (txpk_json_read(json, len, &tx, txpkt->payload, sizeof txpkt->payload) == 0) {
+		return parse_txpk_fields(&tx, txpkt);
+	}
+	memset(txpkt, 0, sizeof *txpkt);
+	return parse_txpk_tree(json, txpkt);
+}
+
+/* parse a binary txpk body (see PROTOCOL.TXT) into txpkt, return 0 if it can be sent */
+static int parse_txpk_bin(const uint8_t *body, int len, struct lgw_pkt_tx_s *txpkt) {
+	struct binpk_tx tx;
+	
+	if (binpk_tx_read(body, len, &tx) != 0) {
+		log_msg("WARNING: [down] invalid binary txpk, TX aborted\n");
+		return -1;
+	}
+	return parse_txpk_fields(&tx, txpkt);
+}
+
+/* convert the fields of a txpk, decoded from JSON or binary, into txpkt, return 0 if it can be sent */
+static int parse_txpk_fields(const struct binpk_tx *tx, struct lgw_pkt_tx_s *txpkt) {
+	struct timespec utc_tx; /* UTC time that needs to be converted to timestamp */
+	
+	/* send immediately, on a timestamp value, or on UTC time converted by GPS */
+	if (tx->imme) {
+		txpkt->tx_mode = IMMEDIATE;
+		log_msg("INFO: [down] a packet will be sent in \"immediate\" mode\n");
+	} else {
+		txpkt->tx_mode = TIMESTAMPED;
+		if (tx->has_time) {
+			utc_tx.tv_sec = (time_t)(tx->time_us / 1000000);
+			utc_tx.tv_nsec = (long)(tx->time_us % 1000000) * 1000;
+			if (utc_to_count(&utc_tx, &(txpkt->count_us)) != 0) {
+				return -1;
+			}
+		} else {
+			txpkt->count_us = tx->tmst;
+			log_msg("INFO: [down] a packet will be sent on timestamp value %u\n", txpkt->count_us);
+		}
+	}
+	
+	txpkt->no_crc = tx->ncrc;
+	txpkt->freq_hz = tx->freq_hz;
+	txpkt->rf_chain = tx->rfch;
+	txpkt->rf_power = tx->powe;
+	if (tx->modu == BINPK_LORA) {
+		txpkt->modulation = MOD_LORA;
+		switch (tx->sf) {
+			case  7: txpkt->datarate = DR_LORA_SF7;  break;
+			case  8: txpkt->datarate = DR_LORA_SF8;  break;
+			case  9: txpkt->datarate = DR_LORA_SF9;  break;
+			case 10: txpkt->datarate = DR_LORA_SF10; break;
+			case 11: txpkt->datarate = DR_LORA_SF11; break;
+			case 12: txpkt->datarate = DR_LORA_SF12; break;
+			default:
+				log_msg("WARNING: [down] invalid SF in txpk, TX aborted\n");
+				return -1;
+		}
+		switch (tx->bw_khz) {
+			case 125: txpkt->bandwidth = BW_125KHZ; break;
+			case 250: txpkt->bandwidth = BW_250KHZ; break;
+			case 500: txpkt->bandwidth = BW_500KHZ; break;
+			default:
+				log_msg("WARNING: [down] invalid BW in txpk, TX aborted\n");
+				return -1;
+		}
+		switch (tx->codr) {
+			case 5: txpkt->coderate = CR_LORA_4_5; break;
+			case 6: txpkt->coderate = CR_LORA_4_6; break;
+			case 7: txpkt->coderate = CR_LORA_4_7; break;
+			case 8: txpkt->coderate = CR_LORA_4_8; break;
+			default:
+				log_msg("WARNING: [down] invalid coding rate in txpk, TX aborted\n");
+				return -1;
+		}
+		txpkt->invert_pol = tx->ipol;
+		if (tx->prea == 0) {
+			txpkt->preamble = (uint16_t)STD_LORA_PREAMB;
+		} else {
+			txpkt->preamble = (tx->prea >= MIN_LORA_PREAMB) ? tx->prea : (uint16_t)MIN_LORA_PREAMB;
+		}
+	} else {
+		txpkt->modulation = MOD_FSK;
+		txpkt->datarate = tx->datr;
+		txpkt->f_dev = (uint8_t)(tx->fdev_hz / 1000); /* value in Hz, txpkt.f_dev in kHz */
+		if (tx->prea == 0) {
+			txpkt->preamble = (uint16_t)STD_FSK_PREAMB;
+		} else {
+			txpkt->preamble = (tx->prea >= MIN_FSK_PREAMB) ? tx->prea : (uint16_t)MIN_FSK_PREAMB;
+		}
+	}
+	
+	txpkt->size = tx->size;
+	if (tx->payload != txpkt->payload) {
+		memcpy((void *)txpkt->payload, (void *)tx->payload, tx->size);
+	}
+	return 0;
+}
+
+/* date the concentrator counter with a packet received over the air since the given monotonic time */
+static void cnt_ref_update(uint32_t count_us, const struct timespec *since) {
+	pthread_mutex_lock(&mx_cntref);
+	cnt_ref_count = count_us;
+	cnt_ref_time = *since; /* the earliest the packet can have ended, so that the estimate is never behind */
+	cnt_ref_valid = true;
+	pthread_mutex_unlock(&mx_cntref);
+}
+
+/* estimate the current value of the concentrator counter, kept ahead by the clock drift, false if no recent packet dates it */
+static bool cnt_now(uint32_t *count_us) {
+	struct timespec now;
+	double age;
+	bool valid;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	pthread_mutex_lock(&mx_cntref);
+	valid = cnt_ref_valid;
+	age = difftimespec(now, cnt_ref_time);
+	*count_us = cnt_ref_count + (uint32_t)(1e6 * age * (1 + 1e-6 * CNT_DRIFT_PPM));
+	pthread_mutex_unlock(&mx_cntref);
+	return valid && (age < CNT_REF_MAX_S);
+}
+
+/* charge a downlink to the budget of its sub-band, the beacon may use the airtime reserved for it */
+static enum duty_verdict downlink_duty(const struct lgw_pkt_tx_s *pkt, bool beacon) {
+	enum duty_verdict v;
+	struct timespec now;
+	
+	if (gtw_conf.duty_cycle == NULL) {
+		return DUTY_OK;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	pthread_mutex_lock(&mx_duty);
+	v = duty_take(gtw_conf.duty_cycle, pkt->freq_hz, airtime_tx(pkt), beacon, (uint32_t)now.tv_sec);
+	pthread_mutex_unlock(&mx_duty);
+	return v;
+}
+
+/* give back the airtime of a downlink refused by the JIT queue, replaced in it by another, dropped or failed */
+static void downlink_refund(const struct lgw_pkt_tx_s *pkt, bool beacon) {
+	struct timespec now;
+	
+	if (gtw_conf.duty_cycle == NULL) {
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	pthread_mutex_lock(&mx_duty);
+	duty_release(gtw_conf.duty_cycle, pkt->freq_hz, airtime_tx(pkt), beacon, (uint32_t)now.tv_sec);
+	pthread_mutex_unlock(&mx_duty);
+}
+
+/* queue a downlink for the dispatcher, a packet to send immediately stays so and is given the first hole of the queue for the collision checks */
+static enum jit_error downlink_queue(struct lgw_pkt_tx_s *pkt, enum jit_class cls, unsigned *preempted) {
+	enum jit_error err;
+	uint32_t now_us, start_us, toa_us;
+	struct lgw_pkt_tx_s evicted[JIT_QUEUE_SIZE]; /* packets of lower priority replaced by this one */
+	unsigned i;
+	
+	toa_us = airtime_tx(pkt);
+	pthread_mutex_lock(&mx_jit);
+	cnt_now(&now_us);
+	if (pkt->tx_mode == IMMEDIATE) {
+		start_us = jit_gap(&jit_queue, now_us + 1000 * gtw_conf.jit_lead_ms, toa_us);
+	} else {
+		start_us = pkt->count_us;
+	}
+	err = jit_enqueue(&jit_queue, pkt, cls, start_us, toa_us, now_us, evicted, preempted);
+	if (err == JIT_OK) {
+		pthread_cond_signal(&cv_jit);
+	}
+	pthread_mutex_unlock(&mx_jit);
+	for (i = 0; (err == JIT_OK) && (i < *preempted); ++i) {
+		downlink_refund(&evicted[i], false); /* never a beacon, nothing has a higher priority */
+	}
+	return err;
+}
+
+/* load a downlink in the concentrator, unless the previous one has not left or it starts too soon */
+static enum load_result downlink_load(const struct lgw_pkt_tx_s *pkt) {
+	enum load_result res;
+	uint32_t now_us;
+	uint8_t tx_status;
+	
+	pthread_mutex_lock(&mx_concent); /* may have to wait for a fetch to finish */
+	if (lgw_status(TX_STATUS, &tx_status) == LGW_HAL_ERROR) {
+		tx_status = TX_STATUS_UNKNOWN;
+	}
+	if ((tx_status == TX_SCHEDULED) || (tx_status == TX_EMITTING)) {
+		res = LOAD_BUSY;
+	} else if ((pkt->tx_mode == TIMESTAMPED) && cnt_now(&now_us) && ((int32_t)(pkt->count_us - now_us) < JIT_MARGIN_US)) {
+		res = LOAD_LATE;
+	} else {
+		res = (lgw_send(*pkt) == LGW_HAL_ERROR) ? LOAD_FAIL : LOAD_OK;
+	}
+	pthread_mutex_unlock(&mx_concent); /* free concentrator ASAP */
+	return res;
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- MAIN FUNCTION -------------------------------------------------------- */
 
@@ -217,10 +1633,13 @@ int main(int argc, char **argv)
 	char *debug_cfg_path = "debug_conf.json"; /* if present, all other configuration files are ignored */
 	
 	/* threads */
+	pthread_t thrid_fetch;
 	pthread_t thrid_up;
+	pthread_t thrid_ack[MAX_SERVERS];
 	pthread_t thrid_down[MAX_SERVERS];
 	pthread_t thrid_gps;
 	pthread_t thrid_valid;
+	pthread_t thrid_jit;
 	pthread_t thrid_connect[MAX_SERVERS];
 
 	/* variables to get local copies of measurements */
@@ -228,11 +1647,46 @@ int main(int argc, char **argv)
 	uint32_t cp_nb_rx_ok;
 	uint32_t cp_nb_rx_bad;
 	uint32_t cp_nb_rx_nocrc;
+	uint32_t cp_nb_rx_drop;
+	uint32_t cp_nb_rx_dup;
+	uint32_t cp_nb_rx_flt_data;
+	uint32_t cp_nb_rx_flt_join;
+	uint32_t cp_nb_rx_flt_other;
+	uint32_t cp_nb_rx_unrouted;
+	uint32_t cp_nb_rx_shed[3];
+	int depth_p99;
+	float depth_mean;
+	uint32_t depth_nb; /* nb of fetches in the depth histogram */
+	struct linkq cp_link = {0}; /* totals of the link table, its entries are not copied */
+	struct linkq_dev link_worst[LINKQ_TOP]; /* devices with the highest loss */
+	int link_nb_worst = 0, link_sf, sf;
+	float link_loss = 0.0;
+	char link_stat[48] = ""; /* link table fields of the status report */
 	uint32_t cp_up_pkt_fwd;
 	uint32_t cp_up_network_byte;
 	uint32_t cp_up_payload_byte;
 	uint32_t cp_up_dgram_sent;
 	uint32_t cp_up_ack_rcv;
+	uint32_t cp_up_ack_lost;
+	uint32_t cp_up_dgram_saved;
+	uint32_t cp_up_byte_saved;
+	uint32_t cp_up_journal_replay;
+	uint32_t cp_up_journal_lost;
+	uint32_t cp_up_retx;
+	uint32_t cp_up_retx_byte;
+	uint32_t cp_up_retx_expired;
+	char rtt_pct[3][16]; /* RTT percentiles, as text */
+	int srtt_ms, rto_ms;
+	uint32_t cp_fetch_nb;
+	uint32_t cp_fetch_full;
+	uint32_t cp_fetch_empty;
+	uint32_t cp_fetch_busy_us;
+	uint32_t cp_fetch_idle_us;
+	float rx_busy[MEAS_IF_CHAIN_NB]; /* fraction of the time each IF chain was receiving */
+	char rx_busy_txt[MEAS_IF_CHAIN_NB * 12]; /* same, as text for the report */
+	char busy_stat[MEAS_IF_CHAIN_NB * 6 + 32]; /* channel occupancy fields of the status report */
+	int stat_len; /* length of the status report */
+	int busy_len, txt_len;
 	uint32_t cp_dw_pull_sent;
 	uint32_t cp_dw_ack_rcv;
 	uint32_t cp_dw_dgram_rcv;
@@ -240,6 +1694,20 @@ int main(int argc, char **argv)
 	uint32_t cp_dw_payload_byte;
 	uint32_t cp_nb_tx_ok;
 	uint32_t cp_nb_tx_fail;
+	uint32_t cp_nb_tx_late;
+	char slack_pct[3][16]; /* percentiles of the downlink slack, as text */
+	size_t arena_peak; /* most memory a PULL_RESP was parsed in, since the start */
+	unsigned arena_fallback; /* allocations that did not fit in the arenas, since the start */
+	uint32_t cp_dw_jit_queued;
+	uint32_t cp_dw_jit_refused[JIT_NB_ERROR]; /* per jit_error, JIT_OK unused */
+	uint32_t cp_dw_jit_preempted;
+	float tx_busy; /* fraction of the time the concentrator was emitting */
+	uint32_t cp_dw_duty_refused[DUTY_NB_VERDICT]; /* per duty_verdict, DUTY_OK unused */
+	uint64_t duty_left[DUTY_BAND_MAX]; /* airtime left in each sub-band, in us */
+	struct duty_band *band;
+	struct meas_snap meas_now; /* sum of the counters of all threads */
+	struct meas_snap meas_prev = {{0}}; /* same, at the previous report */
+	struct meas_snap meas_int; /* difference, ie. counts of the reporting interval */
 	
 	/* GPS coordinates variables */
 	bool coord_ok = false;
@@ -247,6 +1715,8 @@ int main(int argc, char **argv)
 	//struct coord_s cp_gps_err;
 	
 	/* statistics variable */
+	struct timespec stat_start; /* beginning of the reporting interval */
+	struct timespec stat_now;
 	time_t t;
 	char stat_timestamp[24];
 	float rx_ok_ratio;
@@ -254,6 +1724,9 @@ int main(int argc, char **argv)
 	float rx_nocrc_ratio;
 	float up_ack_ratio;
 	float dw_ack_ratio;
+	float fetch_duty; /* fraction of the time the fetch thread is not waiting */
+	float fetch_rate; /* fetches per second */
+	double stat_span; /* length of the reporting interval, in seconds */
 
 	int c;
 
@@ -306,30 +1779,35 @@ int main(int argc, char **argv)
 		log_msg("INFO: Host endianness unknown\n");
 	#endif
 	
-	/* load configuration files */
+	/* load configuration files, parsed in an arena released once they are loaded */
+	arena_install();
+	if (arena_init(&conf_arena, ARENA_CONF_SIZE) != 0) {
+		log_msg("ERROR: [main] failed to allocate the %u bytes to parse the configuration in\n", ARENA_CONF_SIZE);
+		exit(EXIT_FAILURE);
+	}
+	arena_use(&conf_arena);
 	if (access(debug_cfg_path, R_OK) == 0) { /* if there is a debug conf, parse only the debug conf */
 		log_msg("INFO: found debug configuration file %s, parsing it\n", debug_cfg_path);
 		log_msg("INFO: other configuration files will be ignored\n");
-		parse_SX1301_configuration(debug_cfg_path);
-		parse_gateway_configuration(debug_cfg_path, &gtw_conf);
+		parse_configuration(debug_cfg_path);
 	} else if (access(global_cfg_path, R_OK) == 0) { /* if there is a global conf, parse it and then try to parse local conf  */
 		log_msg("INFO: found global configuration file %s, parsing it\n", global_cfg_path);
-		parse_SX1301_configuration(global_cfg_path);
-		parse_gateway_configuration(global_cfg_path, &gtw_conf);
+		parse_configuration(global_cfg_path);
 		if (access(local_cfg_path, R_OK) == 0) {
 			log_msg("INFO: found local configuration file %s, parsing it\n", local_cfg_path);
 			log_msg("INFO: redefined parameters will overwrite global parameters\n");
-			parse_SX1301_configuration(local_cfg_path);
-			parse_gateway_configuration(local_cfg_path, &gtw_conf);
+			parse_configuration(local_cfg_path);
 		}
 	} else if (access(local_cfg_path, R_OK) == 0) { /* if there is only a local conf, parse it and that's all */
 		log_msg("INFO: found local configuration file %s, parsing it\n", local_cfg_path);
-		parse_SX1301_configuration(local_cfg_path);
-		parse_gateway_configuration(local_cfg_path, &gtw_conf);
+		parse_configuration(local_cfg_path);
 	} else {
 		log_msg("ERROR: [main] failed to find any configuration file named %s, %s OR %s\n", global_cfg_path, local_cfg_path, debug_cfg_path);
 		exit(EXIT_FAILURE);
 	}
+	arena_use(NULL);
+	log_msg("INFO: configuration parsed in %u bytes (%u allocations passed to malloc)\n", (unsigned)conf_arena.peak, conf_arena.nb_fallback);
+	arena_free(&conf_arena);
 	
 	/* Start GPS a.s.a.p., to allow it to lock */
 	if (gtw_conf.gps_enabled == true) {
@@ -350,12 +1828,27 @@ int main(int argc, char **argv)
 		}
 	}
 	
-	/* get timezone info */
-	tzset();
-	
 	/* sanity check on configuration variables */
 	// TODO
 	
+	/* load the LoRaWAN network filter */
+	if (gtw_conf.filter_file[0] != 0) {
+		rx_filter = filter_load(gtw_conf.filter_file);
+		if (rx_filter == NULL) {
+			log_msg("ERROR: [main] failed to load filter file %s\n", gtw_conf.filter_file);
+			exit(EXIT_FAILURE);
+		}
+	}
+	
+	/* allocate the link quality table */
+	if ((gtw_conf.link_table_size > 0) && (linkq_init(&link_table, gtw_conf.link_table_size) != 0)) {
+		log_msg("ERROR: [main] failed to allocate the link table of %u devices\n", gtw_conf.link_table_size);
+		exit(EXIT_FAILURE);
+	}
+	
+	/* time on air tables, shared by the uplink and downlink threads */
+	airtime_init();
+	
 	/* process some of the configuration variables */
 	net_mac_h = htonl((uint32_t)(0xFFFFFFFF & (gtw_conf.lgwm>>32)));
 	net_mac_l = htonl((uint32_t)(0xFFFFFFFF &  gtw_conf.lgwm  ));
@@ -403,6 +1896,21 @@ int main(int argc, char **argv)
 	
 	/* spawn threads to manage upstream and downstream */
 	if (gtw_conf.upstream_enabled == true) {
+		rx_ring_init(&rx_ring);
+		i = pthread_create( &thrid_fetch, NULL, thread_fetch, NULL);
+		if (i != 0) {
+			log_msg("ERROR: [main] impossible to create fetch thread\n");
+			exit(EXIT_FAILURE);
+		}
+		/* the in-flight tables are ready before the upstream thread may send (or replay the journal) */
+		for (ic = 0; ic < gtw_conf.serv_count; ic++) {
+			inflight_init(&push_inflight[ic], gtw_conf.push_timeout_half.tv_usec / 500, gtw_conf.push_retx_max, gtw_conf.push_retx_rate);
+			i = pthread_create( &thrid_ack[ic], NULL, thread_ack, (void *) (long) ic);
+			if (i != 0) {
+				log_msg("ERROR: [main] impossible to create upstream ACK thread\n");
+				exit(EXIT_FAILURE);
+			}
+		}
 		i = pthread_create( &thrid_up, NULL, (void * (*)(void *))thread_up, NULL);
 		if (i != 0) {
 			log_msg("ERROR: [main] impossible to create upstream thread\n");
@@ -410,7 +1918,18 @@ int main(int argc, char **argv)
 		}
 	}
 	if (gtw_conf.downstream_enabled == true) {
+		/* the counter estimate may be ahead by a fetch period and the end of a packet is polled every ms before the next is loaded */
+		jit_init(&jit_queue, JIT_MARGIN_US + 1000 * (gtw_conf.fetch_sleep_max_ms + 1));
+		i = pthread_create( &thrid_jit, NULL, thread_jit, NULL);
+		if (i != 0) {
+			log_msg("ERROR: [main] impossible to create JIT thread\n");
+			exit(EXIT_FAILURE);
+		}
 		for (ic = 0; ic < gtw_conf.serv_count; ic++) if (gtw_conf.serv_enable[ic] == true) {
+			if (arena_init(&down_arena[ic], ARENA_DOWN_SIZE) != 0) {
+				log_msg("ERROR: [main] failed to allocate the %u bytes to parse the downlinks in\n", ARENA_DOWN_SIZE);
+				exit(EXIT_FAILURE);
+			}
 			i = pthread_create( &thrid_down[ic], NULL, (void * (*)(void *))thread_down, (void *) (long) ic);
 			if (i != 0) {
 				log_msg("ERROR: [main] impossible to create downstream thread\n");
@@ -440,6 +1959,7 @@ int main(int argc, char **argv)
 	sigaction(SIGQUIT, &sigact, NULL); /* Ctrl-\ */
 	sigaction(SIGINT, &sigact, NULL); /* Ctrl-C */
 	sigaction(SIGTERM, &sigact, NULL); /* default "kill" command */
+	sigaction(SIGHUP, &sigact, NULL); /* reload the filter file */
 
 	/* Start the ghost Listener */
     if (gtw_conf.ghoststream_enabled == true) {
@@ -460,34 +1980,62 @@ int main(int argc, char **argv)
 
 	/* main loop task : statistics collection */
 	while (!exit_sig && !quit_sig) {
-		/* wait for next reporting interval */
-		wait_ms(1000 * gtw_conf.stat_interval);
+		/* wait for next reporting interval, reloading the filter file on SIGHUP */
+		clock_gettime(CLOCK_MONOTONIC, &stat_start);
+		do {
+			wait_ms(STAT_WAIT_MS);
+			if (reload_sig) {
+				reload_sig = false;
+				filter_reload();
+			}
+			clock_gettime(CLOCK_MONOTONIC, &stat_now);
+		} while (!exit_sig && !quit_sig && (difftimespec(stat_now, stat_start) < gtw_conf.stat_interval));
 		
 		/* get timestamp for statistics */
 		t = time(NULL);
 		strftime(stat_timestamp, sizeof stat_timestamp, "%F %T %Z", gmtime(&t));
 		
-		/* access upstream statistics, copy and reset them */
-		pthread_mutex_lock(&mx_meas_up);
-		cp_nb_rx_rcv       = meas_nb_rx_rcv;
-		cp_nb_rx_ok        = meas_nb_rx_ok;
-		cp_nb_rx_bad       = meas_nb_rx_bad;
-		cp_nb_rx_nocrc     = meas_nb_rx_nocrc;
-		cp_up_pkt_fwd      = meas_up_pkt_fwd;
-		cp_up_network_byte = meas_up_network_byte;
-		cp_up_payload_byte = meas_up_payload_byte;
-		cp_up_dgram_sent   = meas_up_dgram_sent;
-		cp_up_ack_rcv      = meas_up_ack_rcv;
-		meas_nb_rx_rcv = 0;
-		meas_nb_rx_ok = 0;
-		meas_nb_rx_bad = 0;
-		meas_nb_rx_nocrc = 0;
-		meas_up_pkt_fwd = 0;
-		meas_up_network_byte = 0;
-		meas_up_payload_byte = 0;
-		meas_up_dgram_sent = 0;
-		meas_up_ack_rcv = 0;
-		pthread_mutex_unlock(&mx_meas_up);
+		/* take a snapshot of all counters, the interval counts are the difference with the previous one */
+		meas_snapshot(&meas_now);
+		meas_delta(&meas_now, &meas_prev, &meas_int);
+		meas_prev = meas_now;
+		stat_span = difftimespec(stat_now, stat_start);
+		
+		/* upstream statistics */
+		cp_nb_rx_rcv         = meas_int.val[MEAS_NB_RX_RCV];
+		cp_nb_rx_ok          = meas_int.val[MEAS_NB_RX_OK];
+		cp_nb_rx_bad         = meas_int.val[MEAS_NB_RX_BAD];
+		cp_nb_rx_nocrc       = meas_int.val[MEAS_NB_RX_NOCRC];
+		cp_nb_rx_drop        = meas_int.val[MEAS_NB_RX_DROP];
+		cp_nb_rx_dup         = meas_int.val[MEAS_NB_RX_DUP];
+		cp_nb_rx_shed[0]     = meas_int.val[MEAS_NB_RX_SHED_BAD];
+		cp_nb_rx_shed[1]     = meas_int.val[MEAS_NB_RX_SHED_DUP];
+		cp_nb_rx_shed[2]     = meas_int.val[MEAS_NB_RX_SHED_UNCONF];
+		cp_nb_rx_flt_data    = meas_int.val[MEAS_NB_RX_FLT_DATA];
+		cp_nb_rx_flt_join    = meas_int.val[MEAS_NB_RX_FLT_JOIN];
+		cp_nb_rx_flt_other   = meas_int.val[MEAS_NB_RX_FLT_OTHER];
+		cp_nb_rx_unrouted    = meas_int.val[MEAS_NB_RX_UNROUTED];
+		cp_up_pkt_fwd        = meas_int.val[MEAS_UP_PKT_FWD];
+		cp_up_network_byte   = meas_int.val[MEAS_UP_NETWORK_BYTE];
+		cp_up_payload_byte   = meas_int.val[MEAS_UP_PAYLOAD_BYTE];
+		cp_up_dgram_sent     = meas_int.val[MEAS_UP_DGRAM_SENT];
+		cp_up_ack_rcv        = meas_int.val[MEAS_UP_ACK_RCV];
+		cp_up_ack_lost       = meas_int.val[MEAS_UP_ACK_LOST];
+		cp_up_dgram_saved    = meas_int.val[MEAS_UP_DGRAM_SAVED];
+		cp_up_byte_saved     = meas_int.val[MEAS_UP_BYTE_SAVED];
+		cp_up_journal_replay = meas_int.val[MEAS_UP_JOURNAL_REPLAY];
+		cp_up_journal_lost   = meas_int.val[MEAS_UP_JOURNAL_LOST];
+		cp_up_retx           = meas_int.val[MEAS_UP_RETX];
+		cp_up_retx_byte      = meas_int.val[MEAS_UP_RETX_BYTE];
+		cp_up_retx_expired   = meas_int.val[MEAS_UP_RETX_EXPIRED];
+		hist_format(&meas_int.val[MEAS_UP_RTT], MEAS_RTT_BINS, 50, rtt_pct[0]);
+		hist_format(&meas_int.val[MEAS_UP_RTT], MEAS_RTT_BINS, 90, rtt_pct[1]);
+		hist_format(&meas_int.val[MEAS_UP_RTT], MEAS_RTT_BINS, 99, rtt_pct[2]);
+		cp_fetch_nb          = meas_int.val[MEAS_FETCH_NB];
+		cp_fetch_full        = meas_int.val[MEAS_FETCH_FULL];
+		cp_fetch_empty       = meas_int.val[MEAS_FETCH_EMPTY];
+		cp_fetch_busy_us     = meas_int.val[MEAS_FETCH_BUSY_US];
+		cp_fetch_idle_us     = meas_int.val[MEAS_FETCH_IDLE_US];
 		if (cp_nb_rx_rcv > 0) {
 			rx_ok_ratio = (float)cp_nb_rx_ok / (float)cp_nb_rx_rcv;
 			rx_bad_ratio = (float)cp_nb_rx_bad / (float)cp_nb_rx_rcv;
@@ -502,24 +2050,79 @@ int main(int argc, char **argv)
 		} else {
 			up_ack_ratio = 0.0;
 		}
+		depth_p99 = meas_hist_pct(&meas_int.val[MEAS_FETCH_DEPTH], MEAS_DEPTH_BINS, 99);
+		depth_mean = 0.0;
+		for (i = 0, depth_nb = 0; i < MEAS_DEPTH_BINS; i++) {
+			depth_mean += (float)i * meas_int.val[MEAS_FETCH_DEPTH + i];
+			depth_nb += meas_int.val[MEAS_FETCH_DEPTH + i];
+		}
+		if (depth_nb > 0) {
+			depth_mean /= depth_nb;
+		}
+		if (link_table.capacity > 0) {
+			pthread_mutex_lock(&mx_linkq);
+			cp_link = link_table;
+			link_nb_worst = linkq_worst(&link_table, link_worst, LINKQ_TOP, LINKQ_TOP_MIN_RX);
+			pthread_mutex_unlock(&mx_linkq);
+			link_loss = (cp_link.nb_rx > 0) ? ((float)cp_link.nb_lost / (float)(cp_link.nb_lost + cp_link.nb_rx)) : 0.0;
+			snprintf(link_stat, sizeof link_stat, ",\"ldev\":%u,\"lost\":%.1f", cp_link.nb_dev, 100.0 * link_loss);
+		}
+		if ((cp_fetch_busy_us + cp_fetch_idle_us) > 0) {
+			fetch_duty = (float)cp_fetch_busy_us / (float)(cp_fetch_busy_us + cp_fetch_idle_us);
+			fetch_rate = 1e6 * (float)cp_fetch_nb / (float)(cp_fetch_busy_us + cp_fetch_idle_us);
+		} else {
+			fetch_duty = 0.0;
+			fetch_rate = 0.0;
+		}
+		busy_len = snprintf(busy_stat, sizeof busy_stat, ",\"rxbusy\":[");
+		for (i = 0, txt_len = 0; i < MEAS_IF_CHAIN_NB; i++) {
+			rx_busy[i] = (stat_span > 0.0) ? (float)(1e-6 * meas_int.val[MEAS_RX_BUSY_US + i] / stat_span) : 0.0;
+			if (meas_int.val[MEAS_RX_BUSY_US + i] > 0) {
+				txt_len += snprintf(rx_busy_txt + txt_len, sizeof rx_busy_txt - txt_len, " IF%i %.2f%%", i, 100.0 * rx_busy[i]);
+			}
+			busy_len += snprintf(busy_stat + busy_len, sizeof busy_stat - busy_len, "%s%.1f", (i > 0) ? "," : "", 100.0 * rx_busy[i]);
+		}
+		if (txt_len == 0) {
+			snprintf(rx_busy_txt, sizeof rx_busy_txt, " none");
+		}
 		
-		/* access downstream statistics, copy and reset them */
-		pthread_mutex_lock(&mx_meas_dw);
-		cp_dw_pull_sent    =  meas_dw_pull_sent;
-		cp_dw_ack_rcv      =  meas_dw_ack_rcv;
-		cp_dw_dgram_rcv    =  meas_dw_dgram_rcv;
-		cp_dw_network_byte =  meas_dw_network_byte;
-		cp_dw_payload_byte =  meas_dw_payload_byte;
-		cp_nb_tx_ok        =  meas_nb_tx_ok;
-		cp_nb_tx_fail      =  meas_nb_tx_fail;
-		meas_dw_pull_sent = 0;
-		meas_dw_ack_rcv = 0;
-		meas_dw_dgram_rcv = 0;
-		meas_dw_network_byte = 0;
-		meas_dw_payload_byte = 0;
-		meas_nb_tx_ok = 0;
-		meas_nb_tx_fail = 0;
-		pthread_mutex_unlock(&mx_meas_dw);
+		/* downstream statistics */
+		cp_dw_pull_sent      = meas_int.val[MEAS_DW_PULL_SENT];
+		cp_dw_ack_rcv        = meas_int.val[MEAS_DW_ACK_RCV];
+		cp_dw_dgram_rcv      = meas_int.val[MEAS_DW_DGRAM_RCV];
+		cp_dw_network_byte   = meas_int.val[MEAS_DW_NETWORK_BYTE];
+		cp_dw_payload_byte   = meas_int.val[MEAS_DW_PAYLOAD_BYTE];
+		cp_nb_tx_ok          = meas_int.val[MEAS_NB_TX_OK];
+		cp_nb_tx_fail        = meas_int.val[MEAS_NB_TX_FAIL];
+		cp_nb_tx_late        = meas_int.val[MEAS_NB_TX_LATE];
+		hist_format(&meas_int.val[MEAS_DW_SLACK], MEAS_SLACK_BINS, 1, slack_pct[0]);
+		hist_format(&meas_int.val[MEAS_DW_SLACK], MEAS_SLACK_BINS, 10, slack_pct[1]);
+		hist_format(&meas_int.val[MEAS_DW_SLACK], MEAS_SLACK_BINS, 50, slack_pct[2]);
+		arena_peak = 0;
+		arena_fallback = 0;
+		for (ic = 0; ic < gtw_conf.serv_count; ic++) {
+			size_t peak = __atomic_load_n(&down_arena[ic].peak, __ATOMIC_RELAXED);
+			if (peak > arena_peak) arena_peak = peak;
+			arena_fallback += __atomic_load_n(&down_arena[ic].nb_fallback, __ATOMIC_RELAXED);
+		}
+		cp_dw_jit_queued     = meas_int.val[MEAS_DW_JIT_QUEUED];
+		for (i = JIT_TOO_LATE; i < JIT_NB_ERROR; i++) {
+			cp_dw_jit_refused[i] = meas_int.val[MEAS_DW_JIT_LATE + i - JIT_TOO_LATE];
+		}
+		cp_dw_jit_preempted  = meas_int.val[MEAS_DW_JIT_PREEMPTED];
+		for (i = DUTY_DWELL; i < DUTY_NB_VERDICT; i++) {
+			cp_dw_duty_refused[i] = meas_int.val[MEAS_DW_DUTY_DWELL + i - DUTY_DWELL];
+		}
+		if (gtw_conf.duty_cycle != NULL) {
+			clock_gettime(CLOCK_MONOTONIC, &stat_now);
+			pthread_mutex_lock(&mx_duty);
+			for (i = 0; i < gtw_conf.duty_cycle->nb_band; i++) {
+				duty_left[i] = duty_remaining(gtw_conf.duty_cycle, i, (uint32_t)stat_now.tv_sec);
+			}
+			pthread_mutex_unlock(&mx_duty);
+		}
+		tx_busy = (stat_span > 0.0) ? (float)(1e-6 * meas_int.val[MEAS_TX_BUSY_US] / stat_span) : 0.0;
+		snprintf(busy_stat + busy_len, sizeof busy_stat - busy_len, "],\"txbusy\":%.1f", 100.0 * tx_busy);
 		if (cp_dw_pull_sent > 0) {
 			dw_ack_ratio = (float)cp_dw_ack_rcv / (float)cp_dw_pull_sent;
 		} else {
@@ -547,14 +2150,69 @@ int main(int argc, char **argv)
 		log_msg("### [UPSTREAM] ###\n");
 		log_msg("# RF packets received by concentrator: %u\n", cp_nb_rx_rcv);
 		log_msg("# CRC_OK: %.2f%%, CRC_FAIL: %.2f%%, NO_CRC: %.2f%%\n", 100.0 * rx_ok_ratio, 100.0 * rx_bad_ratio, 100.0 * rx_nocrc_ratio);
+		log_msg("# RF packets dropped (upstream queue full): %u\n", cp_nb_rx_drop);
+		log_msg("# RF packets shed (upstream queue filling up): %u CRC error or no CRC, %u copies, %u unconfirmed\n", cp_nb_rx_shed[0], cp_nb_rx_shed[1], cp_nb_rx_shed[2]);
+		log_msg("# Upstream queue depth: mean %.1f, p99 %i of %i batches\n", depth_mean, (depth_p99 < 0) ? 0 : depth_p99, RX_RING_SIZE);
+		if (gtw_conf.dedup_window_ms > 0) {
+			log_msg("# RF packets dropped as duplicates: %u\n", cp_nb_rx_dup);
+		}
+		if (gtw_conf.filter_file[0] != 0) {
+			log_msg("# RF packets dropped by the network filter: %u data, %u join, %u other\n", cp_nb_rx_flt_data, cp_nb_rx_flt_join, cp_nb_rx_flt_other);
+		}
+		for (ic = 0; (ic < gtw_conf.serv_count) && (gtw_conf.serv_route[ic] == NULL); ic++);
+		if (ic < gtw_conf.serv_count) {
+			log_msg("# RF packets matching the route of no server: %u\n", cp_nb_rx_unrouted);
+		}
+		if (link_table.capacity > 0) {
+			log_msg("# Devices tracked: %u of %u (%u evicted), uplink loss %.2f%% (%u frames missing of %u)\n", cp_link.nb_dev, cp_link.capacity, cp_link.nb_evicted, 100.0 * link_loss, cp_link.nb_lost, cp_link.nb_lost + cp_link.nb_rx);
+			for (i = 0; i < link_nb_worst; i++) {
+				/* radio figures of the most used SF */
+				for (sf = 0, link_sf = 0; sf < LINKQ_NB_SF; sf++) {
+					if (link_worst[i].sf[sf].nb > link_worst[i].sf[link_sf].nb) link_sf = sf;
+				}
+				log_msg("# device %08X: loss %.2f%% of %u frames, SF%i RSSI %.1f dBm SNR %.1f dB\n", link_worst[i].devaddr, 100.0 * linkq_loss(&link_worst[i]), link_worst[i].nb_lost + link_worst[i].nb_rx, LINKQ_SF_MIN + link_sf, link_worst[i].sf[link_sf].rssi, link_worst[i].sf[link_sf].snr);
+			}
+		}
+		log_msg("# Channel occupancy:%s\n", rx_busy_txt);
+		log_msg("# Concentrator fetches: %u (%u full, %u empty), %.1f/s, fetch thread busy %.2f%%\n", cp_fetch_nb, cp_fetch_full, cp_fetch_empty, fetch_rate, 100.0 * fetch_duty);
 		log_msg("# RF packets forwarded: %u (%u bytes)\n", cp_up_pkt_fwd, cp_up_payload_byte);
 		log_msg("# PUSH_DATA datagrams sent: %u (%u bytes)\n", cp_up_dgram_sent, cp_up_network_byte);
-		log_msg("# PUSH_DATA acknowledged: %.2f%%\n", 100.0 * up_ack_ratio);
+		if (gtw_conf.aggr_hold_ms > 0) {
+			log_msg("# PUSH_DATA datagrams saved by aggregation: %u (%u bytes)\n", cp_up_dgram_saved, cp_up_byte_saved);
+		}
+		log_msg("# PUSH_DATA acknowledged: %.2f%% (%u evicted without ACK)\n", 100.0 * up_ack_ratio, cp_up_ack_lost);
+		if (gtw_conf.push_retx_max > 0) {
+			log_msg("# PUSH_DATA retransmitted: %u (%u bytes, %u still unacknowledged after %i retries)\n", cp_up_retx, cp_up_retx_byte, cp_up_retx_expired, gtw_conf.push_retx_max);
+		}
+		log_msg("# PUSH_ACK round-trip: p50 %s, p90 %s, p99 %s\n", rtt_pct[0], rtt_pct[1], rtt_pct[2]);
+		for (ic = 0; ic < gtw_conf.serv_count; ic++) {
+			inflight_rtt(&push_inflight[ic], &srtt_ms, &rto_ms);
+			if (srtt_ms >= 0) {
+				log_msg("# server %s: smoothed RTT %i ms, ACK time-out %i ms\n", gtw_conf.serv_addr[ic], srtt_ms, rto_ms);
+			}
+		}
+		if (gtw_conf.journal_path[0] != 0) {
+			log_msg("# PUSH_DATA replayed from the journal: %u (%u overwritten before delivery)\n", cp_up_journal_replay, cp_up_journal_lost);
+		}
 		log_msg("### [DOWNSTREAM] ###\n");
 		log_msg("# PULL_DATA sent: %u (%.2f%% acknowledged)\n", cp_dw_pull_sent, 100.0 * dw_ack_ratio);
 		log_msg("# PULL_RESP(onse) datagrams received: %u (%u bytes)\n", cp_dw_dgram_rcv, cp_dw_network_byte);
+		log_msg("# Time left before the TX start when received: p1 %s, p10 %s, p50 %s\n", slack_pct[0], slack_pct[1], slack_pct[2]);
+		log_msg("# Memory used to parse a PULL_RESP: peak %u of %u bytes (%u allocations passed to malloc)\n", (unsigned)arena_peak, ARENA_DOWN_SIZE, arena_fallback);
+		log_msg("# RF packets queued for TX: %u (%u replaced by a packet of higher priority)\n", cp_dw_jit_queued, cp_dw_jit_preempted);
+		log_msg("# RF packets refused: %u too late, %u too early, %u beacon collisions, %u collisions, %u queue full\n", cp_dw_jit_refused[JIT_TOO_LATE], cp_dw_jit_refused[JIT_TOO_EARLY], cp_dw_jit_refused[JIT_COLLISION_BEACON], cp_dw_jit_refused[JIT_COLLISION], cp_dw_jit_refused[JIT_FULL]);
 		log_msg("# RF packets sent to concentrator: %u (%u bytes)\n", (cp_nb_tx_ok+cp_nb_tx_fail), cp_dw_payload_byte);
-		log_msg("# TX errors: %u\n", cp_nb_tx_fail);
+		log_msg("# TX errors: %u (%u dropped, too late to be loaded)\n", cp_nb_tx_fail, cp_nb_tx_late);
+		log_msg("# Time spent emitting: %.2f%%\n", 100.0 * tx_busy);
+		if (gtw_conf.duty_cycle != NULL) {
+			log_msg("# RF packets refused for their sub-band: %u longer than the dwell time, %u over the duty-cycle budget\n", cp_dw_duty_refused[DUTY_DWELL], cp_dw_duty_refused[DUTY_BUDGET]);
+			for (i = 0; i < gtw_conf.duty_cycle->nb_band; i++) {
+				band = &gtw_conf.duty_cycle->band[i];
+				if (band->budget_us > 0) {
+					log_msg("# sub-band %.3f-%.3f MHz: %.1f s of airtime left of %.1f s per %u s (%.1f s kept for the beacon)\n", 1e-6 * band->freq_min, 1e-6 * band->freq_max, 1e-6 * duty_left[i], 1e-6 * band->budget_us, gtw_conf.duty_cycle->window_s, 1e-6 * band->reserve_us);
+				}
+			}
+		}
 		log_msg("### [GPS] ###\n");
 		//TODO: this is not symmetrical. time can also be derived from other sources, fix
 		if (gtw_conf.gps_enabled == true) {
@@ -579,12 +2237,24 @@ int main(int argc, char **argv)
 		/* generate a JSON report (will be sent to server by upstream thread) */
 		if (gtw_conf.statusstream_enabled == true) {
 			pthread_mutex_lock(&mx_stat_rep);
-			if ((gtw_conf.gps_enabled == true) && (coord_ok == true)) {
-				snprintf(status_report, STATUS_SIZE, "\"stat\":{\"time\":\"%s\",\"lati\":%.5f,\"long\":%.5f,\"alti\":%i,\"rxnb\":%u,\"rxok\":%u,\"rxfw\":%u,\"ackr\":%.1f,\"dwnb\":%u,\"txnb\":%u,\"pfrm\":\"%s\",\"mail\":\"%s\",\"desc\":\"%s\"}", stat_timestamp, cp_gps_coord.lat, cp_gps_coord.lon, cp_gps_coord.alt, cp_nb_rx_rcv, cp_nb_rx_ok, cp_up_pkt_fwd, 100.0 * up_ack_ratio, cp_dw_dgram_rcv, cp_nb_tx_ok,gtw_conf.platform,gtw_conf.email,gtw_conf.description);
-			} else {
-				snprintf(status_report, STATUS_SIZE, "\"stat\":{\"time\":\"%s\",\"rxnb\":%u,\"rxok\":%u,\"rxfw\":%u,\"ackr\":%.1f,\"dwnb\":%u,\"txnb\":%u,\"pfrm\":\"%s\",\"mail\":\"%s\",\"desc\":\"%s\"}", stat_timestamp, cp_nb_rx_rcv, cp_nb_rx_ok, cp_up_pkt_fwd, 100.0 * up_ack_ratio, cp_dw_dgram_rcv, cp_nb_tx_ok,gtw_conf.platform,gtw_conf.email,gtw_conf.description);
+			for (;;) {
+				if ((gtw_conf.gps_enabled == true) && (coord_ok == true)) {
+					stat_len = snprintf(status_report, STATUS_SIZE, "\"stat\":{\"time\":\"%s\",\"lati\":%.5f,\"long\":%.5f,\"alti\":%i,\"rxnb\":%u,\"rxok\":%u,\"rxfw\":%u,\"ackr\":%.1f,\"dwnb\":%u,\"txnb\":%u,\"pfrm\":\"%s\",\"mail\":\"%s\",\"desc\":\"%s\"%s%s}", stat_timestamp, cp_gps_coord.lat, cp_gps_coord.lon, cp_gps_coord.alt, cp_nb_rx_rcv, cp_nb_rx_ok, cp_up_pkt_fwd, 100.0 * up_ack_ratio, cp_dw_dgram_rcv, cp_nb_tx_ok,gtw_conf.platform,gtw_conf.email,gtw_conf.description,link_stat,busy_stat);
+				} else {
+					stat_len = snprintf(status_report, STATUS_SIZE, "\"stat\":{\"time\":\"%s\",\"rxnb\":%u,\"rxok\":%u,\"rxfw\":%u,\"ackr\":%.1f,\"dwnb\":%u,\"txnb\":%u,\"pfrm\":\"%s\",\"mail\":\"%s\",\"desc\":\"%s\"%s%s}", stat_timestamp, cp_nb_rx_rcv, cp_nb_rx_ok, cp_up_pkt_fwd, 100.0 * up_ack_ratio, cp_dw_dgram_rcv, cp_nb_tx_ok,gtw_conf.platform,gtw_conf.email,gtw_conf.description,link_stat,busy_stat);
+				}
+				if ((stat_len >= 0) && (stat_len < STATUS_SIZE)) {
+					break;
+				}
+				if ((link_stat[0] == 0) && (busy_stat[0] == 0)) {
+					status_report[0] = 0; /* nothing sent rather than a truncated object */
+					break;
+				}
+				/* sent without the optional fields rather than truncated */
+				link_stat[0] = 0;
+				busy_stat[0] = 0;
 			}
-			report_ready = true;
+			report_ready = (status_report[0] != 0);
 			pthread_mutex_unlock(&mx_stat_rep);
 		}
 
@@ -598,12 +2268,19 @@ int main(int argc, char **argv)
 		pthread_mutex_unlock(&mx_concent);
 	}
 	
-	/* wait for upstream thread to finish (1 fetch cycle max) */
-	if (gtw_conf.upstream_enabled == true) pthread_join(thrid_up, NULL);
+	/* wait for fetch and upstream threads to finish (1 fetch cycle max) */
+	if (gtw_conf.upstream_enabled == true) {
+		pthread_join(thrid_fetch, NULL);
+		pthread_join(thrid_up, NULL);
+		for (ic = 0; ic < gtw_conf.serv_count; ic++) {
+			pthread_cancel(thrid_ack[ic]); /* don't wait for ACK threads */
+		}
+	}
 	if (gtw_conf.downstream_enabled == true) {
 		for (ic = 0; ic < gtw_conf.serv_count; ic++)
 			if (gtw_conf.serv_live[ic] == true)
 				pthread_join(thrid_down[ic], NULL);
+		pthread_join(thrid_jit, NULL);
 	}
 	if (gtw_conf.ghoststream_enabled == true) ghost_stop();
 	if (gtw_conf.monitor_enabled == true) monitor_stop();
@@ -690,6 +2367,9 @@ void thread_connect(void *pic) {
 			log_msg("ERROR: [up] connect on address %s (port %s) returned: %s\n", gtw_conf.serv_addr[ic], gtw_conf.serv_port_down[ic], strerror(errno));
 			continue;
 		}
+		if (pmtu_enable(sock_up[ic]) != 0) {
+			log_msg("WARNING: [up] path MTU discovery not available for server %s: %s\n", gtw_conf.serv_addr[ic], strerror(errno));
+		}
 		freeaddrinfo(result);
 
 		/* look for server address w/ downstream port */
@@ -714,104 +2394,250 @@ void thread_connect(void *pic) {
 				log_msg("INFO: [down] result %i host:%s service:%s\n", i, host_name, port_name);
 				++i;
 			}
-			shutdown(sock_up[ic], SHUT_RDWR);
-			continue;
+			shutdown(sock_up[ic], SHUT_RDWR);
+			continue;
+		}
+
+		/* connect so we can send/receive packet with the server only */
+		i = connect(sock_down[ic], q->ai_addr, q->ai_addrlen);
+		if (i != 0) {
+			log_msg("ERROR: [down] connect address %s (port %s) returned: %s\n", gtw_conf.serv_addr[ic], gtw_conf.serv_port_down[ic], strerror(errno));
+			shutdown(sock_up[ic], SHUT_RDWR);
+			continue;
+		}
+		freeaddrinfo(result);
+
+		/* If we made it through to here, this server is live */
+		log_msg("INFO: Successfully contacted server %s\n", gtw_conf.serv_addr[ic]);
+
+		// notify up and down thread that connection has been made
+		server_set_started(&servers.s[ic]);
+		break;
+	}while(1);
+}
+
+
+/* -------------------------------------------------------------------------- */
+/* --- THREAD 0: FETCHING PACKETS FROM THE CONCENTRATOR --------------------- */
+
+/* This thread only drains the concentrator (and ghost source) into the ring, so
+ * that a slow or dead server can never delay the next lgw_receive().
+ * A full fetch is followed by an immediate re-fetch, since more packets are
+ * probably waiting. An empty fetch is followed by a wait that doubles on each
+ * empty fetch, from FETCH_SLEEP_MIN_MS up to fetch_sleep_max_ms, to limit the
+ * wake-ups when the channel is idle. */
+
+void *thread_fetch(void *arg) {
+	struct rx_batch *batch; /* slot of the ring being filled */
+	struct rx_batch overflow; /* scratch batch used to keep draining when the ring is full */
+	int i;
+	int nb_pkt;
+	int nb_radio; /* packets received over the air, the ghost ones follow */
+	unsigned depth; /* nb of batches queued before this one */
+	uint32_t shed[3]; /* packets shed per class */
+	int max_pkt = gtw_conf.fetch_pkt_max;
+	unsigned sleep_ms = FETCH_SLEEP_MIN_MS; /* current idle back-off */
+	struct timespec t_start, t_busy, t_end; /* duty-cycle measurement */
+	struct timespec t_fetch, t_prev_fetch; /* time of the current and previous fetch, the packets fetched ended in between */
+	struct meas_block *meas = &meas_blocks[MEAS_FETCH];
+
+	(void)arg; /* unused */
+	log_msg("INFO: [fetch] Thread activated.\n");
+
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	t_prev_fetch = t_start;
+	while (!exit_sig && !quit_sig) {
+
+		depth = rx_ring_count(&rx_ring);
+		batch = rx_ring_reserve(&rx_ring);
+		if (batch == NULL) {
+			batch = &overflow;
+		}
+
+		/* fetch packets */
+		clock_gettime(CLOCK_MONOTONIC, &t_fetch);
+		pthread_mutex_lock(&mx_concent);
+		if (gtw_conf.radiostream_enabled == true) nb_pkt = lgw_receive(max_pkt, batch->pkt); else nb_pkt = 0;
+		nb_radio = nb_pkt;
+		if ((nb_pkt != LGW_HAL_ERROR) && (gtw_conf.ghoststream_enabled == true)) nb_pkt = ghost_get(max_pkt-nb_pkt, &batch->pkt[nb_pkt]) + nb_pkt;
+		pthread_mutex_unlock(&mx_concent);
+		if (nb_pkt == LGW_HAL_ERROR) {
+			log_msg("ERROR: [fetch] failed packet fetch, exiting\n");
+			exit(EXIT_FAILURE);
+		}
+		
+		/* the latest packet received over the air dates the concentrator counter for the downlinks */
+		if (nb_radio > 0) {
+			cnt_ref_update(batch->pkt[nb_radio - 1].count_us, &t_prev_fetch);
+		}
+		t_prev_fetch = t_fetch;
+
+		/* packets received and channel occupancy, counted before any packet is shed or dropped */
+		if (nb_pkt > 0) {
+			meas_begin(meas);
+			meas_add(meas, MEAS_NB_RX_RCV, nb_pkt);
+			for (i = 0; i < nb_pkt; ++i) {
+				switch (batch->pkt[i].status) {
+					case STAT_CRC_OK:	meas_add(meas, MEAS_NB_RX_OK, 1); break;
+					case STAT_CRC_BAD:	meas_add(meas, MEAS_NB_RX_BAD, 1); break;
+					case STAT_NO_CRC:	meas_add(meas, MEAS_NB_RX_NOCRC, 1); break;
+					default:			break;
+				}
+				if ((i < nb_radio) && (batch->pkt[i].if_chain < MEAS_IF_CHAIN_NB)) {
+					meas_add(meas, MEAS_RX_BUSY_US + batch->pkt[i].if_chain, airtime_rx(&batch->pkt[i]));
+				}
+			}
+			meas_end(meas);
+		}
+
+		if (nb_pkt > 0) {
+			if (batch == &overflow) {
+				/* the upstream thread is lagging behind, the packets are lost */
+				meas_begin(meas);
+				meas_add(meas, MEAS_NB_RX_DROP, nb_pkt);
+				meas_end(meas);
+			} else {
+				/* the packets of least priority make room for the others as the queue fills up */
+				memset(shed, 0, sizeof shed);
+				batch->nb_pkt = shed_batch(batch->pkt, nb_pkt, depth, shed);
+				meas_begin(meas);
+				meas_add(meas, MEAS_NB_RX_SHED_BAD, shed[0]);
+				meas_add(meas, MEAS_NB_RX_SHED_DUP, shed[1]);
+				meas_add(meas, MEAS_NB_RX_SHED_UNCONF, shed[2]);
+				meas_end(meas);
+				/* local timestamp, used until we get accurate GPS time */
+				clock_gettime(CLOCK_REALTIME, &batch->fetch_time);
+				if (batch->nb_pkt > 0) {
+					rx_ring_commit(&rx_ring);
+				}
+			}
+			meas_begin(meas);
+			meas_add(meas, MEAS_FETCH_DEPTH + depth, 1);
+			meas_end(meas);
 		}
 
-		/* connect so we can send/receive packet with the server only */
-		i = connect(sock_down[ic], q->ai_addr, q->ai_addrlen);
-		if (i != 0) {
-			log_msg("ERROR: [down] connect address %s (port %s) returned: %s\n", gtw_conf.serv_addr[ic], gtw_conf.serv_port_down[ic], strerror(errno));
-			shutdown(sock_up[ic], SHUT_RDWR);
-			continue;
+		/* traffic resets the back-off, a full batch is re-fetched without waiting */
+		clock_gettime(CLOCK_MONOTONIC, &t_busy);
+		if (nb_pkt == 0) {
+			wait_ms(sleep_ms);
+			sleep_ms = (2 * sleep_ms < gtw_conf.fetch_sleep_max_ms) ? (2 * sleep_ms) : gtw_conf.fetch_sleep_max_ms;
+		} else {
+			sleep_ms = FETCH_SLEEP_MIN_MS;
 		}
-		freeaddrinfo(result);
-
-		/* If we made it through to here, this server is live */
-		log_msg("INFO: Successfully contacted server %s\n", gtw_conf.serv_addr[ic]);
-
-		// notify up and down thread that connection has been made
-		server_set_started(&servers.s[ic]);
-		break;
-	}while(1);
+		clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+		meas_begin(meas);
+		meas_add(meas, MEAS_FETCH_NB, 1);
+		if (nb_pkt == max_pkt) meas_add(meas, MEAS_FETCH_FULL, 1);
+		if (nb_pkt == 0) meas_add(meas, MEAS_FETCH_EMPTY, 1);
+		meas_add(meas, MEAS_FETCH_BUSY_US, (uint32_t)(1e6 * difftimespec(t_busy, t_start)));
+		meas_add(meas, MEAS_FETCH_IDLE_US, (uint32_t)(1e6 * difftimespec(t_end, t_busy)));
+		meas_end(meas);
+		t_start = t_end;
+	}
+	log_msg("\nINFO: End of fetch thread\n");
+	return NULL;
 }
 
-
 /* -------------------------------------------------------------------------- */
-/* --- THREAD 1: RECEIVING PACKETS AND FORWARDING THEM ---------------------- */
+/* --- THREAD 1: FORWARDING RECEIVED PACKETS -------------------------------- */
 
 void thread_up(void) {
 	int i, j; /* loop variables */
-	int ic; /* Server Loop Variable */
-	unsigned pkt_in_dgram; /* nb on Lora packet in the current datagram */
 	
-	/* allocate memory for packet fetching and processing */
-	struct lgw_pkt_rx_s rxpkt[NB_PKT_MAX]; /* array containing inbound packets + metadata */
+	/* batch of fetched packets being processed */
+	struct rx_batch *batch;
 	struct lgw_pkt_rx_s *p; /* pointer on a RX packet */
 	int nb_pkt;
-	
-	/* local timestamp variables until we get accurate GPS time */
-	struct timespec fetch_time;
-	struct tm * x1;
-	char fetch_timestamp[28]; /* timestamp as a text string */
 
 	/* local copy of GPS time reference */
 	bool ref_ok = false; /* determine if GPS time reference must be used or not */
 	struct tref local_ref; /* time reference used for UTC <-> timestamp conversion */
 	
-	/* data buffers */
-	uint8_t buff_up[TX_BUFF_SIZE]; /* buffer to compose the upstream packet */
-	int buff_index;
-	uint8_t buff_ack[32]; /* buffer to receive acknowledges */
+	/* datagram being composed, in the encodings used by the servers */
+	struct push_dgram dgram;
 	
 	/* protocol variables */
-	uint8_t token_h; /* random token for acknowledgement matching */
-	uint8_t token_l; /* random token for acknowledgement matching */
-	
-	/* ping measurement variables */
-	struct timespec send_time;
-	struct timespec recv_time;
+	uint16_t token = (uint16_t)rand(); /* sequential token for acknowledgement matching, random start */
 	
 	/* GPS synchronization variables */
 	struct timespec pkt_utc_time;
-	struct tm * x; /* broken-up UTC time */
+	const struct timespec *utc; /* RX time of the current packet, if any */
 	
 	/* report management variable */
 	bool send_report = false;
 	
+	/* aggregation window, a single fetch per datagram when disabled */
+	unsigned hold_ms = gtw_conf.aggr_hold_ms;
+	int dgram_max; /* size limit of the datagram being composed */
+	bool dgram_open = false; /* a datagram is being composed */
+	struct timespec hold_start; /* time at which the datagram was started */
+	struct timespec pmtu_check; /* last time the path MTU was read */
+	struct timespec now;
+	unsigned wait_ms;
+	unsigned dgram_fetches = 0; /* nb of fetches contributing packets to the datagram */
+	bool fetch_in_dgram; /* the current fetch already contributed to the datagram */
+	bool fwd; /* the packet passes the CRC status, duplicate and network filters */
+	bool dup[NB_PKT_MAX]; /* the packet is a copy of a frame already forwarded */
+	enum filter_verdict verdict[NB_PKT_MAX]; /* network filter decision */
+	struct lw_frame frame[NB_PKT_MAX]; /* LoRaWAN headers */
+	bool lw_valid[NB_PKT_MAX]; /* the packet is a LoRaWAN frame */
+	bool routing = false; /* some servers only receive part of the uplinks */
+	uint8_t route = 0; /* mask of the servers the packet is routed to */
+	struct meas_block *meas = &meas_blocks[MEAS_UP];
+	
 	log_msg("INFO: [up] Thread activated for all servers.\n");
 	
-	/* pre-fill the data buffer with fixed fields */
-	buff_up[0] = PROTOCOL_VERSION;
-	buff_up[3] = PKT_PUSH_DATA;
-	*(uint32_t *)(buff_up + 4) = net_mac_h;
-	*(uint32_t *)(buff_up + 8) = net_mac_l;
+	for (i = 0; i < gtw_conf.serv_count; ++i) {
+		routing = routing || (gtw_conf.serv_route[i] != NULL);
+		route |= 1 << i;
+	}
+	
+	/* pre-fill the data buffers with fixed fields */
+	push_data_init(&dgram);
 	
 	bool started[gtw_conf.serv_count];
 	memset(started, false, gtw_conf.serv_count);
+	dgram_max = push_size_limit(started);
+	clock_gettime(CLOCK_MONOTONIC, &pmtu_check);
+	
+	if (gtw_conf.journal_path[0] != 0) {
+		push_journal_open();
+	}
+	dedup_init(&rx_dedup, gtw_conf.dedup_window_ms);
 
 	while (!exit_sig && !quit_sig) {
 	
-		/* fetch packets */
-		pthread_mutex_lock(&mx_concent);
-		if (gtw_conf.radiostream_enabled == true) nb_pkt = lgw_receive(NB_PKT_MAX, rxpkt); else nb_pkt = 0;
-		if (gtw_conf.ghoststream_enabled == true) nb_pkt = ghost_get(NB_PKT_MAX-nb_pkt, &rxpkt[nb_pkt]) + nb_pkt;
-
-
-        //TODO this test should in fact be before the ghost packets are collected.
-		pthread_mutex_unlock(&mx_concent);
-		if (nb_pkt == LGW_HAL_ERROR) {
-			log_msg("ERROR: [up] failed packet fetch, exiting\n");
-			exit(EXIT_FAILURE);
-		} 
+		/* wait for a batch of packets from the fetch thread, not beyond the end of the aggregation window */
+		wait_ms = UP_WAIT_MS;
+		if (dgram_open) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			j = (int)(1000 * difftimespec(now, hold_start));
+			wait_ms = (j < (int)hold_ms) ? (hold_ms - j) : 0;
+		}
+		batch = rx_ring_peek(&rx_ring, wait_ms);
+		nb_pkt = (batch != NULL) ? batch->nb_pkt : 0;
+		
+		/* servers lagging behind are fed from the journal, whatever the traffic */
+		if (journal_on) {
+			push_journal_drain(&token, started);
+		}
 		
 		/* check if there are status report to send */
 		send_report = report_ready; /* copy the variable so it doesn't change mid-function */
 		/* no mutex, we're only reading */
 		
-		/* wait a short time if no packets, nor status report */
-		if ((nb_pkt == 0) && (send_report == false)) {
-			wait_ms(FETCH_SLEEP_MS);
+		/* follow the path MTU between datagrams, so that the next one is split to fit */
+		if (dgram_open == false) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if ((1000 * difftimespec(now, pmtu_check)) >= PMTU_CHECK_MS) {
+				dgram_max = push_size_limit(started);
+				pmtu_check = now;
+			}
+		}
+		
+		/* nothing to do if no packets, nor status report, nor datagram waiting */
+		if ((nb_pkt == 0) && (send_report == false) && (dgram_open == false)) {
 			continue;
 		}
 		
@@ -826,367 +2652,226 @@ void thread_up(void) {
 			ref_ok = false;
 		}
 		
-		/* local timestamp generation until we get accurate GPS time */
-		clock_gettime(CLOCK_REALTIME, &fetch_time);
-		x1 = gmtime(&(fetch_time.tv_sec)); /* split the UNIX timestamp to its calendar components */
-		snprintf(fetch_timestamp, sizeof fetch_timestamp, "%04i-%02i-%02iT%02i:%02i:%02i.%06liZ", (x1->tm_year)+1900, (x1->tm_mon)+1, x1->tm_mday, x1->tm_hour, x1->tm_min, x1->tm_sec, (fetch_time.tv_nsec)/1000); /* ISO 8601 format */
-
-		/* start composing datagram with the header */
-		token_h = (uint8_t)rand(); /* random token */
-		token_l = (uint8_t)rand(); /* random token */
-		buff_up[1] = token_h;
-		buff_up[2] = token_l;
-		buff_index = 12; /* 12-byte header */
+		/* the status report opens the window too, so that it travels with the next packets */
+		if ((dgram_open == false) && (send_report == true)) {
+			push_data_open(&dgram, ++token);
+			dgram_fetches = 0;
+			clock_gettime(CLOCK_MONOTONIC, &hold_start);
+			dgram_open = true;
+		}
+		
+		/* drop the copies of frames received several times */
+		if (gtw_conf.dedup_window_ms > 0) {
+			if (nb_pkt > 0) dedup_batch(batch, dup);
+		} else {
+			memset(dup, 0, sizeof dup);
+		}
+		
+		/* drop the frames of other networks */
+		if (((gtw_conf.filter_file[0] != 0) || routing || dgram.enrich || (link_table.capacity > 0)) && (nb_pkt > 0)) {
+			lw_parse_batch(batch, frame, lw_valid);
+		}
+		if ((gtw_conf.filter_file[0] != 0) && (nb_pkt > 0)) {
+			filter_batch(batch, frame, lw_valid, verdict);
+		} else {
+			memset(verdict, 0, sizeof verdict);
+		}
 		
-		/* start of JSON structure */
-		memcpy((void *)(buff_up + buff_index), (void *)"{\"rxpk\":[", 9);
-		buff_index += 9;
+		/* link quality of the devices of this network */
+		if ((link_table.capacity > 0) && (nb_pkt > 0)) {
+			link_batch(batch, frame, lw_valid, dup, verdict);
+		}
 		
 		/* serialize Lora packets metadata and payload */
-		pkt_in_dgram = 0;
+		fetch_in_dgram = false;
 		for (i=0; i < nb_pkt; ++i) {
-			p = &rxpkt[i];
+			p = &batch->pkt[i];
 			
-			/* basic packet filtering */
-			pthread_mutex_lock(&mx_meas_up);
-			meas_nb_rx_rcv += 1;
+			/* basic packet filtering, the packets received are counted by the fetch thread */
+			meas_begin(meas);
 			switch(p->status) {
 				case STAT_CRC_OK:
-					meas_nb_rx_ok += 1;
-					if (!gtw_conf.fwd_valid_pkt) {
-						pthread_mutex_unlock(&mx_meas_up);
-						continue; /* skip that packet */
-					}
+					fwd = gtw_conf.fwd_valid_pkt;
 					break;
 				case STAT_CRC_BAD:
-					meas_nb_rx_bad += 1;
-					if (!gtw_conf.fwd_error_pkt) {
-						pthread_mutex_unlock(&mx_meas_up);
-						continue; /* skip that packet */
-					}
+					fwd = gtw_conf.fwd_error_pkt;
 					break;
 				case STAT_NO_CRC:
-					meas_nb_rx_nocrc += 1;
-					if (!gtw_conf.fwd_nocrc_pkt) {
-						pthread_mutex_unlock(&mx_meas_up);
-						continue; /* skip that packet */
-					}
+					fwd = gtw_conf.fwd_nocrc_pkt;
 					break;
 				default:
 					log_msg("WARNING: [up] received packet with unknown status %u (size %u, modulation %u, BW %u, DR %u, RSSI %.1f)\n", p->status, p->size, p->modulation, p->bandwidth, p->datarate, p->rssi);
-					pthread_mutex_unlock(&mx_meas_up);
-					continue; /* skip that packet */
+					fwd = false;
 					// exit(EXIT_FAILURE);
 			}
-			meas_up_pkt_fwd += 1;
-			meas_up_payload_byte += p->size;
-			pthread_mutex_unlock(&mx_meas_up);
-			
-			/* Start of packet, add inter-packet separator if necessary */
-			if (pkt_in_dgram == 0) {
-				buff_up[buff_index] = '{';
-				++buff_index;
-			} else {
-				buff_up[buff_index] = ',';
-				buff_up[buff_index+1] = '{';
-				buff_index += 2;
+			if (fwd && dup[i]) {
+				meas_add(meas, MEAS_NB_RX_DUP, 1);
+				fwd = false;
 			}
-			
-			/* RAW timestamp, 8-17 useful chars */
-			j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, "\"tmst\":%u", p->count_us);
-			if (j > 0) {
-				buff_index += j;
-			} else {
-				log_msg("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-				exit(EXIT_FAILURE);
+			if (fwd && (verdict[i] != FILTER_PASS)) {
+				meas_add(meas, MEAS_NB_RX_FLT_DATA + verdict[i] - FILTER_DROP_DATA, 1);
+				fwd = false;
 			}
-
-			/* Packet RX time (GPS based), 37 useful chars */
-			//TODO: From the block below only one can be exectuted, decide on the presence of GPS.
-			// This has not been coded well.
-			if (gtw_conf.gps_active) {
-				if (ref_ok == true) {
-					/* convert packet timestamp to UTC absolute time */
-					j = lgw_cnt2utc(local_ref, p->count_us, &pkt_utc_time);
-					if (j == LGW_GPS_SUCCESS) {
-						/* split the UNIX timestamp to its calendar components */
-						x = gmtime(&(pkt_utc_time.tv_sec));
-						j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"time\":\"%04i-%02i-%02iT%02i:%02i:%02i.%06liZ\"", (x->tm_year)+1900, (x->tm_mon)+1, x->tm_mday, x->tm_hour, x->tm_min, x->tm_sec, (pkt_utc_time.tv_nsec)/1000); /* ISO 8601 format */
-						if (j > 0) {
-							buff_index += j;
-						} else {
-							log_msg("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-							exit(EXIT_FAILURE);
-						}
-					}
+			if (fwd && routing) {
+				route = route_packet(lw_valid[i] ? &frame[i] : NULL);
+				if (route == 0) {
+					meas_add(meas, MEAS_NB_RX_UNROUTED, 1);
+					fwd = false;
 				}
-			} else {
-				memcpy((void *)(buff_up + buff_index), (void *)",\"time\":\"???????????????????????????\"", 37);
-				memcpy((void *)(buff_up + buff_index + 9), (void *)fetch_timestamp, 27);
-				buff_index += 37;
 			}
-			
-			/* Packet concentrator channel, RF chain & RX frequency, 34-36 useful chars */
-			j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"chan\":%1u,\"rfch\":%1u,\"freq\":%.6lf", p->if_chain, p->rf_chain, ((double)p->freq_hz / 1e6));
-			if (j > 0) {
-				buff_index += j;
-			} else {
-				log_msg("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-				exit(EXIT_FAILURE);
+			if (fwd) {
+				meas_add(meas, MEAS_UP_PKT_FWD, 1);
+				meas_add(meas, MEAS_UP_PAYLOAD_BYTE, p->size);
 			}
-			
-			/* Packet status, 9-10 useful chars */
-			switch (p->status) {
-				case STAT_CRC_OK:
-					memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":1", 9);
-					buff_index += 9;
-					break;
-				case STAT_CRC_BAD:
-					memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":-1", 10);
-					buff_index += 10;
-					break;
-				case STAT_NO_CRC:
-					memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":0", 9);
-					buff_index += 9;
-					break;
-				default:
-					log_msg("ERROR: [up] received packet with unknown status\n");
-					memcpy((void *)(buff_up + buff_index), (void *)",\"stat\":?", 9);
-					buff_index += 9;
-					exit(EXIT_FAILURE);
+			meas_end(meas);
+			if (!fwd) {
+				continue; /* skip that packet */
 			}
 			
-			/* Packet modulation, 13-14 useful chars */
-			if (p->modulation == MOD_LORA) {
-				memcpy((void *)(buff_up + buff_index), (void *)",\"modu\":\"LORA\"", 14);
-				buff_index += 14;
-				
-				/* Lora datarate & bandwidth, 16-19 useful chars */
-				switch (p->datarate) {
-					case DR_LORA_SF7:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF7", 12);
-						buff_index += 12;
-						break;
-					case DR_LORA_SF8:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF8", 12);
-						buff_index += 12;
-						break;
-					case DR_LORA_SF9:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF9", 12);
-						buff_index += 12;
-						break;
-					case DR_LORA_SF10:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF10", 13);
-						buff_index += 13;
-						break;
-					case DR_LORA_SF11:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF11", 13);
-						buff_index += 13;
-						break;
-					case DR_LORA_SF12:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF12", 13);
-						buff_index += 13;
-						break;
-					default:
-						log_msg("ERROR: [up] lora packet with unknown datarate\n");
-						memcpy((void *)(buff_up + buff_index), (void *)",\"datr\":\"SF?", 12);
-						buff_index += 12;
-						exit(EXIT_FAILURE);
-				}
-				switch (p->bandwidth) {
-					case BW_125KHZ:
-						memcpy((void *)(buff_up + buff_index), (void *)"BW125\"", 6);
-						buff_index += 6;
-						break;
-					case BW_250KHZ:
-						memcpy((void *)(buff_up + buff_index), (void *)"BW250\"", 6);
-						buff_index += 6;
-						break;
-					case BW_500KHZ:
-						memcpy((void *)(buff_up + buff_index), (void *)"BW500\"", 6);
-						buff_index += 6;
-						break;
-					default:
-						log_msg("ERROR: [up] lora packet with unknown bandwidth\n");
-						memcpy((void *)(buff_up + buff_index), (void *)"BW?\"", 4);
-						buff_index += 4;
-						exit(EXIT_FAILURE);
-				}
-				
-				/* Packet ECC coding rate, 11-13 useful chars */
-				switch (p->coderate) {
-					case CR_LORA_4_5:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"4/5\"", 13);
-						buff_index += 13;
-						break;
-					case CR_LORA_4_6:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"4/6\"", 13);
-						buff_index += 13;
-						break;
-					case CR_LORA_4_7:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"4/7\"", 13);
-						buff_index += 13;
-						break;
-					case CR_LORA_4_8:
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"4/8\"", 13);
-						buff_index += 13;
-						break;
-					case 0: /* treat the CR0 case (mostly false sync) */
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"OFF\"", 13);
-						buff_index += 13;
-						break;
-					default:
-						log_msg("ERROR: [up] lora packet with unknown coderate\n");
-						memcpy((void *)(buff_up + buff_index), (void *)",\"codr\":\"?\"", 11);
-						buff_index += 11;
-						exit(EXIT_FAILURE);
-				}
-				
-				/* Lora SNR, 11-13 useful chars */
-				j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"lsnr\":%.1f", p->snr);
-				if (j > 0) {
-					buff_index += j;
-				} else {
-					log_msg("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-					exit(EXIT_FAILURE);
-				}
-			} else if (p->modulation == MOD_FSK) {
-				memcpy((void *)(buff_up + buff_index), (void *)",\"modu\":\"FSK\"", 13);
-				buff_index += 13;
-				
-				/* FSK datarate, 11-14 useful chars */
-				j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"datr\":%u", p->datarate);
-				if (j > 0) {
-					buff_index += j;
-				} else {
-					log_msg("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-					exit(EXIT_FAILURE);
-				}
-			} else {
-				log_msg("ERROR: [up] received packet with unknown modulation\n");
-				exit(EXIT_FAILURE);
+			/* send the datagram first if this packet could push it over the size limit */
+			if (dgram_open && !push_data_room(&dgram, p->size, dgram_max)) {
+				push_data_close(&dgram, dgram_max);
+				push_data_forward(&dgram, token, started, dgram_fetches - 1);
+				dgram_open = false;
 			}
 			
-			/* Packet RSSI, payload size, 18-23 useful chars */
-			j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, ",\"rssi\":%.0f,\"size\":%u", p->rssi, p->size);
-			if (j > 0) {
-				buff_index += j;
-			} else {
-				log_msg("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 4));
-				exit(EXIT_FAILURE);
+			/* start composing datagram with the header */
+			if (dgram_open == false) {
+				push_data_open(&dgram, ++token);
+				dgram_fetches = 0;
+				fetch_in_dgram = false;
+				clock_gettime(CLOCK_MONOTONIC, &hold_start);
+				dgram_open = true;
+			}
+			if (fetch_in_dgram == false) {
+				++dgram_fetches;
+				fetch_in_dgram = true;
 			}
 			
-			/* Packet base64-encoded payload, 14-350 useful chars */
-			memcpy((void *)(buff_up + buff_index), (void *)",\"data\":\"", 9);
-			buff_index += 9;
-			j = bin_to_b64(p->payload, p->size, (char *)(buff_up + buff_index), 341); /* 255 bytes = 340 chars in b64 + null char */
-			if (j>=0) {
-				buff_index += j;
+			/* packet RX time, GPS based when a GPS is in use, fetch time otherwise */
+			utc = NULL;
+			if (gtw_conf.gps_active) {
+				if ((ref_ok == true) && (lgw_cnt2utc(local_ref, p->count_us, &pkt_utc_time) == LGW_GPS_SUCCESS)) {
+					utc = &pkt_utc_time;
+				}
 			} else {
-				log_msg("ERROR: [up] bin_to_b64 failed line %u\n", (__LINE__ - 5));
-				exit(EXIT_FAILURE);
+				utc = &batch->fetch_time;
 			}
-			buff_up[buff_index] = '"';
-			++buff_index;
 			
-			/* End of packet serialization */
-			buff_up[buff_index] = '}';
-			++buff_index;
-			++pkt_in_dgram;
+			push_data_add(&dgram, p, utc, (dgram.enrich && lw_valid[i]) ? &frame[i] : NULL, route);
 		}
 		
-		/* restart fetch sequence without sending empty JSON if all packets have been filtered out */
-		if (pkt_in_dgram == 0) {
-			if (send_report == true) {
-				/* need to clean up the beginning of the payload */
-				buff_index -= 8; /* removes "rxpk":[ */
-			} else {
-				/* all packet have been filtered out and no report, restart loop */
-				continue;
-			}
-		} else {
-			/* end of packet array */
-			buff_up[buff_index] = ']';
-			++buff_index;
-			/* add separator if needed */
-			if (send_report == true) {
-				buff_up[buff_index] = ',';
-				++buff_index;
-			}
+		/* the batch is serialized, hand the slot back to the fetch thread before any network I/O */
+		if (batch != NULL) {
+			rx_ring_release(&rx_ring);
 		}
 		
-		/* add status report if a new one is available */
-		if (send_report == true) {
-			pthread_mutex_lock(&mx_stat_rep);
-			report_ready = false;
-			j = snprintf((char *)(buff_up + buff_index), TX_BUFF_SIZE-buff_index, "%s", status_report);
-			pthread_mutex_unlock(&mx_stat_rep);
-			if (j > 0) {
-				buff_index += j;
-			} else {
-				log_msg("ERROR: [up] snprintf failed line %u\n", (__LINE__ - 5));
-				exit(EXIT_FAILURE);
-			}
+		/* all packets have been filtered out and no report */
+		if (dgram_open == false) {
+			continue;
 		}
 		
-		/* end of JSON datagram payload */
-		buff_up[buff_index] = '}';
-		++buff_index;
-		buff_up[buff_index] = 0; /* add string terminator, for safety */
-		
-		// printf("\nJSON up: %s\n", (char *)(buff_up + 12)); /* DEBUG: display JSON payload */
+		/* keep the datagram open while the window lasts and another packet may fit */
+		if (hold_ms > 0) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if (((1000 * difftimespec(now, hold_start)) < hold_ms) && push_data_room(&dgram, 0, dgram_max)) {
+				continue;
+			}
+		}
 		
-		/* send datagram to servers sequentially */
-		// TODO make this parallel.
-		for (ic = 0; ic < gtw_conf.serv_count; ic++) {
-			if(!started[ic] && server_is_started(&servers.s[ic])){
-				// server is running and was not, init the socket
+		/* send datagram to servers, with the status report if a new one is available */
+		if (push_data_close(&dgram, dgram_max)) {
+			push_data_forward(&dgram, token, started, (dgram_fetches > 1) ? (dgram_fetches - 1) : 0);
+		}
+		dgram_open = false;
+	}
+	if (journal_on) {
+		journal_close(&push_journal);
+	}
+	log_msg("\nINFO: End of upstream thread\n");
+}
 
-				/* set upstream socket RX timeout */
-				i = setsockopt(sock_up[ic], SOL_SOCKET, SO_RCVTIMEO, (void *)&gtw_conf.push_timeout_half, sizeof gtw_conf.push_timeout_half);
-				if (i != 0) {
-					log_msg("ERROR: [up] setsockopt for server %s returned %s\n", gtw_conf.serv_addr[ic], strerror(errno));
-					exit(EXIT_FAILURE);
-				}
-				started[ic] = true;
-			}
+/* -------------------------------------------------------------------------- */
+/* --- THREAD 1b: COLLECTING PUSH_ACK FROM ONE SERVER ----------------------- */
 
-			if(!started[ic])
-				continue;
+/* ACKs are matched against the in-flight table whenever they arrive, so several
+ * PUSH_DATA can be outstanding and late ACKs are still accounted for.
+ * Between ACKs, the datagrams overdue are retransmitted from the in-flight
+ * table, the wait is bounded by the next retransmission time. */
 
-			send(sock_up[ic], (void *)buff_up, buff_index, 0);
-			clock_gettime(CLOCK_MONOTONIC, &send_time);
-			pthread_mutex_lock(&mx_meas_up);
-			meas_up_dgram_sent += 1;
-			meas_up_network_byte += buff_index;
+void *thread_ack(void *pic) {
+	int i;
+	int ic = (int) (long) pic;
+	uint8_t buff_ack[32]; /* buffer to receive acknowledges */
+	uint8_t buff_retx[PUSH_RETX_SIZE]; /* datagram being retransmitted */
+	uint16_t token;
+	struct timespec recv_time;
+	int rtt_ms;
+	int expired; /* datagrams out of retries, per call */
+	int nb_expired;
+	int max_wait_ms = gtw_conf.push_timeout_half.tv_usec / 1000; /* so that the thread notices the exit request */
+	struct pollfd pfd;
+	struct meas_block *meas = &meas_blocks[MEAS_ACK(ic)];
 
-			/* wait for acknowledge (in 2 times, to catch extra packets) */
-			for (i=0; i<2; ++i) {
-				j = recv(sock_up[ic], (void *)buff_ack, sizeof buff_ack, 0);
-				clock_gettime(CLOCK_MONOTONIC, &recv_time);
-				if (j == -1) {
-					if (errno == EAGAIN) { /* timeout */
-						continue;
-					} else { /* server connection error */
-						break;
-					}
-				} else if ((j < 4) || (buff_ack[0] != PROTOCOL_VERSION) || (buff_ack[3] != PKT_PUSH_ACK)) {
-					//log_msg("WARNING: [up] ignored invalid non-ACL packet\n");
-					continue;
-				} else if ((buff_ack[1] != token_h) || (buff_ack[2] != token_l)) {
-					//log_msg("WARNING: [up] ignored out-of sync ACK packet\n");
-					continue;
-				} else {
-					//TODO: This may generate a lot of logdata, see other todo for a solution.
-					log_msg("INFO: [up] PUSH_ACK for server %s received in %i ms\n", gtw_conf.serv_addr[ic], (int)(1000 * difftimespec(recv_time, send_time)));
-					meas_up_ack_rcv += 1;
-					break;
-				}
+	/* wait on connection running for this server */
+	server_wait_started(&servers.s[ic]);
+	pfd.fd = sock_up[ic];
+	pfd.events = POLLIN;
+
+	log_msg("INFO: [up] ACK thread activated for server %s\n", gtw_conf.serv_addr[ic]);
+
+	while (!exit_sig && !quit_sig) {
+		/* retransmit the datagrams whose ACK is overdue, within the budget of the server */
+		clock_gettime(CLOCK_MONOTONIC, &recv_time);
+		nb_expired = 0;
+		while ((i = inflight_retx(&push_inflight[ic], recv_time, buff_retx, &expired)) > 0) {
+			nb_expired += expired;
+			i = send(sock_up[ic], (void *)buff_retx, i, 0);
+			if (i >= 0) { /* apart from the datagrams sent, which the ACK ratio is computed on */
+				meas_begin(meas);
+				meas_add(meas, MEAS_UP_RETX, 1);
+				meas_add(meas, MEAS_UP_RETX_BYTE, i);
+				meas_end(meas);
 			}
-			pthread_mutex_unlock(&mx_meas_up);
 		}
+		nb_expired += expired; /* from the call that found nothing more to send */
+		if (nb_expired > 0) {
+			meas_begin(meas);
+			meas_add(meas, MEAS_UP_RETX_EXPIRED, nb_expired);
+			meas_end(meas);
+		}
+		
+		i = poll(&pfd, 1, inflight_wait_ms(&push_inflight[ic], recv_time, max_wait_ms));
+		if (i <= 0) {
+			continue; /* timeout */
+		}
+		i = recv(sock_up[ic], (void *)buff_ack, sizeof buff_ack, MSG_DONTWAIT);
+		clock_gettime(CLOCK_MONOTONIC, &recv_time);
+		if (i == -1) {
+			continue; /* server connection error */
+		} else if ((i < 4) || (buff_ack[0] != PROTOCOL_VERSION) || (buff_ack[3] != PKT_PUSH_ACK)) {
+			//log_msg("WARNING: [up] ignored invalid non-ACL packet\n");
+			continue;
+		}
+		token = ((uint16_t)buff_ack[1] << 8) | buff_ack[2];
+		if (inflight_ack(&push_inflight[ic], token, recv_time, &rtt_ms) == false) {
+			//log_msg("WARNING: [up] ignored unknown or duplicate ACK packet\n");
+			continue;
+		}
+		//TODO: This may generate a lot of logdata, see other todo for a solution.
+		if (rtt_ms >= 0) {
+			log_msg("INFO: [up] PUSH_ACK for server %s received in %i ms\n", gtw_conf.serv_addr[ic], rtt_ms);
+		} else {
+			log_msg("INFO: [up] PUSH_ACK for server %s received after retransmission\n", gtw_conf.serv_addr[ic]);
+		}
+		meas_begin(meas);
+		meas_add(meas, MEAS_UP_ACK_RCV, 1);
+		if (rtt_ms >= 0) meas_add(meas, MEAS_UP_RTT + meas_hist_bin(rtt_ms, MEAS_RTT_BINS), 1);
+		meas_end(meas);
+		__atomic_add_fetch(&push_ack_nb[ic], 1, __ATOMIC_RELAXED);
 	}
-	log_msg("\nINFO: End of upstream thread\n");
+	log_msg("\nINFO: End of ACK thread for server %s\n", gtw_conf.serv_addr[ic]);
+	return NULL;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -1197,10 +2882,10 @@ void thread_up(void) {
 void thread_down(void* pic) {
 	int i; /* loop variables */
 	int ic = (int) (long) pic;
+	struct meas_block *meas = &meas_blocks[MEAS_DOWN(ic)];
 	
 	/* configuration and metadata for an outbound packet */
 	struct lgw_pkt_tx_s txpkt;
-	bool sent_immediate = false; /* option to sent the packet immediately */
 	
 	/* local timekeeping variables */
 	struct timespec send_time; /* time of the pull request */
@@ -1216,27 +2901,23 @@ void thread_down(void* pic) {
 	uint8_t token_l; /* random token for acknowledgement matching */
 	bool req_ack = false; /* keep track of whether PULL_DATA was acknowledged or not */
 	
-	/* JSON parsing variables */
-	JSON_Value *root_val = NULL;
-	JSON_Object *txpk_obj = NULL;
-	JSON_Value *val = NULL; /* needed to detect the absence of some fields */
-	const char *str; /* pointer to sub-strings in the JSON data */
-	short x0, x1;
-	short x2, x3, x4;
-	double x5, x6;
-	
-	/* variables to send on UTC timestamp */
-	struct tref local_ref; /* time reference used for UTC <-> timestamp conversion */
-	struct tm utc_vector; /* for collecting the elements of the UTC time */
-	struct timespec utc_tx; /* UTC time that needs to be converted to timestamp */
+	/* downlink scheduling */
+	enum jit_error jit_err;
+	enum load_result load = LOAD_OK; /* outcome of a downlink sent at once */
+	enum duty_verdict duty_v;
+	unsigned preempted; /* queued packets replaced by the new one */
+	uint32_t now_us;
+	int32_t slack_us; /* time left before the start of the packet when received, -1 if unknown */
 	
 	/* beacon variables */
 	struct lgw_pkt_tx_s beacon_pkt;
-	uint8_t tx_status_var;
 	
 	/* auto-quit variable */
 	uint32_t autoquit_cnt = 0; /* count the number of PULL_DATA sent since the latest PULL_ACK */
 	
+	/* the PULL_RESP falling back to the complete JSON parser are parsed in the arena of the thread */
+	arena_use(&down_arena[ic]);
+	
 	while(!exit_sig && !quit_sig){
 		// wait on connection running for this server
 		server_wait_started(&servers.s[ic]);
@@ -1281,6 +2962,13 @@ void thread_down(void* pic) {
 		beacon_pkt.no_crc = true;
 		beacon_pkt.no_header = true;
 		beacon_pkt.size = 17;
+		
+		/* the beacons of a whole window keep their airtime in the budget of their sub-band */
+		if ((gtw_conf.beacon_enabled == true) && (gtw_conf.duty_cycle != NULL)) {
+			pthread_mutex_lock(&mx_duty);
+			duty_reserve(gtw_conf.duty_cycle, gtw_conf.beacon_freq_hz, airtime_tx(&beacon_pkt) * ((gtw_conf.duty_cycle->window_s + gtw_conf.beacon_period - 1) / gtw_conf.beacon_period));
+			pthread_mutex_unlock(&mx_duty);
+		}
 
 		/* fixed bacon fields (little endian) */
 		beacon_pkt.payload[0] = 0xFF &  field_netid;
@@ -1329,9 +3017,9 @@ void thread_down(void* pic) {
 			/* send PULL request and record time */
 			send(sock_down[ic], (void *)buff_req, sizeof buff_req, 0);
 			clock_gettime(CLOCK_MONOTONIC, &send_time);
-			pthread_mutex_lock(&mx_meas_dw);
-			meas_dw_pull_sent += 1;
-			pthread_mutex_unlock(&mx_meas_dw);
+			meas_begin(meas);
+			meas_add(meas, MEAS_DW_PULL_SENT, 1);
+			meas_end(meas);
 			req_ack = false;
 			autoquit_cnt++;
 			
@@ -1351,6 +3039,7 @@ void thread_down(void* pic) {
 					gtw_conf.beacon_next_pps = false;
 					if ((gps_ref_valid == true) && (xtal_correct_ok == true)) {
 						field_time = time_reference_gps.utc.tv_sec + 1; /* the beacon is prepared 1 sec before becon time */
+						beacon_pkt.count_us = time_reference_gps.count_us + 1000000; /* counter at the next PPS, only used to schedule it */
 						pthread_mutex_unlock(&mx_timeref);
 
 						/* load time in beacon payload */
@@ -1384,24 +3073,34 @@ void thread_down(void* pic) {
 						}
 						log_msg("--- end of payload ---\n");
 
-						/* send bacon packet and check for status */
-						pthread_mutex_lock(&mx_concent); /* may have to wait for a fetch to finish */
-						i = lgw_send(beacon_pkt);
-						pthread_mutex_unlock(&mx_concent); /* free concentrator ASAP */
-						if (i == LGW_HAL_ERROR) {
-							log_msg("WARNING: [down] failed to send beacon packet\n");
-						} else {
-							tx_status_var = TX_STATUS_UNKNOWN;
-							for (i=0; (i < (1500/BEACON_POLL_MS)) && (tx_status_var != TX_FREE); ++i) {
-								wait_ms(BEACON_POLL_MS);
-								pthread_mutex_lock(&mx_concent);
-								lgw_status(TX_STATUS, &tx_status_var);
-								pthread_mutex_unlock(&mx_concent);
+						/* queue the beacon, its airtime is taken from the packets of lower priority */
+						duty_v = downlink_duty(&beacon_pkt, true);
+						if (duty_v != DUTY_OK) {
+							meas_begin(meas);
+							meas_add(meas, MEAS_DW_DUTY_DWELL + duty_v - DUTY_DWELL, 1);
+							meas_end(meas);
+							log_msg("WARNING: [down] beacon refused (%s)\n", duty_verdict_name(duty_v));
+						} else if (cnt_now(&now_us)) {
+							preempted = 0;
+							jit_err = downlink_queue(&beacon_pkt, JIT_BEACON, &preempted);
+							if (jit_err != JIT_OK) {
+								downlink_refund(&beacon_pkt, true);
 							}
-							if (tx_status_var == TX_FREE) {
-								log_msg("NOTE: [down] beacon sent successfully\n");
+							meas_begin(meas);
+							meas_add(meas, (jit_err == JIT_OK) ? MEAS_DW_JIT_QUEUED : (MEAS_DW_JIT_LATE + jit_err - JIT_TOO_LATE), 1);
+							meas_add(meas, MEAS_DW_JIT_PREEMPTED, preempted);
+							meas_end(meas);
+							if (jit_err == JIT_OK) {
+								log_msg("NOTE: [down] beacon queued (%u packets replaced)\n", preempted);
 							} else {
-								log_msg("WARNING: [down] beacon was scheduled but failed to TX\n");
+								log_msg("WARNING: [down] beacon refused by the JIT queue (%s)\n", jit_error_name(jit_err));
+							}
+						} else {
+							/* the dispatcher may still hold a packet loaded before, it is not overwritten */
+							load = downlink_load(&beacon_pkt);
+							if (load != LOAD_OK) {
+								log_msg("WARNING: [down] failed to send beacon packet (%s)\n", (load == LOAD_BUSY) ? "concentrator busy" : "HAL error");
+								downlink_refund(&beacon_pkt, true);
 							}
 						}
 					} else {
@@ -1431,9 +3130,9 @@ void thread_down(void* pic) {
 						} else { /* if that packet was not already acknowledged */
 							req_ack = true;
 							autoquit_cnt = 0;
-							pthread_mutex_lock(&mx_meas_dw);
-							meas_dw_ack_rcv += 1;
-							pthread_mutex_unlock(&mx_meas_dw);
+							meas_begin(meas);
+							meas_add(meas, MEAS_DW_ACK_RCV, 1);
+							meas_end(meas);
 							log_msg("INFO: [down] for server %s PULL_ACK received in %i ms\n", gtw_conf.serv_addr[ic], (int)(1000 * difftimespec(recv_time, send_time)));
 						}
 					} else { /* out-of-sync token */
@@ -1449,292 +3148,71 @@ void thread_down(void* pic) {
 				log_msg("INFO: [down] for server %s PULL_RESP received :)\n",gtw_conf.serv_addr[ic]); /* very verbose */
 				// printf("\nJSON down: %s\n", (char *)(buff_down + 4)); /* DEBUG: display JSON payload */
 
-				/* initialize TX struct and try to parse JSON */
+				/* initialize TX struct and parse the txpk, binary or JSON depending on its first byte */
 				memset(&txpkt, 0, sizeof txpkt);
-				root_val = json_parse_string_with_comments((const char *)(buff_down + 4)); /* JSON offset */
-				if (root_val == NULL) {
-					log_msg("WARNING: [down] invalid JSON, TX aborted\n");
-					continue;
-				}
-
-				/* look for JSON sub-object 'txpk' */
-				txpk_obj = json_object_get_object(json_value_get_object(root_val), "txpk");
-				if (txpk_obj == NULL) {
-					log_msg("WARNING: [down] no \"txpk\" object in JSON, TX aborted\n");
-					json_value_free(root_val);
-					continue;
-				}
-
-				/* Parse "immediate" tag, or target timestamp, or UTC time to be converted by GPS (mandatory) */
-				i = json_object_get_boolean(txpk_obj,"imme"); /* can be 1 if true, 0 if false, or -1 if not a JSON boolean */
-				if (i == 1) {
-					/* TX procedure: send immediately */
-					sent_immediate = true;
-					log_msg("INFO: [down] a packet will be sent in \"immediate\" mode\n");
+				if ((log_msg_len > 4) && (buff_down[4] == BINPK_VERSION)) {
+					i = parse_txpk_bin(buff_down + 4, log_msg_len - 4, &txpkt);
 				} else {
-					sent_immediate = false;
-					val = json_object_get_value(txpk_obj,"tmst");
-					if (val != NULL) {
-						/* TX procedure: send on timestamp value */
-						txpkt.count_us = (uint32_t)json_value_get_number(val);
-						log_msg("INFO: [down] a packet will be sent on timestamp value %u\n", txpkt.count_us);
-					} else {
-						/* TX procedure: send on UTC time (converted to timestamp value) */
-						str = json_object_get_string(txpk_obj, "time");
-						if (str == NULL) {
-							log_msg("WARNING: [down] no mandatory \"txpk.tmst\" or \"txpk.time\" objects in JSON, TX aborted\n");
-							json_value_free(root_val);
-							continue;
-						}
-						if (gtw_conf.gps_active == true) {
-							pthread_mutex_lock(&mx_timeref);
-							if (gps_ref_valid == true) {
-								local_ref = time_reference_gps;
-								pthread_mutex_unlock(&mx_timeref);
-							} else {
-								pthread_mutex_unlock(&mx_timeref);
-								log_msg("WARNING: [down] no valid GPS time reference yet, impossible to send packet on specific UTC time, TX aborted\n");
-								json_value_free(root_val);
-								continue;
-							}
-						} else {
-							log_msg("WARNING: [down] GPS disabled, impossible to send packet on specific UTC time, TX aborted\n");
-							json_value_free(root_val);
-							continue;
-						}
-
-						i = sscanf (str, "%4hd-%2hd-%2hdT%2hd:%2hd:%9lf", &x0, &x1, &x2, &x3, &x4, &x5);
-						if (i != 6 ) {
-							log_msg("WARNING: [down] \"txpk.time\" must follow ISO 8601 format, TX aborted\n");
-							json_value_free(root_val);
-							continue;
-						}
-						x5 = modf(x5, &x6); /* x6 get the integer part of x5, x5 the fractional part */
-						utc_vector.tm_year = x0 - 1900; /* years since 1900 */
-						utc_vector.tm_mon = x1 - 1; /* months since January */
-						utc_vector.tm_mday = x2; /* day of the month 1-31 */
-						utc_vector.tm_hour = x3; /* hours since midnight */
-						utc_vector.tm_min = x4; /* minutes after the hour */
-						utc_vector.tm_sec = (int)x6;
-						utc_tx.tv_sec = mktime(&utc_vector) - timezone;
-						utc_tx.tv_nsec = (long)(1e9 * x5);
-
-						/* transform UTC time to timestamp */
-						i = lgw_utc2cnt(local_ref, utc_tx, &(txpkt.count_us));
-						if (i != LGW_GPS_SUCCESS) {
-							log_msg("WARNING: [down] could not convert UTC time to timestamp, TX aborted\n");
-							json_value_free(root_val);
-							continue;
-						} else {
-							log_msg("INFO: [down] a packet will be sent on timestamp value %u (calculated from UTC time)\n", txpkt.count_us);
-						}
-					}
+					i = parse_txpk_json((const char *)(buff_down + 4), log_msg_len - 4, &txpkt); /* JSON offset */
+					arena_reset(&down_arena[ic]);
 				}
-
-				/* Parse "No CRC" flag (optional field) */
-				val = json_object_get_value(txpk_obj,"ncrc");
-				if (val != NULL) {
-					txpkt.no_crc = (bool)json_value_get_boolean(val);
-				}
-
-				/* parse target frequency (mandatory) */
-				val = json_object_get_value(txpk_obj,"freq");
-				if (val == NULL) {
-					log_msg("WARNING: [down] no mandatory \"txpk.freq\" object in JSON, TX aborted\n");
-					json_value_free(root_val);
-					continue;
-				}
-				txpkt.freq_hz = (uint32_t)((double)(1.0e6) * json_value_get_number(val));
-
-				/* parse RF chain used for TX (mandatory) */
-				val = json_object_get_value(txpk_obj,"rfch");
-				if (val == NULL) {
-					log_msg("WARNING: [down] no mandatory \"txpk.rfch\" object in JSON, TX aborted\n");
-					json_value_free(root_val);
+				if (i != 0) {
 					continue;
 				}
-				txpkt.rf_chain = (uint8_t)json_value_get_number(val);
-
-				/* parse TX power (optional field) */
-				val = json_object_get_value(txpk_obj,"powe");
-				if (val != NULL) {
-					txpkt.rf_power = (int8_t)json_value_get_number(val);
-				}
-
-				/* Parse modulation (mandatory) */
-				str = json_object_get_string(txpk_obj, "modu");
-				if (str == NULL) {
-					log_msg("WARNING: [down] no mandatory \"txpk.modu\" object in JSON, TX aborted\n");
-					json_value_free(root_val);
-					continue;
+				
+				/* time left to load a timestamped packet, the late ones are refused by the JIT queue */
+				slack_us = -1;
+				if ((txpkt.tx_mode == TIMESTAMPED) && cnt_now(&now_us)) {
+					slack_us = (int32_t)(txpkt.count_us - now_us);
+					if (slack_us < 0) slack_us = 0;
 				}
-				if (strcmp(str, "LORA") == 0) {
-					/* Lora modulation */
-					txpkt.modulation = MOD_LORA;
-
-					/* Parse Lora spreading-factor and modulation bandwidth (mandatory) */
-					str = json_object_get_string(txpk_obj, "datr");
-					if (str == NULL) {
-						log_msg("WARNING: [down] no mandatory \"txpk.datr\" object in JSON, TX aborted\n");
-						json_value_free(root_val);
-						continue;
-					}
-					i = sscanf(str, "SF%2hdBW%3hd", &x0, &x1);
-					if (i != 2) {
-						log_msg("WARNING: [down] format error in \"txpk.datr\", TX aborted\n");
-						json_value_free(root_val);
-						continue;
-					}
-					switch (x0) {
-						case  7: txpkt.datarate = DR_LORA_SF7;  break;
-						case  8: txpkt.datarate = DR_LORA_SF8;  break;
-						case  9: txpkt.datarate = DR_LORA_SF9;  break;
-						case 10: txpkt.datarate = DR_LORA_SF10; break;
-						case 11: txpkt.datarate = DR_LORA_SF11; break;
-						case 12: txpkt.datarate = DR_LORA_SF12; break;
-						default:
-							log_msg("WARNING: [down] format error in \"txpk.datr\", invalid SF, TX aborted\n");
-							json_value_free(root_val);
-							continue;
-					}
-					switch (x1) {
-						case 125: txpkt.bandwidth = BW_125KHZ; break;
-						case 250: txpkt.bandwidth = BW_250KHZ; break;
-						case 500: txpkt.bandwidth = BW_500KHZ; break;
-						default:
-							log_msg("WARNING: [down] format error in \"txpk.datr\", invalid BW, TX aborted\n");
-							json_value_free(root_val);
-							continue;
-					}
-
-					/* Parse ECC coding rate (optional field) */
-					str = json_object_get_string(txpk_obj, "codr");
-					if (str == NULL) {
-						log_msg("WARNING: [down] no mandatory \"txpk.codr\" object in json, TX aborted\n");
-						json_value_free(root_val);
-						continue;
-					}
-					if      (strcmp(str, "4/5") == 0) txpkt.coderate = CR_LORA_4_5;
-					else if (strcmp(str, "4/6") == 0) txpkt.coderate = CR_LORA_4_6;
-					else if (strcmp(str, "2/3") == 0) txpkt.coderate = CR_LORA_4_6;
-					else if (strcmp(str, "4/7") == 0) txpkt.coderate = CR_LORA_4_7;
-					else if (strcmp(str, "4/8") == 0) txpkt.coderate = CR_LORA_4_8;
-					else if (strcmp(str, "1/2") == 0) txpkt.coderate = CR_LORA_4_8;
-					else {
-						log_msg("WARNING: [down] format error in \"txpk.codr\", TX aborted\n");
-						json_value_free(root_val);
-						continue;
-					}
-
-					/* Parse signal polarity switch (optional field) */
-					val = json_object_get_value(txpk_obj,"ipol");
-					if (val != NULL) {
-						txpkt.invert_pol = (bool)json_value_get_boolean(val);
-					}
-
-					/* parse Lora preamble length (optional field, optimum min value enforced) */
-					val = json_object_get_value(txpk_obj,"prea");
-					if (val != NULL) {
-						i = (int)json_value_get_number(val);
-						if (i >= MIN_LORA_PREAMB) {
-							txpkt.preamble = (uint16_t)i;
-						} else {
-							txpkt.preamble = (uint16_t)MIN_LORA_PREAMB;
-						}
-					} else {
-						txpkt.preamble = (uint16_t)STD_LORA_PREAMB;
-					}
-					
-				} else if (strcmp(str, "FSK") == 0) {
-					/* FSK modulation */
-					txpkt.modulation = MOD_FSK;
-
-					/* parse FSK bitrate (mandatory) */
-					val = json_object_get_value(txpk_obj,"datr");
-					if (val == NULL) {
-						log_msg("WARNING: [down] no mandatory \"txpk.datr\" object in JSON, TX aborted\n");
-						json_value_free(root_val);
-						continue;
+				
+				/* queue the packet for the dispatcher, or send it at once while no uplink dates the concentrator counter */
+				preempted = 0;
+				jit_err = JIT_NB_ERROR;
+				duty_v = downlink_duty(&txpkt, false);
+				if (duty_v != DUTY_OK) {
+					/* over the limits of its sub-band, neither queued nor sent */
+				} else if (cnt_now(&now_us)) {
+					jit_err = downlink_queue(&txpkt, (txpkt.tx_mode == IMMEDIATE) ? JIT_CLASS_C : JIT_CLASS_A, &preempted);
+					if (jit_err != JIT_OK) {
+						downlink_refund(&txpkt, false);
 					}
-					txpkt.datarate = (uint32_t)(json_value_get_number(val));
-					
-					/* parse frequency deviation (mandatory) */
-					val = json_object_get_value(txpk_obj,"fdev");
-					if (val == NULL) {
-						log_msg("WARNING: [down] no mandatory \"txpk.fdev\" object in JSON, TX aborted\n");
-						json_value_free(root_val);
-						continue;
+				} else {
+					/* the dispatcher may still hold a packet loaded before, it is not overwritten */
+					load = downlink_load(&txpkt);
+					if (load == LOAD_BUSY) {
+						jit_err = JIT_COLLISION;
 					}
-					txpkt.f_dev = (uint8_t)(json_value_get_number(val) / 1000.0); /* JSON value in Hz, txpkt.f_dev in kHz */
-
-					/* parse FSK preamble length (optional field, optimum min value enforced) */
-					val = json_object_get_value(txpk_obj,"prea");
-					if (val != NULL) {
-						i = (int)json_value_get_number(val);
-						if (i >= MIN_FSK_PREAMB) {
-							txpkt.preamble = (uint16_t)i;
-						} else {
-							txpkt.preamble = (uint16_t)MIN_FSK_PREAMB;
-						}
-					} else {
-						txpkt.preamble = (uint16_t)STD_FSK_PREAMB;
+					if (load != LOAD_OK) {
+						downlink_refund(&txpkt, false);
 					}
-				
-				} else {
-					log_msg("WARNING: [down] invalid modulation in \"txpk.modu\", TX aborted\n");
-					json_value_free(root_val);
-					continue;
-				}
-
-				/* Parse payload length (mandatory) */
-				val = json_object_get_value(txpk_obj,"size");
-				if (val == NULL) {
-					log_msg("WARNING: [down] no mandatory \"txpk.size\" object in JSON, TX aborted\n");
-					json_value_free(root_val);
-					continue;
-				}
-				txpkt.size = (uint16_t)json_value_get_number(val);
-				
-				/* Parse payload data (mandatory) */
-				str = json_object_get_string(txpk_obj, "data");
-				if (str == NULL) {
-					log_msg("WARNING: [down] no mandatory \"txpk.data\" object in JSON, TX aborted\n");
-					json_value_free(root_val);
-					continue;
 				}
-				i = b64_to_bin(str, strlen(str), txpkt.payload, sizeof txpkt.payload);
-				if (i != txpkt.size) {
-					log_msg("WARNING: [down] mismatch between .size and .data size once converter to binary\n");
-				}
-				
-				/* free the JSON parse tree from memory */
-				json_value_free(root_val);
 				
-				/* select TX mode */
-				if (sent_immediate) {
-					txpkt.tx_mode = IMMEDIATE;
+				/* record measurement data */
+				meas_begin(meas);
+				meas_add(meas, MEAS_DW_DGRAM_RCV, 1); /* count only datagrams with no JSON errors */
+				meas_add(meas, MEAS_DW_NETWORK_BYTE, log_msg_len);
+				meas_add(meas, MEAS_DW_PAYLOAD_BYTE, txpkt.size);
+				if (slack_us >= 0) meas_add(meas, MEAS_DW_SLACK + meas_hist_bin(slack_us / 1000, MEAS_SLACK_BINS), 1);
+				if (duty_v != DUTY_OK) {
+					meas_add(meas, MEAS_DW_DUTY_DWELL + duty_v - DUTY_DWELL, 1);
+				} else if (jit_err == JIT_NB_ERROR) {
+					meas_add(meas, (load != LOAD_OK) ? MEAS_NB_TX_FAIL : MEAS_NB_TX_OK, 1);
+					if (load == LOAD_OK) meas_add(meas, MEAS_TX_BUSY_US, airtime_tx(&txpkt));
+				} else if (jit_err == JIT_OK) {
+					meas_add(meas, MEAS_DW_JIT_QUEUED, 1);
 				} else {
-					txpkt.tx_mode = TIMESTAMPED;
+					meas_add(meas, MEAS_DW_JIT_LATE + jit_err - JIT_TOO_LATE, 1);
 				}
-				
-				/* record measurement data */
-				pthread_mutex_lock(&mx_meas_dw);
-				meas_dw_dgram_rcv += 1; /* count only datagrams with no JSON errors */
-				meas_dw_network_byte += log_msg_len; /* meas_dw_network_byte */
-				meas_dw_payload_byte += txpkt.size;
-				
-				/* transfer data and metadata to the concentrator, and schedule TX */
-				pthread_mutex_lock(&mx_concent); /* may have to wait for a fetch to finish */
-				i = lgw_send(txpkt);
-				pthread_mutex_unlock(&mx_concent); /* free concentrator ASAP */
-				if (i == LGW_HAL_ERROR) {
-					meas_nb_tx_fail += 1;
-					pthread_mutex_unlock(&mx_meas_dw);
+				meas_add(meas, MEAS_DW_JIT_PREEMPTED, preempted);
+				meas_end(meas);
+				if (duty_v != DUTY_OK) {
+					log_msg("WARNING: [down] for server %s, downlink of %u us at %u Hz refused (%s)\n", gtw_conf.serv_addr[ic], airtime_tx(&txpkt), txpkt.freq_hz, duty_verdict_name(duty_v));
+				} else if ((jit_err == JIT_NB_ERROR) && (load != LOAD_OK)) {
 					log_msg("WARNING: [down] lgw_send failed\n");
-					continue;
-				} else {
-					meas_nb_tx_ok += 1;
-					pthread_mutex_unlock(&mx_meas_dw);
+				} else if ((jit_err != JIT_NB_ERROR) && (jit_err != JIT_OK)) {
+					log_msg("WARNING: [down] for server %s, downlink at %u refused by the JIT queue (%s)\n", gtw_conf.serv_addr[ic], txpkt.count_us, jit_error_name(jit_err));
 				}
 			}
 		}
@@ -1745,6 +3223,82 @@ void thread_down(void* pic) {
 
 }
 
+/* -------------------------------------------------------------------------- */
+/* --- THREAD 2b: LOADING THE DOWNLINKS IN THE CONCENTRATOR JUST IN TIME ---- */
+
+void *thread_jit(void *arg) {
+	int i;
+	struct meas_block *meas = &meas_blocks[MEAS_JIT];
+	struct lgw_pkt_tx_s pkt;
+	struct jit_slot slot;
+	struct timespec deadline;
+	uint32_t lead_us = 1000 * gtw_conf.jit_lead_ms;
+	uint32_t now_us;
+	int32_t wait_us;
+	enum load_result load;
+	
+	(void)arg; /* unused */
+	if (lead_us < jit_queue.margin_us) {
+		lead_us = jit_queue.margin_us; /* a packet is queued no later than the margin before its start */
+	}
+	log_msg("INFO: [jit] Thread activated, downlinks loaded %u ms before their start\n", lead_us / 1000);
+	
+	while (!exit_sig && !quit_sig) {
+		/* sleep until the first packet is due, or a new one is queued */
+		pthread_mutex_lock(&mx_jit);
+		cnt_now(&now_us); /* the packets queued are still dispatched once the reference is too old to queue new ones */
+		wait_us = jit_due(&jit_queue, now_us, lead_us);
+		if (wait_us > 0) {
+			if (wait_us > 1000 * JIT_IDLE_MS) {
+				wait_us = 1000 * JIT_IDLE_MS;
+			}
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_nsec += 1000L * wait_us;
+			if (deadline.tv_nsec >= 1000000000L) {
+				deadline.tv_sec += 1;
+				deadline.tv_nsec -= 1000000000L;
+			}
+			pthread_cond_timedwait(&cv_jit, &mx_jit, &deadline);
+			pthread_mutex_unlock(&mx_jit);
+			continue;
+		}
+		jit_dequeue(&jit_queue, &pkt, &slot);
+		pthread_mutex_unlock(&mx_jit);
+		
+		/* the concentrator holds a single packet, the previous one must have left, checked and loaded under the same lock */
+		load = downlink_load(&pkt);
+		for (i = 0; (load == LOAD_BUSY) && (i < (int)(lead_us / 1000)); ++i) {
+			wait_ms(1);
+			load = downlink_load(&pkt);
+		}
+		
+		/* waiting for the previous packet may have eaten the lead */
+		if ((load == LOAD_BUSY) || (load == LOAD_LATE)) {
+			meas_begin(meas);
+			meas_add(meas, MEAS_NB_TX_LATE, 1);
+			meas_end(meas);
+			if ((load == LOAD_LATE) && cnt_now(&now_us)) {
+				log_msg("WARNING: [jit] downlink at %u dropped, %i us too late to be loaded\n", slot.start_us, JIT_MARGIN_US - (int32_t)(slot.start_us - now_us));
+			} else {
+				log_msg("WARNING: [jit] downlink at %u dropped, the previous one has not left the concentrator\n", slot.start_us);
+			}
+			downlink_refund(&pkt, slot.cls == JIT_BEACON);
+			continue;
+		}
+		
+		meas_begin(meas);
+		meas_add(meas, (load == LOAD_FAIL) ? MEAS_NB_TX_FAIL : MEAS_NB_TX_OK, 1);
+		if (load == LOAD_OK) meas_add(meas, MEAS_TX_BUSY_US, slot.end_us - slot.start_us);
+		meas_end(meas);
+		if (load == LOAD_FAIL) {
+			log_msg("WARNING: [jit] lgw_send failed for the downlink at %u\n", slot.start_us);
+			downlink_refund(&pkt, slot.cls == JIT_BEACON);
+		}
+	}
+	log_msg("\nINFO: End of JIT thread\n");
+	return NULL;
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- THREAD 3: PARSE GPS MESSAGE AND KEEP GATEWAY IN SYNC ----------------- */
 
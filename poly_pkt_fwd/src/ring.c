@@ -0,0 +1,87 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+/* fix an issue between POSIX and C99 */
+#ifdef __MACH__
+#elif __STDC_VERSION__ >= 199901L
+	#define _XOPEN_SOURCE 600
+#else
+	#define _XOPEN_SOURCE 500
+#endif
+
+#include "ring.h"
+#include <errno.h>
+
+#define RING_MASK	(RX_RING_SIZE - 1)
+
+void rx_ring_init(struct rx_ring *ring){
+	ring->head = 0;
+	ring->tail = 0;
+	sem_init(&ring->filled, 0, 0);
+}
+
+struct rx_batch *rx_ring_reserve(struct rx_ring *ring){
+	unsigned head = ring->head; /* only written by us */
+	unsigned tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+	if(head - tail >= RX_RING_SIZE){
+		return NULL;
+	}
+	return &ring->slot[head & RING_MASK];
+}
+
+void rx_ring_commit(struct rx_ring *ring){
+	__atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+	sem_post(&ring->filled);
+}
+
+struct rx_batch *rx_ring_peek(struct rx_ring *ring, unsigned timeout_ms){
+	struct timespec deadline;
+	int i;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += timeout_ms / 1000;
+	deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+	if(deadline.tv_nsec >= 1000000000L){
+		deadline.tv_sec += 1;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	do{
+		i = sem_timedwait(&ring->filled, &deadline);
+	}while(i != 0 && errno == EINTR);
+	if(i != 0){
+		return NULL;
+	}
+
+	/* the semaphore guarantees the slot has been published, the acquire pairs with the commit */
+	(void)__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	return &ring->slot[ring->tail & RING_MASK];
+}
+
+void rx_ring_release(struct rx_ring *ring){
+	__atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
+
+unsigned rx_ring_count(struct rx_ring *ring){
+	return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
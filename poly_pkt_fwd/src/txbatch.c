@@ -0,0 +1,101 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+/* sendmmsg is a GNU extension */
+#ifdef __linux__
+	#define _GNU_SOURCE
+#endif
+
+#include "txbatch.h"
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+
+#ifndef __linux__
+/* no sendmmsg outside Linux, send the datagrams one by one */
+struct mmsghdr {
+	struct msghdr	msg_hdr;
+	unsigned int	msg_len;
+};
+
+static int sendmmsg(int sock, struct mmsghdr *msg, unsigned int vlen, int flags){
+	unsigned int i;
+	ssize_t n;
+
+	for(i = 0; i < vlen; i++){
+		n = sendmsg(sock, &msg[i].msg_hdr, flags);
+		if(n < 0) return (i > 0) ? (int)i : -1;
+		msg[i].msg_len = (unsigned int)n;
+	}
+	return (int)vlen;
+}
+#endif
+
+void tx_batch_init(struct tx_batch *batch){
+	batch->nb = 0;
+}
+
+bool tx_batch_add(struct tx_batch *batch, int sock, const void *buf, size_t len, int tag){
+	int i = batch->nb;
+
+	if(i >= TX_BATCH_MAX) return false;
+	batch->sock[i] = sock;
+	batch->tag[i] = tag;
+	batch->result[i] = -1;
+	batch->iov[i].iov_base = (void *)buf;
+	batch->iov[i].iov_len = len;
+	batch->nb++;
+	return true;
+}
+
+int tx_batch_flush(struct tx_batch *batch){
+	struct mmsghdr msg[TX_BATCH_MAX];
+	int i, j, k, n;
+	int sent = 0;
+
+	memset(msg, 0, batch->nb * sizeof msg[0]);
+	for(i = 0; i < batch->nb; i++){
+		msg[i].msg_hdr.msg_iov = &batch->iov[i];
+		msg[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	i = 0;
+	while(i < batch->nb){
+		/* run of datagrams for the same socket */
+		for(j = i + 1; (j < batch->nb) && (batch->sock[j] == batch->sock[i]); j++);
+		do{
+			n = sendmmsg(batch->sock[i], &msg[i], (unsigned int)(j - i), 0);
+		}while((n < 0) && (errno == EINTR));
+		if(n <= 0){
+			/* the first datagram of the run failed, skip it and retry with the next ones */
+			batch->result[i] = -1;
+			i++;
+			continue;
+		}
+		for(k = 0; k < n; k++){
+			batch->result[i + k] = (int)msg[i + k].msg_len;
+		}
+		sent += n;
+		i += n;
+	}
+	return sent;
+}
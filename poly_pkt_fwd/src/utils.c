@@ -27,6 +27,8 @@ Maintainer: Ruud Vlaming
 #include "loragw_hal.h"
 #include "parson.h"
 #include "monitor.h"
+#include "filter.h"
+#include "duty.h"
 
 /* Log system */
 static char *log_output = NULL;                         /* log file path if any */
@@ -67,7 +69,13 @@ int parse_gateway_configuration(const char * conf_file, struct gateway_conf *gtw
 	JSON_Value *val2 = NULL; /* needed to detect the absence of some fields */
 	JSON_Array *servers = NULL;
 	JSON_Array *syscalls = NULL;
+	JSON_Array *depths = NULL;
+	JSON_Array *bands = NULL;
+	JSON_Object *route = NULL;
+	JSON_Object *band = NULL;
+	uint32_t window_s;
 	const char *str; /* pointer to sub-strings in the JSON data */
+	char route_name[32];
 	unsigned long long ull = 0;
 	int i; /* Loop variable */
 	int ic; /* Server counter */
@@ -133,6 +141,33 @@ int parse_gateway_configuration(const char * conf_file, struct gateway_conf *gtw
 			log_msg("INFO: Server %i configured to \"%s\", with port up \"%s\" and port down \"%s\"\n", ic, gtw_conf->serv_addr[ic],gtw_conf->serv_port_up[ic],gtw_conf->serv_port_down[ic]);
 			/* The server may be valid, it is not yet live. */
 			gtw_conf->serv_live[ic] = false;
+			/* Encoding of the datagrams exchanged with the server (optional, JSON by default) */
+			str = json_object_get_string(nw_server, "serv_encoding");
+			gtw_conf->serv_binary[ic] = ((str != NULL) && (strcmp(str, "binary") == 0));
+			if (gtw_conf->serv_binary[ic]) {
+				log_msg("INFO: Server %i uses the binary encoding\n", ic);
+			}
+			/* Decoded LoRaWAN header fields added to the rxpk objects (optional, JSON encoding only) */
+			val = json_object_get_value(nw_server, "serv_enrich");
+			gtw_conf->serv_enrich[ic] = (val != NULL) && (json_value_get_type(val) == JSONBoolean) && (json_value_get_boolean(val) == true);
+			if (gtw_conf->serv_enrich[ic] && gtw_conf->serv_binary[ic]) {
+				log_msg("WARNING: Server %i uses the binary encoding, serv_enrich is ignored\n", ic);
+				gtw_conf->serv_enrich[ic] = false;
+			} else if (gtw_conf->serv_enrich[ic]) {
+				log_msg("INFO: Server %i receives the decoded LoRaWAN header fields\n", ic);
+			}
+			/* Uplinks routed to the server (optional, all of them by default) */
+			filter_free(gtw_conf->serv_route[ic]);
+			gtw_conf->serv_route[ic] = NULL;
+			route = json_object_get_object(nw_server, "route");
+			if (route != NULL) {
+				snprintf(route_name, sizeof route_name, "route of server %i", ic);
+				gtw_conf->serv_route[ic] = filter_parse(route, route_name);
+				if (gtw_conf->serv_route[ic] == NULL) {
+					exit(EXIT_FAILURE);
+				}
+				log_msg("INFO: Server %i only receives the uplinks matching its route\n", ic);
+			}
 			ic++;
 		}
 		gtw_conf->serv_count = ic;
@@ -220,6 +255,178 @@ int parse_gateway_configuration(const char * conf_file, struct gateway_conf *gtw
 		log_msg("INFO: statistics display interval is configured to %i seconds\n", gtw_conf->stat_interval);
 	}
 
+	/* get the max number of packets per fetch (optional) */
+	val = json_object_get_value(conf_obj, "fetch_pkt_max");
+	if (val != NULL) {
+		gtw_conf->fetch_pkt_max = (int)json_value_get_number(val);
+		if ((gtw_conf->fetch_pkt_max < 1) || (gtw_conf->fetch_pkt_max > NB_PKT_MAX)) {
+			log_msg("WARNING: fetch_pkt_max must be between 1 and %i, using %i\n", NB_PKT_MAX, NB_PKT_MAX);
+			gtw_conf->fetch_pkt_max = NB_PKT_MAX;
+		}
+		log_msg("INFO: packet fetch is configured to %i packets max\n", gtw_conf->fetch_pkt_max);
+	}
+
+	/* get the max wait (in ms) between fetches returning no packets (optional) */
+	val = json_object_get_value(conf_obj, "fetch_sleep_max_ms");
+	if (val != NULL) {
+		gtw_conf->fetch_sleep_max_ms = (unsigned)json_value_get_number(val);
+		if (gtw_conf->fetch_sleep_max_ms < FETCH_SLEEP_MIN_MS) {
+			gtw_conf->fetch_sleep_max_ms = FETCH_SLEEP_MIN_MS;
+		}
+		log_msg("INFO: idle packet fetch back-off is configured to %u ms max\n", gtw_conf->fetch_sleep_max_ms);
+	}
+
+	/* get the upstream queue depths from which the packets are shed, by priority (optional) */
+	depths = json_object_get_array(conf_obj, "shed_depth");
+	if (depths != NULL) {
+		if (json_array_get_count(depths) != ARRAY_SIZE(gtw_conf->shed_depth)) {
+			log_msg("ERROR: shed_depth must list %u queue depths\n", (unsigned)ARRAY_SIZE(gtw_conf->shed_depth));
+			exit(EXIT_FAILURE);
+		}
+		for (i = 0; i < (int)ARRAY_SIZE(gtw_conf->shed_depth); i++) {
+			gtw_conf->shed_depth[i] = (unsigned)json_array_get_number(depths, i);
+			if ((gtw_conf->shed_depth[i] > RX_RING_SIZE) || ((i > 0) && (gtw_conf->shed_depth[i] < gtw_conf->shed_depth[i - 1]))) {
+				log_msg("ERROR: shed_depth must be increasing, up to %u batches\n", RX_RING_SIZE);
+				exit(EXIT_FAILURE);
+			}
+		}
+		log_msg("INFO: uplinks are shed from an upstream queue depth of %u (CRC error or no CRC), %u (copies), %u (unconfirmed)\n", gtw_conf->shed_depth[0], gtw_conf->shed_depth[1], gtw_conf->shed_depth[2]);
+	}
+
+	/* get the max time (in ms) a received packet may wait for others to share its datagram (optional) */
+	val = json_object_get_value(conf_obj, "aggregate_hold_ms");
+	if (val != NULL) {
+		gtw_conf->aggr_hold_ms = (unsigned)json_value_get_number(val);
+		log_msg("INFO: upstream aggregation window is configured to %u ms\n", gtw_conf->aggr_hold_ms);
+	}
+
+	/* get the size limit (in bytes) of an upstream datagram, aggregate_max_size is its former name (optional) */
+	val = json_object_get_value(conf_obj, "push_max_size");
+	if (val == NULL) {
+		val = json_object_get_value(conf_obj, "aggregate_max_size");
+	}
+	if (val != NULL) {
+		gtw_conf->push_max_size = (int)json_value_get_number(val);
+		if (gtw_conf->push_max_size < PUSH_MIN_SIZE) {
+			log_msg("WARNING: push_max_size must be at least %i bytes, using %i\n", PUSH_MIN_SIZE, PUSH_MIN_SIZE);
+			gtw_conf->push_max_size = PUSH_MIN_SIZE;
+		}
+		log_msg("INFO: upstream datagrams are limited to %i bytes\n", gtw_conf->push_max_size);
+	}
+
+	/* get the time (in ms) during which the copies of an uplink are dropped (optional) */
+	val = json_object_get_value(conf_obj, "dedup_window_ms");
+	if (val != NULL) {
+		gtw_conf->dedup_window_ms = (unsigned)json_value_get_number(val);
+		if (gtw_conf->dedup_window_ms > 0) {
+			log_msg("INFO: copies of an uplink received within %u ms are dropped\n", gtw_conf->dedup_window_ms);
+		} else {
+			log_msg("INFO: duplicate uplinks are forwarded\n");
+		}
+	}
+
+	/* get the time (in ms) before its start at which a downlink is loaded in the concentrator (optional) */
+	val = json_object_get_value(conf_obj, "jit_lead_ms");
+	if (val != NULL) {
+		gtw_conf->jit_lead_ms = (unsigned)json_value_get_number(val);
+		if ((gtw_conf->jit_lead_ms < 5) || (gtw_conf->jit_lead_ms > 1000)) {
+			log_msg("WARNING: jit_lead_ms must be between 5 and 1000, using %u\n", JIT_LEAD_MS);
+			gtw_conf->jit_lead_ms = JIT_LEAD_MS;
+		}
+		log_msg("INFO: downlinks are loaded in the concentrator %u ms before their start\n", gtw_conf->jit_lead_ms);
+	}
+
+	/* get the airtime limits of the downlinks, those of a region and/or explicit sub-bands (optional) */
+	str = json_object_get_string(conf_obj, "duty_cycle_region");
+	bands = json_object_get_array(conf_obj, "duty_cycle_bands");
+	if ((str != NULL) || (bands != NULL)) {
+		val = json_object_get_value(conf_obj, "duty_cycle_window_s");
+		window_s = (val != NULL) ? (uint32_t)json_value_get_number(val) : DUTY_WINDOW_S;
+		duty_free(gtw_conf->duty_cycle);
+		gtw_conf->duty_cycle = duty_create(window_s);
+		if (gtw_conf->duty_cycle == NULL) {
+			log_msg("ERROR: duty_cycle_window_s must be at least %u s\n", DUTY_NB_BUCKET);
+			exit(EXIT_FAILURE);
+		}
+		/* the explicit sub-bands come first and take precedence over those of the region */
+		for (i = 0; (bands != NULL) && (i < (int)json_array_get_count(bands)); i++) {
+			band = json_array_get_object(bands, i);
+			if ((band == NULL) || (json_object_get_value(band, "freq_min") == NULL) || (json_object_get_value(band, "freq_max") == NULL)
+			 || (duty_add_band(gtw_conf->duty_cycle, (uint32_t)json_object_get_number(band, "freq_min"), (uint32_t)json_object_get_number(band, "freq_max"),
+			                   (float)json_object_get_number(band, "duty_cycle"), (uint32_t)json_object_get_number(band, "dwell_time_ms")) != 0)) {
+				log_msg("ERROR: invalid duty_cycle_bands entry %i, freq_min and freq_max in Hz, duty_cycle in percent, up to %u sub-bands\n", i, DUTY_BAND_MAX);
+				exit(EXIT_FAILURE);
+			}
+		}
+		if ((str != NULL) && (strcmp(str, "none") != 0) && (duty_add_region(gtw_conf->duty_cycle, str) != 0)) {
+			log_msg("ERROR: unknown duty_cycle_region %s (EU868, AS923 or none) or more than %u sub-bands\n", str, DUTY_BAND_MAX);
+			exit(EXIT_FAILURE);
+		}
+		if (gtw_conf->duty_cycle->nb_band > 0) {
+			log_msg("INFO: downlink airtime limited in %i sub-bands over %u s\n", gtw_conf->duty_cycle->nb_band, gtw_conf->duty_cycle->window_s);
+		} else {
+			duty_free(gtw_conf->duty_cycle);
+			gtw_conf->duty_cycle = NULL;
+			log_msg("INFO: downlink airtime is not limited\n");
+		}
+	}
+
+	/* get the nb of devices whose link quality is tracked (optional) */
+	val = json_object_get_value(conf_obj, "link_table_size");
+	if (val != NULL) {
+		gtw_conf->link_table_size = (unsigned)json_value_get_number(val);
+		if (gtw_conf->link_table_size > 0) {
+			log_msg("INFO: link quality of up to %u devices is tracked\n", gtw_conf->link_table_size);
+		} else {
+			log_msg("INFO: link quality tracking is disabled\n");
+		}
+	}
+
+	/* get the path of the LoRaWAN network filter (optional) */
+	str = json_object_get_string(conf_obj, "filter_file");
+	if (str != NULL) {
+		strncpy(gtw_conf->filter_file, str, sizeof gtw_conf->filter_file - 1);
+		log_msg("INFO: uplinks are filtered according to %s\n", gtw_conf->filter_file);
+	}
+
+	/* get the path of the upstream store-and-forward journal (optional) */
+	str = json_object_get_string(conf_obj, "journal_path");
+	if (str != NULL) {
+		strncpy(gtw_conf->journal_path, str, sizeof gtw_conf->journal_path - 1);
+		log_msg("INFO: upstream datagrams are journaled in %s\n", gtw_conf->journal_path);
+	}
+
+	/* get the size (in bytes) of the journal ring (optional) */
+	val = json_object_get_value(conf_obj, "journal_size");
+	if (val != NULL) {
+		gtw_conf->journal_size = (uint32_t)json_value_get_number(val);
+		log_msg("INFO: upstream journal size is configured to %u bytes\n", gtw_conf->journal_size);
+	}
+
+	/* get the max nb of journaled datagrams replayed per second to a server (optional) */
+	val = json_object_get_value(conf_obj, "journal_catchup_rate");
+	if (val != NULL) {
+		gtw_conf->journal_catchup_rate = (unsigned)json_value_get_number(val);
+		if (gtw_conf->journal_catchup_rate < 1) {
+			gtw_conf->journal_catchup_rate = 1;
+		}
+		log_msg("INFO: upstream journal is replayed at %u datagrams/s max\n", gtw_conf->journal_catchup_rate);
+	}
+
+	/* get the max time (in ms) journal writes may stay unflushed (optional) */
+	val = json_object_get_value(conf_obj, "journal_sync_ms");
+	if (val != NULL) {
+		gtw_conf->journal_sync_ms = (unsigned)json_value_get_number(val);
+		log_msg("INFO: upstream journal is flushed every %u ms\n", gtw_conf->journal_sync_ms);
+	}
+
+	/* get the time (in ms) without PUSH_ACK after which uplinks are held in the journal (optional) */
+	val = json_object_get_value(conf_obj, "journal_outage_ms");
+	if (val != NULL) {
+		gtw_conf->journal_outage_ms = (unsigned)json_value_get_number(val);
+		log_msg("INFO: servers silent for %u ms are considered unreachable\n", gtw_conf->journal_outage_ms);
+	}
+
 	/* get time-out value (in ms) for upstream datagrams (optional) */
 	val = json_object_get_value(conf_obj, "push_timeout_ms");
 	if (val != NULL) {
@@ -227,6 +434,27 @@ int parse_gateway_configuration(const char * conf_file, struct gateway_conf *gtw
 		log_msg("INFO: upstream PUSH_DATA time-out is configured to %u ms\n", (unsigned)(gtw_conf->push_timeout_half.tv_usec / 500));
 	}
 
+	/* get the max nb of retransmissions of an unacknowledged PUSH_DATA (optional) */
+	val = json_object_get_value(conf_obj, "push_retx_max");
+	if (val != NULL) {
+		gtw_conf->push_retx_max = (int)json_value_get_number(val);
+		if (gtw_conf->push_retx_max < 0) {
+			gtw_conf->push_retx_max = 0;
+		}
+		log_msg("INFO: unacknowledged PUSH_DATA are retransmitted up to %i times\n", gtw_conf->push_retx_max);
+	}
+
+	/* get the budget of PUSH_DATA retransmissions per second and per server (optional) */
+	val = json_object_get_value(conf_obj, "push_retx_rate");
+	if (val != NULL) {
+		gtw_conf->push_retx_rate = (float)json_value_get_number(val);
+		if (!(gtw_conf->push_retx_rate > 0)) {
+			log_msg("WARNING: push_retx_rate must be positive, using %i\n", PUSH_RETX_RATE);
+			gtw_conf->push_retx_rate = PUSH_RETX_RATE;
+		}
+		log_msg("INFO: PUSH_DATA retransmissions are limited to %.1f per second and per server\n", gtw_conf->push_retx_rate);
+	}
+
 	/* packet filtering parameters */
 	val = json_object_get_value(conf_obj, "forward_crc_valid");
 	if (json_value_get_type(val) == JSONBoolean) {
@@ -428,7 +656,7 @@ int parse_gateway_configuration(const char * conf_file, struct gateway_conf *gtw
 	/* Platform read and override */
 	str = json_object_get_string(conf_obj, "platform");
 	if (str != NULL) {
-		if (strncmp(str, "*", 1) != 0) { strncpy(gtw_conf->platform, str, sizeof gtw_conf->platform); }
+		if (strncmp(str, "*", 1) != 0) { strncpy(gtw_conf->platform, str, sizeof gtw_conf->platform); gtw_conf->platform[sizeof gtw_conf->platform - 1] = 0; }
 		log_msg("INFO: Platform configured to \"%s\"\n", gtw_conf->platform);
 	}
 
@@ -436,6 +664,7 @@ int parse_gateway_configuration(const char * conf_file, struct gateway_conf *gtw
 	str = json_object_get_string(conf_obj, "contact_email");
 	if (str != NULL) {
 		strncpy(gtw_conf->email, str, sizeof gtw_conf->email);
+		gtw_conf->email[sizeof gtw_conf->email - 1] = 0; /* the status report is sized for the longest string */
 		log_msg("INFO: Contact email configured to \"%s\"\n", gtw_conf->email);
 	}
 
@@ -443,6 +672,7 @@ int parse_gateway_configuration(const char * conf_file, struct gateway_conf *gtw
 	str = json_object_get_string(conf_obj, "description");
 	if (str != NULL) {
 		strncpy(gtw_conf->description, str, sizeof gtw_conf->description);
+		gtw_conf->description[sizeof gtw_conf->description - 1] = 0;
 		log_msg("INFO: Description configured to \"%s\"\n", gtw_conf->description);
 	}
 
@@ -0,0 +1,230 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the disclaimer below.
+ *
+ * Wifx's name may not be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * DISCLAIMER: THIS SOFTWARE IS PROVIDED BY WIFX "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT ARE
+ * DISCLAIMED. IN NO EVENT SHALL WIFX BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * */
+
+/*
+Description:
+	Parsing of a PULL_RESP and of a configuration file with parson, in an arena
+	(see arena.h) and with malloc: both trees must be the same and fit the
+	arena sizes of conf.h without falling back to malloc.
+	With -b, times both allocators instead.
+	Usage: bench_arena [-b] global_conf.json
+*/
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+/* fix an issue between POSIX and C99 */
+#ifdef __MACH__
+#elif __STDC_VERSION__ >= 199901L
+	#define _XOPEN_SOURCE 600
+#else
+	#define _XOPEN_SOURCE 500
+#endif
+
+#include <stdio.h>		/* printf, fopen */
+#include <stdlib.h>		/* EXIT_*, malloc */
+#include <string.h>		/* strcmp */
+#include <time.h>		/* clock_gettime */
+
+#include "conf.h"
+#include "arena.h"
+#include "parson.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+#define CHECK(cond, ...)	do { if (!(cond)) { printf("FAIL line %u: ", __LINE__); printf(__VA_ARGS__); printf("\n"); ++nb_fail; } } while (0)
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define BENCH_LOOPS_DOWN	200000
+#define BENCH_LOOPS_CONF	2000
+
+/* the txpk of a class A downlink, as the network servers send it */
+static const char pull_resp[] = "{\"txpk\":{\"imme\":false,\"tmst\":1234567890,\"freq\":869.525,\"rfch\":0,\"powe\":14,"
+	"\"modu\":\"LORA\",\"datr\":\"SF9BW125\",\"codr\":\"4/5\",\"ipol\":true,\"size\":32,"
+	"\"data\":\"YGd3ASaAAwAAAQIDBAUGBwgJCgsMDQ4PEBESExQVFhcYGRobHB0=\"}}";
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE VARIABLES ---------------------------------------------------- */
+
+static unsigned nb_fail = 0;
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+static double elapsed_ns(const struct timespec *a, const struct timespec *b) {
+	return 1e9 * (double)(b->tv_sec - a->tv_sec) + (double)(b->tv_nsec - a->tv_nsec);
+}
+
+static char *read_file(const char *path) {
+	FILE *f;
+	char *s;
+	long len;
+	
+	f = fopen(path, "rb");
+	if (f == NULL) {
+		return NULL;
+	}
+	fseek(f, 0, SEEK_END);
+	len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	s = malloc(len + 1);
+	if ((s != NULL) && (fread(s, 1, len, f) == (size_t)len)) {
+		s[len] = 0;
+	} else {
+		free(s);
+		s = NULL;
+	}
+	fclose(f);
+	return s;
+}
+
+/* same structure, names and values */
+static int same_tree(const JSON_Value *a, const JSON_Value *b) {
+	const JSON_Object *oa, *ob;
+	const JSON_Array *ra, *rb;
+	size_t i;
+	
+	if (json_value_get_type(a) != json_value_get_type(b)) {
+		return 0;
+	}
+	switch (json_value_get_type(a)) {
+		case JSONObject:
+			oa = json_value_get_object(a);
+			ob = json_value_get_object(b);
+			if (json_object_get_count(oa) != json_object_get_count(ob)) {
+				return 0;
+			}
+			for (i = 0; i < json_object_get_count(oa); ++i) {
+				if ((strcmp(json_object_get_name(oa, i), json_object_get_name(ob, i)) != 0) || !same_tree(json_object_get_value(oa, json_object_get_name(oa, i)), json_object_get_value(ob, json_object_get_name(ob, i)))) {
+					return 0;
+				}
+			}
+			return 1;
+		case JSONArray:
+			ra = json_value_get_array(a);
+			rb = json_value_get_array(b);
+			if (json_array_get_count(ra) != json_array_get_count(rb)) {
+				return 0;
+			}
+			for (i = 0; i < json_array_get_count(ra); ++i) {
+				if (!same_tree(json_array_get_value(ra, i), json_array_get_value(rb, i))) {
+					return 0;
+				}
+			}
+			return 1;
+		case JSONString:
+			return strcmp(json_value_get_string(a), json_value_get_string(b)) == 0;
+		case JSONNumber:
+			return json_value_get_number(a) == json_value_get_number(b);
+		case JSONBoolean:
+			return json_value_get_boolean(a) == json_value_get_boolean(b);
+		default:
+			return 1;
+	}
+}
+
+/* parse with malloc then in the arena, the trees must match and the arena must not overflow */
+static void test_parse(const char *name, const char *json, size_t size) {
+	struct arena a;
+	JSON_Value *ref, *val;
+	
+	if (arena_init(&a, size) != 0) {
+		CHECK(0, "no memory for the arena of %s", name);
+		return;
+	}
+	arena_use(NULL);
+	ref = json_parse_string_with_comments(json);
+	arena_use(&a);
+	val = json_parse_string_with_comments(json);
+	CHECK((ref != NULL) && (val != NULL), "%s not parsed", name);
+	CHECK((ref == NULL) || (val == NULL) || same_tree(ref, val), "%s parsed differently in the arena", name);
+	CHECK(a.nb_fallback == 0, "%s needs more than %u bytes, %u allocations passed to malloc", name, (unsigned)size, a.nb_fallback);
+	printf("%s parsed in %u of %u bytes\n", name, (unsigned)a.peak, (unsigned)size);
+	json_value_free(val);
+	arena_use(NULL);
+	json_value_free(ref);
+	arena_free(&a);
+}
+
+/* time the parsing and release of a tree, with malloc then in the arena */
+static void bench_parse(const char *name, const char *json, size_t size, int loops) {
+	struct arena a;
+	struct timespec t0, t1, t2;
+	unsigned nb_null = 0;
+	int i;
+	
+	if (arena_init(&a, size) != 0) {
+		return;
+	}
+	arena_use(NULL);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	for (i = 0; i < loops; ++i) {
+		JSON_Value *v = json_parse_string_with_comments(json);
+		nb_null += (v == NULL);
+		json_value_free(v);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	arena_use(&a);
+	for (i = 0; i < loops; ++i) {
+		JSON_Value *v = json_parse_string_with_comments(json);
+		nb_null += (v == NULL);
+		json_value_free(v);
+		arena_reset(&a);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	arena_use(NULL);
+	printf("  %-18s %10.0f / %10.0f%s\n", name, elapsed_ns(&t0, &t1) / loops, elapsed_ns(&t1, &t2) / loops, (nb_null != 0) ? " (parse errors)" : "");
+	arena_free(&a);
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- MAIN FUNCTION -------------------------------------------------------- */
+
+int main(int argc, char **argv) {
+	int bench = (argc > 1) && (strcmp(argv[1], "-b") == 0);
+	const char *conf_path = (argc > 1 + bench) ? argv[1 + bench] : "global_conf.json";
+	char *conf;
+	
+	conf = read_file(conf_path);
+	if (conf == NULL) {
+		printf("bench_arena: cannot read %s\n", conf_path);
+		return EXIT_FAILURE;
+	}
+	arena_install();
+	
+	if (bench) {
+		printf("parsing, ns per JSON (malloc / arena):\n");
+		bench_parse("PULL_RESP", pull_resp, ARENA_DOWN_SIZE, BENCH_LOOPS_DOWN);
+		bench_parse(conf_path, conf, ARENA_CONF_SIZE, BENCH_LOOPS_CONF);
+	} else {
+		test_parse("PULL_RESP", pull_resp, ARENA_DOWN_SIZE);
+		test_parse(conf_path, conf, ARENA_CONF_SIZE);
+		printf("bench_arena: %s (%u failures)\n", (nb_fail == 0) ? "PASS" : "FAIL", nb_fail);
+	}
+	free(conf);
+	return (nb_fail == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -37,6 +37,8 @@ Maintainer: Sylvain Miermont
 #include <arpa/inet.h>  /* IP address conversion stuff */
 #include <netdb.h>		/* gai_strerror */
 
+#include "binpk.h"
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
 
@@ -45,6 +47,57 @@ Maintainer: Sylvain Miermont
 #define STR(x)			STRINGIFY(x)
 #define MSG(args...)	fprintf(stderr, args) /* message that is destined to the user */
 
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+#define PKT_PUSH_DATA	0
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* display the content of a binary PUSH_DATA body (see PROTOCOL.TXT) */
+static void print_binpk_up(const uint8_t *body, int len) {
+	struct binpk_rx rx;
+	const char *stat;
+	int stat_len;
+	int nb_pkt;
+	int n = BINPK_UP_HDR;
+	int i, j;
+	
+	if ((len < BINPK_UP_HDR) || (body[0] != BINPK_VERSION)) {
+		printf("    invalid binary body\n");
+		return;
+	}
+	nb_pkt = body[BINPK_UP_COUNT];
+	memset(&rx, 0, sizeof rx);
+	for (i = 0; i < nb_pkt; ++i) {
+		j = binpk_rx_read(body + n, len - n, &rx);
+		if (j < 0) {
+			printf("    rxpk #%i malformed\n", i);
+			return;
+		}
+		n += j;
+		printf("    rxpk #%i: tmst %u, %.6f MHz, chan %u, rfch %u", i, rx.tmst, rx.freq_hz / 1e6, rx.chan, rx.rfch);
+		if (rx.modu == BINPK_LORA) {
+			printf(", LORA SF%uBW%u 4/%u, SNR %.1f", rx.sf, rx.bw_khz, rx.codr, rx.lsnr / 10.0);
+		} else {
+			printf(", FSK %u bps", rx.datr);
+		}
+		printf(", stat %i, RSSI %i, %u bytes", rx.stat, rx.rssi, rx.size);
+		if (rx.has_time) {
+			printf(", time %llu.%06llu", (unsigned long long)(rx.time_us / 1000000), (unsigned long long)(rx.time_us % 1000000));
+		}
+		printf("\n");
+	}
+	if (body[BINPK_UP_FLAGS] & BINPK_UP_STAT) {
+		if (binpk_stat_read(body + n, len - n, &stat, &stat_len) < 0) {
+			printf("    stat malformed\n");
+			return;
+		}
+		printf("    stat: %.*s\n", stat_len, stat);
+	}
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- MAIN FUNCTION -------------------------------------------------------- */
 
@@ -121,5 +174,10 @@ int main(int argc, char **argv)
 		}
 		getnameinfo((struct sockaddr *)&dist_addr, addr_len, host_name, sizeof host_name, port_name, sizeof port_name, NI_NUMERICHOST);
 		printf("Got packet from host %s port %s, %i bytes long\n", host_name, port_name, byte_nb);
+		
+		/* decode the PUSH_DATA datagrams using the binary encoding */
+		if ((byte_nb > 12) && (databuf[3] == PKT_PUSH_DATA) && (databuf[12] == BINPK_VERSION)) {
+			print_binpk_up(databuf + 12, byte_nb - 12);
+		}
 	}
 }
@@ -40,6 +40,7 @@ Maintainer: Sylvain Miermont
 #include <netdb.h>		/* gai_strerror */
 
 #include "base64.h"
+#include "binpk.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
@@ -97,6 +98,7 @@ void usage(void) {
 	MSG(" -t <int> pause between packets (ms)\n");
 	MSG(" -x <int> numbers of times the sequence is repeated\n");
 	MSG(" -i send packet using inverted modulation polarity \n");
+	MSG(" -B send packet using the binary encoding instead of JSON\n");
 }
 
 /* -------------------------------------------------------------------------- */
@@ -114,6 +116,8 @@ int main(int argc, char **argv)
 	int delay = 1000; /* 1 second between packets by default */
 	int repeat = 1; /* sweep only once by default */
 	bool invert = false;
+	bool binary = false;
+	struct binpk_tx bin_tx; /* packet for the binary encoding */
 	
 	/* packet payload variables */
 	uint8_t payload_bin[20] = "TEST**##############"; /* # is for padding */
@@ -148,7 +152,7 @@ int main(int argc, char **argv)
 	hints.ai_flags = AI_PASSIVE; /* will assign local IP automatically */
 	
 	/* parse command line options */
-	while ((i = getopt (argc, argv, "hn:f:s:b:p:t:x:i")) != -1) {
+	while ((i = getopt (argc, argv, "hn:f:s:b:p:t:x:iB")) != -1) {
 		switch (i) {
 			case 'h':
 				usage();
@@ -211,6 +215,10 @@ int main(int argc, char **argv)
 				invert = true;
 				break;
 			
+			case 'B': /* -B send packet using the binary encoding instead of JSON */
+				binary = true;
+				break;
+			
 			default:
 				MSG("ERROR: argument parsing failure, use -h option for help\n");
 				usage();
@@ -355,15 +363,35 @@ int main(int argc, char **argv)
 	memcpy((void *)(databuf + buff_index), (void *)"\"}}", 3);
 	buff_index += 3; /* ends up being the total length of payload */
 	
+	/* same packet for the binary encoding */
+	memset(&bin_tx, 0, sizeof bin_tx);
+	bin_tx.imme = true;
+	bin_tx.freq_hz = (uint32_t)((double)f_target * 1e6);
+	bin_tx.rfch = 0;
+	bin_tx.powe = pow;
+	bin_tx.modu = BINPK_LORA;
+	bin_tx.sf = sf;
+	bin_tx.bw_khz = bw;
+	bin_tx.codr = 6;
+	bin_tx.ipol = invert;
+	bin_tx.prea = 8;
+	bin_tx.size = sizeof payload_bin;
+	bin_tx.payload = payload_bin;
+	
 	/* main loop */
 	for (i = 0; i < repeat; ++i) {
 		/* refresh counters in payload (decimal, for readability) */
 		payload_bin[4] = '0' +((i%100)/10); /* 10^1 digit */
 		payload_bin[5] = '0' + (i % 10); /* 10^0 digit */
 		
-		/* encode the payload in Base64 */
-		bin_to_b64_nopad(payload_bin, sizeof payload_bin, payload_b64, sizeof payload_b64);
-		memcpy((void *)(databuf + payload_index), (void *)payload_b64, 27);
+		if (binary) {
+			/* binary txpk, replaces the JSON object after the header */
+			buff_index = 4 + binpk_tx_write(&bin_tx, databuf + 4, sizeof databuf - 4);
+		} else {
+			/* encode the payload in Base64 */
+			bin_to_b64_nopad(payload_bin, sizeof payload_bin, payload_b64, sizeof payload_b64);
+			memcpy((void *)(databuf + payload_index), (void *)payload_b64, 27);
+		}
 		
 		/* send packet to the gateway */
 		byte_nb = sendto(sock, (void *)databuf, buff_index, 0, (struct sockaddr *)&dist_addr, addr_len);